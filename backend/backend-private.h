@@ -29,6 +29,7 @@
 #  include <signal.h>
 #  include <unistd.h>
 #  include <fcntl.h>
+#  include <poll.h>
 
 #  ifdef __linux
 #    include <sys/ioctl.h>
@@ -58,10 +59,46 @@ extern "C" {
 #  endif /* __cplusplus */
 
 
+/*
+ * Types...
+ */
+
+typedef struct backend_data_s		/**** Print data buffering ****/
+{
+  int		print_fd,		/* Print file descriptor */
+		device_fd;		/* Device file descriptor */
+  int		use_splice,		/* Splice the print pipe to the device? */
+		ready,			/* Print pipe has data to splice? */
+		eof;			/* End of print data? */
+  unsigned char	*buffer;		/* Ring buffer */
+  size_t	size,			/* Size of ring buffer */
+		start,			/* Start of pending data */
+		used;			/* Bytes of pending data */
+  off_t		total_bytes;		/* Total bytes written */
+  double	start_time,		/* Time of first write */
+		report_time,		/* Time of last report */
+		stall_time,		/* Seconds waiting for the device */
+		idle_time;		/* Seconds waiting for print data */
+} backend_data_t;
+
+
 /*
  * Prototypes...
  */
 
+extern int		backendDataDrain(backend_data_t *data);
+extern void		backendDataFree(backend_data_t *data);
+extern int		backendDataInit(backend_data_t *data, int print_fd,
+			                int device_fd);
+extern int		backendDataPoll(backend_data_t *data,
+			                struct pollfd *pfds, int num_pfds,
+					int timeout);
+extern ssize_t		backendDataRead(backend_data_t *data);
+extern void		backendDataReport(backend_data_t *data, int final);
+extern int		backendDataWantRead(backend_data_t *data);
+extern int		backendDataWantWrite(backend_data_t *data);
+extern ssize_t		backendDataWrite(backend_data_t *data,
+			                 size_t max_bytes);
 extern int		backendDrainOutput(int print_fd, int device_fd);
 extern int		backendGetDeviceID(int fd, char *device_id,
 			                   int device_id_size,
@@ -22,6 +22,7 @@
 #include "backend-private.h"
 #include <cups/array.h>
 #include <ctype.h>
+#include <sys/stat.h>
 
 /*
  * Local globals...
@@ -33,9 +34,17 @@ static int		job_canceled = 0; /* Set to 1 on SIGTERM */
  * Local functions...
  */
 
+static void		backend_cmdline(char *uri, int argc, char **argv,
+					char *filename, char *cmdline,
+					size_t cmdsize);
 static int		call_backend(char *uri, int argc, char **argv,
 				     char *tempfile);
+static int		open_spool(char *tmpfilename, size_t tmpsize);
 static void		sigterm_handler(int sig);
+static int		spool_data(int spoolfd, int *backendfd);
+static int		stream_backend(char *uri, int argc, char **argv,
+				       int spoolfd, int *spooled);
+static int		write_data(int fd, const char *buf, ssize_t bytes);
 
 
 /*
@@ -46,8 +55,11 @@ int					/* O - Exit status */
 main(int  argc,				/* I - Number of command-line args */
      char *argv[]) {			/* I - Command-line arguments */
   char *uri, *ptr, *filename;
-  char tmpfilename[1024], buf[8192];
-  int dd, att, delay, retval;
+  char tmpfilename[1024], fdfilename[32];
+  int dd, att, delay, retval, stream, spooled;
+  int num_options;
+  cups_option_t *options;
+  const char *val;
 #if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
   struct sigaction action;		/* Actions for POSIX signals */
 #endif /* HAVE_SIGACTION && !HAVE_SIGSET */
@@ -131,44 +143,65 @@ main(int  argc,				/* I - Number of command-line args */
 	  dd, att, delay, ptr);
 
  /*
-  * If reading from stdin, write everything into a temporary file
+  * The "beh-stream" option (set it on the queue with
+  * "lpadmin -p <queue> -o beh-stream-default=true") has the first attempt
+  * get the job from stdin while it is being spooled...
   */
 
+  num_options = cupsParseOptions(argv[5], 0, &options);
+  stream = ((val = cupsGetOption("beh-stream", num_options, options)) !=
+	    NULL &&
+	    (!strcasecmp(val, "true") || !strcasecmp(val, "on") ||
+	     !strcasecmp(val, "yes")));
+  cupsFreeOptions(num_options, options);
+
+ /*
+  * Do it! A job file from CUPS is passed on as it is, a job from stdin
+  * gets spooled into a temporary file for the retries...
+  */
+
+  tmpfilename[0] = '\0';
+
   if (argc == 6) {
-    char *tmpdir;
     int fd;
-    FILE *tmpfile;
-    size_t bytes;
-
-    tmpdir = getenv("TMPDIR");
-    if (!tmpdir)
-      tmpdir = "/tmp";
-    snprintf(tmpfilename, sizeof(tmpfilename), "%s/beh-XXXXXX", tmpdir);
-    fd = mkstemp(tmpfilename);
-    if (fd < 0) {
+
+    if ((fd = open_spool(tmpfilename, sizeof(tmpfilename))) < 0) {
       fprintf(stderr,
 	      "ERROR: beh: Could not create temporary file: %s\n",
 	      strerror(errno));
       return (CUPS_BACKEND_FAILED);
     }
-    tmpfile = fdopen(fd, "r+");
-    while ((bytes = fread(buf, 1, sizeof(buf), stdin)))
-      fwrite(buf, 1, bytes, tmpfile);
-    fclose(tmpfile);
-		    
-    filename = tmpfilename;
-  } else {
-    tmpfilename[0] = '\0';
+
+    if (tmpfilename[0])
+      filename = tmpfilename;
+    else {
+      snprintf(fdfilename, sizeof(fdfilename), "/dev/fd/%d", fd);
+      filename = fdfilename;
+    }
+
+    if (stream)
+      retval = stream_backend(ptr, argc, argv, fd, &spooled);
+    else {
+      spooled = !spool_data(fd, NULL);
+      retval  = CUPS_BACKEND_FAILED;
+    }
+
+    if (!spooled && retval != CUPS_BACKEND_OK) {
+      if (!job_canceled)
+	fprintf(stderr,
+		"ERROR: beh: Could not write temporary file: %s\n",
+		strerror(errno));
+      if (tmpfilename[0])
+	unlink(tmpfilename);
+      return (CUPS_BACKEND_FAILED);
+    }
+  } else
     filename = argv[6];
-  }
 
- /*
-  * Do it!
-  */
+  if (!stream || argc != 6)
+    retval = call_backend(ptr, argc, argv, filename);
 
-  while ((retval = call_backend(ptr, argc, argv, filename)) !=
-	 CUPS_BACKEND_OK &&
-	 !job_canceled) {
+  while (retval != CUPS_BACKEND_OK && !job_canceled) {
     if (att > 0) {
       att --;
       if (att == 0)
@@ -176,6 +209,7 @@ main(int  argc,				/* I - Number of command-line args */
     }
     if (delay > 0)
       sleep (delay);
+    retval = call_backend(ptr, argc, argv, filename);
   }
 
   if (strlen(tmpfilename) > 0)
@@ -203,24 +237,21 @@ main(int  argc,				/* I - Number of command-line args */
 
 
 /*
- * 'call_backend()' - Execute the command line of the destination backend
+ * 'backend_cmdline()' - Build the command line of the destination backend
  */
 
-static int
-call_backend(char *uri,                 /* I - URI of final destination */
-	     int  argc,                 /* I - Number of command line
-	                                       arguments */
-	     char **argv,		/* I - Command-line arguments */
-	     char *filename) {          /* I - File name of input data */
+static void
+backend_cmdline(char   *uri,		/* I - URI of final destination */
+		int    argc,		/* I - Number of command line
+					       arguments */
+		char   **argv,		/* I - Command-line arguments */
+		char   *filename,	/* I - File name of input data or
+					       NULL for stdin */
+		char   *cmdline,	/* O - Command line */
+		size_t cmdsize) {	/* I - Size of command line buffer */
   const char	*cups_serverbin;	/* Location of programs */
   char		scheme[1024],           /* Scheme from URI */
-                *ptr,			/* Pointer into scheme */
-		cmdline[65536];		/* Backend command line */
-  int           retval;
-
- /*
-  * Build the backend command line...
-  */
+                *ptr;			/* Pointer into scheme */
 
   strncpy(scheme, uri, sizeof(scheme) - 1);
   if (strlen(uri) > 1023)
@@ -236,7 +267,7 @@ call_backend(char *uri,                 /* I - URI of final destination */
 	    "ERROR: beh: Direct output into a file not supported.\n");
     exit (CUPS_BACKEND_FAILED);
   } else
-    snprintf(cmdline, sizeof(cmdline),
+    snprintf(cmdline, cmdsize,
 	     "%s/backend/%s '%s' '%s' '%s' '%s' '%s' %s",
 	     cups_serverbin, scheme, argv[1], argv[2], argv[3],
 	     /* Apply number of copies only if beh was called with a
@@ -244,10 +275,10 @@ call_backend(char *uri,                 /* I - URI of final destination */
 	        backends should handle copies only if they are called
 	        with a file name */
 	     (argc == 6 ? "1" : argv[4]),
-	     argv[5], filename);
+	     argv[5], filename ? filename : "");
 
  /*
-  * Overwrite the device URI and run the actual backend...
+  * Overwrite the device URI for the actual backend...
   */
 
   setenv("DEVICE_URI", uri, 1);
@@ -258,6 +289,27 @@ call_backend(char *uri,                 /* I - URI of final destination */
   fprintf(stderr,
 	  "DEBUG: beh: Using device URI: %s\n",
 	  uri);
+}
+
+
+/*
+ * 'call_backend()' - Execute the command line of the destination backend
+ */
+
+static int
+call_backend(char *uri,                 /* I - URI of final destination */
+	     int  argc,                 /* I - Number of command line
+	                                       arguments */
+	     char **argv,		/* I - Command-line arguments */
+	     char *filename) {          /* I - File name of input data */
+  char		cmdline[65536];		/* Backend command line */
+  int           retval;
+
+ /*
+  * Build the backend command line and run the actual backend...
+  */
+
+  backend_cmdline(uri, argc, argv, filename, cmdline, sizeof(cmdline));
 
   retval = system(cmdline) >> 8;
 
@@ -269,6 +321,35 @@ call_backend(char *uri,                 /* I - URI of final destination */
 }
 
 
+/*
+ * 'open_spool()' - Create the temporary file for the job data
+ *
+ * Where the system supports it the file has no name, so nothing is left
+ * behind if beh gets killed; the backend then reads it as /dev/fd/<n>...
+ */
+
+static int
+open_spool(char   *tmpfilename,		/* O - File name or "" if unnamed */
+	   size_t tmpsize) {		/* I - Size of file name buffer */
+  const char	*tmpdir;		/* Temporary directory */
+  int		fd;			/* File descriptor */
+
+  tmpdir = getenv("TMPDIR");
+  if (!tmpdir)
+    tmpdir = "/tmp";
+
+#ifdef O_TMPFILE
+  if ((fd = open(tmpdir, O_TMPFILE | O_RDWR, 0600)) >= 0) {
+    tmpfilename[0] = '\0';
+    return (fd);
+  }
+#endif /* O_TMPFILE */
+
+  snprintf(tmpfilename, tmpsize, "%s/beh-XXXXXX", tmpdir);
+  return (mkstemp(tmpfilename));
+}
+
+
 /*
  * 'sigterm_handler()' - Handle termination signals.
  */
@@ -285,3 +366,163 @@ sigterm_handler(int sig) {		/* I - Signal number (unused) */
   else
     job_canceled = 1;
 }
+
+
+/*
+ * 'spool_data()' - Copy the job data from stdin into the temporary file
+ *
+ * With a backend descriptor the data also goes to the backend; it is set
+ * to -1 when the backend stops reading, and spooling goes on...
+ */
+
+static int				/* O - 0 on success, -1 on error */
+spool_data(int spoolfd,			/* I - Temporary file */
+	   int *backendfd) {		/* IO - Pipe to backend or NULL */
+  char		buf[65536];		/* Copy buffer */
+  ssize_t	bytes;			/* Bytes read */
+#ifdef HAVE_SPLICE
+  ssize_t	teed, moved;		/* Bytes duplicated/moved */
+  struct stat	st;			/* Type of stdin */
+
+ /*
+  * Our input usually is a pipe from the last filter; let the kernel move
+  * the data into the file, and duplicate it into the backend's pipe,
+  * without copying it through user space...
+  */
+
+  if (!fstat(0, &st) && S_ISFIFO(st.st_mode)) {
+    while (!job_canceled) {
+      if (backendfd && *backendfd >= 0) {
+	if ((teed = tee(0, *backendfd, 1 << 20, 0)) < 0) {
+	  if (errno == EINTR)
+	    continue;
+	  if (errno != EPIPE)
+	    return (-1);
+
+	  fputs("DEBUG: beh: Backend stopped reading, spooling the rest.\n",
+		stderr);
+	  *backendfd = -1;
+	  continue;
+	} else if (teed == 0)
+	  return (0);
+      } else
+	teed = 1 << 20;
+
+     /*
+      * Move exactly what went to the backend, so that nothing gets sent
+      * twice...
+      */
+
+      do {
+	if ((moved = splice(0, NULL, spoolfd, NULL, teed,
+			    SPLICE_F_MOVE | SPLICE_F_MORE)) < 0) {
+	  if (errno == EINTR)
+	    continue;
+	  return (-1);
+	} else if (moved == 0)
+	  return (0);
+
+	if (backendfd && *backendfd >= 0)
+	  teed -= moved;
+	else
+	  teed = 0;
+      } while (teed > 0);
+    }
+
+    return (-1);
+  }
+#endif /* HAVE_SPLICE */
+
+  while ((bytes = read(0, buf, sizeof(buf))) != 0 && !job_canceled) {
+    if (bytes < 0) {
+      if (errno == EINTR)
+	continue;
+      return (-1);
+    }
+    if (write_data(spoolfd, buf, bytes))
+      return (-1);
+    if (backendfd && *backendfd >= 0 &&
+	write_data(*backendfd, buf, bytes)) {
+      fputs("DEBUG: beh: Backend stopped reading, spooling the rest.\n",
+	    stderr);
+      *backendfd = -1;
+    }
+  }
+
+  return (job_canceled ? -1 : 0);
+}
+
+
+/*
+ * 'stream_backend()' - Execute the destination backend on the job data
+ *                      while spooling it
+ */
+
+static int
+stream_backend(char *uri,		/* I - URI of final destination */
+	       int  argc,		/* I - Number of command line
+					       arguments */
+	       char **argv,		/* I - Command-line arguments */
+	       int  spoolfd,		/* I - Temporary file */
+	       int  *spooled) {		/* O - 1 if all data got spooled */
+  char		cmdline[65536];		/* Backend command line */
+  FILE		*backend;		/* Pipe to backend */
+  int		backendfd;		/* Descriptor of pipe */
+  int           retval;
+  void		(*oldpipe)(int);	/* Previous SIGPIPE handler */
+
+ /*
+  * Start the backend on a pipe; without a file name it reads its stdin...
+  */
+
+  backend_cmdline(uri, argc, argv, NULL, cmdline, sizeof(cmdline));
+
+  if ((backend = popen(cmdline, "w")) == NULL) {
+    fprintf(stderr, "ERROR: Unable to execute backend command line: %s\n",
+	    strerror(errno));
+    *spooled = !spool_data(spoolfd, NULL);
+    return (CUPS_BACKEND_FAILED);
+  }
+
+ /*
+  * A backend that fails early must not take beh with it, the rest of the
+  * job still goes into the file for the retries...
+  */
+
+  oldpipe   = signal(SIGPIPE, SIG_IGN);
+  backendfd = fileno(backend);
+  *spooled  = !spool_data(spoolfd, &backendfd);
+  signal(SIGPIPE, oldpipe);
+
+  retval = pclose(backend) >> 8;
+
+  if (retval == -1)
+    fprintf(stderr, "ERROR: Unable to execute backend command line: %s\n",
+	    strerror(errno));
+
+  return (retval);
+}
+
+
+/*
+ * 'write_data()' - Write a buffer completely
+ */
+
+static int				/* O - 0 on success, -1 on error */
+write_data(int        fd,		/* I - File descriptor */
+	   const char *buf,		/* I - Data */
+	   ssize_t    bytes) {		/* I - Number of bytes */
+  ssize_t	written;		/* Bytes written */
+
+  while (bytes > 0) {
+    if ((written = write(fd, buf, bytes)) < 0) {
+      if (errno == EINTR)
+	continue;
+      return (-1);
+    }
+    buf   += written;
+    bytes -= written;
+  }
+
+  return (0);
+}
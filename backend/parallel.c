@@ -12,7 +12,6 @@
  * Contents:
  *
  *   main()         - Send a file to the specified parallel port.
- *   drain_output() - Drain pending print data to the device.
  *   list_devices() - List all parallel devices.
  *   run_loop()     - Read and write print and back-channel data.
  *   side_cb()      - Handle side-channel requests...
@@ -33,11 +32,10 @@
  * Local functions...
  */
 
-static int	drain_output(int print_fd, int device_fd);
 static void	list_devices(void);
 static ssize_t	run_loop(int print_fd, int device_fd, int use_bc,
 		         int update_state);
-static int	side_cb(int print_fd, int device_fd, int use_bc);
+static int	side_cb(backend_data_t *data, int use_bc);
 
 
 /*
@@ -272,105 +270,6 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 }
 
 
-/*
- * 'drain_output()' - Drain pending print data to the device.
- */
-
-static int				/* O - 0 on success, -1 on error */
-drain_output(int print_fd,		/* I - Print file descriptor */
-             int device_fd)		/* I - Device file descriptor */
-{
-  int		nfds;			/* Maximum file descriptor value + 1 */
-  fd_set	input;			/* Input set for reading */
-  ssize_t	print_bytes,		/* Print bytes read */
-		bytes;			/* Bytes written */
-  char		print_buffer[8192],	/* Print data buffer */
-		*print_ptr;		/* Pointer into print data buffer */
-  struct timeval timeout;		/* Timeout for read... */
-
-
- /*
-  * Figure out the maximum file descriptor value to use with select()...
-  */
-
-  nfds = (print_fd > device_fd ? print_fd : device_fd) + 1;
-
- /*
-  * Now loop until we are out of data from print_fd...
-  */
-
-  for (;;)
-  {
-   /*
-    * Use select() to determine whether we have data to copy around...
-    */
-
-    FD_ZERO(&input);
-    FD_SET(print_fd, &input);
-
-    timeout.tv_sec  = 0;
-    timeout.tv_usec = 0;
-
-    if (select(nfds, &input, NULL, NULL, &timeout) < 0)
-      return (-1);
-
-    if (!FD_ISSET(print_fd, &input))
-      return (0);
-
-    if ((print_bytes = read(print_fd, print_buffer,
-			    sizeof(print_buffer))) < 0)
-    {
-     /*
-      * Read error - bail if we don't see EAGAIN or EINTR...
-      */
-
-      if (errno != EAGAIN && errno != EINTR)
-      {
-        perror("ERROR: Unable to read print data");
-	return (-1);
-      }
-
-      print_bytes = 0;
-    }
-    else if (print_bytes == 0)
-    {
-     /*
-      * End of file, return...
-      */
-
-      return (0);
-    }
-
-    fprintf(stderr, "DEBUG: Read %d bytes of print data.\n",
-	    (int)print_bytes);
-
-    for (print_ptr = print_buffer; print_bytes > 0;)
-    {
-      if ((bytes = write(device_fd, print_ptr, print_bytes)) < 0)
-      {
-       /*
-        * Write error - bail if we don't see an error we can retry...
-	*/
-
-        if (errno != ENOSPC && errno != ENXIO && errno != EAGAIN &&
-	    errno != EINTR && errno != ENOTTY)
-	{
-	  perror("ERROR: Unable to write print data");
-	  return (-1);
-	}
-      }
-      else
-      {
-        fprintf(stderr, "DEBUG: Wrote %d bytes of print data.\n", (int)bytes);
-
-        print_bytes -= bytes;
-	print_ptr   += bytes;
-      }
-    }
-  }
-}
-
-
 /*
  * 'list_devices()' - List all parallel devices.
  */
@@ -541,19 +440,14 @@ run_loop(int print_fd,			/* I - Print file descriptor */
 	int use_bc,			/* I - Use back-channel? */
 	int update_state)		/* I - Update printer-state-reasons? */
 {
-  int		nfds;			/* Maximum file descriptor value + 1 */
-  fd_set	input,			/* Input set for reading */
-		output;			/* Output set for writing */
-  ssize_t	print_bytes,		/* Print bytes read */
-		bc_bytes,		/* Backchannel bytes read */
-		total_bytes,		/* Total bytes written */
+  backend_data_t data;			/* Print data buffering */
+  struct pollfd	pfds[3];		/* Descriptors to poll */
+  int		num_pfds;		/* Number of descriptors */
+  ssize_t	bc_bytes,		/* Backchannel bytes read */
 		bytes;			/* Bytes written */
   int		paperout;		/* "Paper out" status */
   int		offline;		/* "Off-line" status */
-  char		print_buffer[8192],	/* Print data buffer */
-		*print_ptr,		/* Pointer into print data buffer */
-		bc_buffer[1024];	/* Back-channel data buffer */
-  struct timeval timeout;		/* Timeout for select() */
+  char		bc_buffer[1024];	/* Back-channel data buffer */
   int           sc_ok;                  /* Flag a side channel error and
 					   stop using the side channel
 					   in such a case. */
@@ -593,11 +487,12 @@ run_loop(int print_fd,			/* I - Print file descriptor */
   }
 
  /*
-  * Figure out the maximum file descriptor value to use with select()...
+  * Buffer the print data in large chunks, or splice it straight from the
+  * filter pipe to the device...
   */
 
-  nfds = (print_fd > device_fd ? print_fd : device_fd) + 1;
-
+  if (backendDataInit(&data, print_fd, device_fd))
+    return (-1);
 
  /*
   * Side channel is OK...
@@ -609,29 +504,30 @@ run_loop(int print_fd,			/* I - Print file descriptor */
   * Now loop until we are out of data from print_fd...
   */
 
-  for (print_bytes = 0, print_ptr = print_buffer, offline = -1,
-           paperout = -1, total_bytes = 0;;)
+  for (offline = -1, paperout = -1; !data.eof || backendDataWantWrite(&data);)
   {
    /*
-    * Use select() to determine whether we have data to copy around...
+    * Use poll() to determine whether we have data to copy around...
     */
 
-    FD_ZERO(&input);
-    if (!print_bytes)
-      FD_SET(print_fd, &input);
-    if (use_bc)
-      FD_SET(device_fd, &input);
-    if (!print_bytes && sc_ok)
-      FD_SET(CUPS_SC_FD, &input);
+    pfds[0].fd      = print_fd;
+    pfds[0].events  = backendDataWantRead(&data) ? POLLIN : 0;
+    pfds[0].revents = 0;
+    pfds[1].fd      = device_fd;
+    pfds[1].events  = (use_bc ? POLLIN : 0) |
+                      (backendDataWantWrite(&data) ? POLLOUT : 0);
+    pfds[1].revents = 0;
+    num_pfds        = 2;
 
-    FD_ZERO(&output);
-    if (print_bytes)
-      FD_SET(device_fd, &output);
-
-    timeout.tv_sec  = 5;
-    timeout.tv_usec = 0;
+    if (sc_ok)
+    {
+      pfds[2].fd      = CUPS_SC_FD;
+      pfds[2].events  = POLLIN;
+      pfds[2].revents = 0;
+      num_pfds        = 3;
+    }
 
-    if (select(nfds, &input, &output, NULL, &timeout) < 0)
+    if (backendDataPoll(&data, pfds, num_pfds, 5000) < 0)
     {
      /*
       * Pause printing to clear any pending errors...
@@ -642,10 +538,11 @@ run_loop(int print_fd,			/* I - Print file descriptor */
 	fputs("STATE: +offline-report\n", stderr);
 	offline = 1;
       }
-      else if (errno == EINTR && total_bytes == 0)
+      else if (errno == EINTR && data.total_bytes == 0)
       {
 	fputs("DEBUG: Received an interrupt before any bytes were "
 	      "written, aborting.\n", stderr);
+	backendDataFree(&data);
 	return (0);
       }
 
@@ -657,18 +554,18 @@ run_loop(int print_fd,			/* I - Print file descriptor */
     * Check if we have a side-channel request ready...
     */
 
-    if (sc_ok && FD_ISSET(CUPS_SC_FD, &input))
+    if (sc_ok && pfds[2].revents)
     {
      /*
-      * Do the side-channel request, then start back over in the select
-      * loop since it may have read from print_fd...
+      * Do the side-channel request, then start back over in the poll
+      * loop since it may have sent print data...
       *
       * If the side channel processing errors, go straight on to avoid
       * blocking of the backend by side channel problems, deactivate the side
       * channel.
       */
 
-      if (side_cb(print_fd, device_fd, use_bc))
+      if (side_cb(&data, use_bc))
 	sc_ok = 0;
       continue;
     }
@@ -677,7 +574,7 @@ run_loop(int print_fd,			/* I - Print file descriptor */
     * Check if we have back-channel data ready...
     */
 
-    if (FD_ISSET(device_fd, &input))
+    if (use_bc && (pfds[1].revents & (POLLIN | POLLERR | POLLHUP)))
     {
       if ((bc_bytes = read(device_fd, bc_buffer, sizeof(bc_buffer))) > 0)
       {
@@ -698,10 +595,9 @@ run_loop(int print_fd,			/* I - Print file descriptor */
     * Check if we have print data ready...
     */
 
-    if (FD_ISSET(print_fd, &input))
+    if (pfds[0].events && (pfds[0].revents & (POLLIN | POLLHUP)))
     {
-      if ((print_bytes = read(print_fd, print_buffer,
-                              sizeof(print_buffer))) < 0)
+      if (backendDataRead(&data) < 0)
       {
        /*
         * Read error - bail if we don't see EAGAIN or EINTR...
@@ -710,24 +606,10 @@ run_loop(int print_fd,			/* I - Print file descriptor */
 	if (errno != EAGAIN && errno != EINTR)
 	{
 	  perror("ERROR: Unable to read print data");
+	  backendDataFree(&data);
 	  return (-1);
 	}
-
-        print_bytes = 0;
       }
-      else if (print_bytes == 0)
-      {
-       /*
-        * End of file, break out of the loop...
-	*/
-
-        break;
-      }
-
-      print_ptr = print_buffer;
-
-      fprintf(stderr, "DEBUG: Read %d bytes of print data.\n",
-              (int)print_bytes);
     }
 
    /*
@@ -735,9 +617,10 @@ run_loop(int print_fd,			/* I - Print file descriptor */
     * send...
     */
 
-    if (print_bytes && FD_ISSET(device_fd, &output))
+    if (backendDataWantWrite(&data) &&
+        (pfds[1].revents & (POLLOUT | POLLERR | POLLHUP)))
     {
-      if ((bytes = write(device_fd, print_ptr, print_bytes)) < 0)
+      if ((bytes = backendDataWrite(&data, 0)) < 0)
       {
        /*
         * Write error - bail if we don't see an error we can retry...
@@ -762,10 +645,11 @@ run_loop(int print_fd,			/* I - Print file descriptor */
 	else if (errno != EAGAIN && errno != EINTR && errno != ENOTTY)
 	{
 	  perror("ERROR: Unable to write print data");
+	  backendDataFree(&data);
 	  return (-1);
 	}
       }
-      else
+      else if (bytes > 0)
       {
         if (paperout && update_state)
 	{
@@ -778,12 +662,6 @@ run_loop(int print_fd,			/* I - Print file descriptor */
 	  fputs("STATE: -offline-report\n", stderr);
 	  offline = 0;
 	}
-
-        fprintf(stderr, "DEBUG: Wrote %d bytes of print data...\n", (int)bytes);
-
-        print_bytes -= bytes;
-	print_ptr   += bytes;
-	total_bytes += bytes;
       }
     }
   }
@@ -792,7 +670,10 @@ run_loop(int print_fd,			/* I - Print file descriptor */
   * Return with success...
   */
 
-  return (total_bytes);
+  backendDataReport(&data, 1);
+  backendDataFree(&data);
+
+  return ((ssize_t)data.total_bytes);
 }
 
 
@@ -801,9 +682,8 @@ run_loop(int print_fd,			/* I - Print file descriptor */
  */
 
 static int				/* O - 0 on success, -1 on error */
-side_cb(int         print_fd,		/* I - Print file */
-        int         device_fd,		/* I - Device file */
-	int         use_bc)		/* I - Using back-channel? */
+side_cb(backend_data_t *print_data,	/* I - Print data */
+	int            use_bc)		/* I - Using back-channel? */
 {
   cups_sc_command_t	command;	/* Request command */
   cups_sc_status_t	status;		/* Request/response status */
@@ -819,9 +699,9 @@ side_cb(int         print_fd,		/* I - Print file */
   switch (command)
   {
     case CUPS_SC_CMD_DRAIN_OUTPUT :
-        if (drain_output(print_fd, device_fd))
+        if (backendDataDrain(print_data))
 	  status = CUPS_SC_STATUS_IO_ERROR;
-	else if (tcdrain(device_fd))
+	else if (tcdrain(print_data->device_fd))
 	  status = CUPS_SC_STATUS_IO_ERROR;
 	else
 	  status = CUPS_SC_STATUS_OK;
@@ -838,7 +718,7 @@ side_cb(int         print_fd,		/* I - Print file */
     case CUPS_SC_CMD_GET_DEVICE_ID :
         memset(data, 0, sizeof(data));
 
-        if (backendGetDeviceID(device_fd, data, sizeof(data) - 1,
+        if (backendGetDeviceID(print_data->device_fd, data, sizeof(data) - 1,
 	                       NULL, 0, NULL, NULL, 0))
         {
 	  status  = CUPS_SC_STATUS_NOT_IMPLEMENTED;
@@ -0,0 +1,422 @@
+/*
+ *   Print data buffering for OpenPrinting CUPS Filters backends.
+ *
+ *   These coded instructions, statements, and computer programs are the
+ *   property of Apple Inc. and are protected by Federal copyright
+ *   law.  Distribution and use rights are outlined in the file "COPYING"
+ *   which should have been included with this file.
+ *
+ * Contents:
+ *
+ *   backendDataDrain()     - Send all print data that is available now.
+ *   backendDataFree()      - Free the print data buffer.
+ *   backendDataInit()      - Set up print data buffering.
+ *   backendDataPoll()      - Wait for print data or the device.
+ *   backendDataRead()      - Read print data into the buffer.
+ *   backendDataReport()    - Report the print data throughput.
+ *   backendDataWantRead()  - Is there room for more print data?
+ *   backendDataWantWrite() - Is there print data for the device?
+ *   backendDataWrite()     - Write buffered print data to the device.
+ *   data_time()            - Get the current time in seconds.
+ *
+ * Print data is read into a large ring buffer while the device is busy so
+ * that the filters are not held up by small writes.  When the print data
+ * comes from a pipe, the pipe itself is enlarged to serve as the buffer
+ * and splice() moves the data to the device without copying it through
+ * user space; terminals and devices that cannot splice use the ring
+ * buffer.
+ */
+
+/*
+ * Include necessary headers.
+ */
+
+#include "backend-private.h"
+#include <sys/stat.h>
+#include <sys/time.h>
+
+
+/*
+ * Constants...
+ */
+
+#define DATA_BUFSIZE	262144		/* Size of ring buffer */
+#define DATA_PIPESIZE	1048576		/* Size to make input pipes */
+#define DATA_REPORT	10.0		/* Seconds between reports */
+
+
+/*
+ * Local functions...
+ */
+
+static double	data_time(void);
+
+
+/*
+ * 'backendDataDrain()' - Send all print data that is available now.
+ *
+ * This writes the buffered data and then copies whatever else the print
+ * file has without waiting for more, for CUPS_SC_CMD_DRAIN_OUTPUT...
+ */
+
+int					/* O - 0 on success, -1 on error */
+backendDataDrain(backend_data_t *data)	/* I - Print data */
+{
+  struct pollfd	pfd;			/* Print file to poll */
+
+
+  for (;;)
+  {
+    while (backendDataWantWrite(data))
+    {
+      if (backendDataWrite(data, 0) < 0 && errno != ENOSPC && errno != ENXIO &&
+          errno != EAGAIN && errno != EINTR && errno != ENOTTY)
+      {
+	perror("ERROR: Unable to write print data");
+	return (-1);
+      }
+    }
+
+    if (data->eof)
+      return (0);
+
+    pfd.fd     = data->print_fd;
+    pfd.events = POLLIN;
+
+    if (poll(&pfd, 1, 0) < 0)
+      return (-1);
+
+    if (!pfd.revents)
+      return (0);
+
+    if (backendDataRead(data) < 0 && errno != EAGAIN && errno != EINTR)
+    {
+      perror("ERROR: Unable to read print data");
+      return (-1);
+    }
+  }
+}
+
+
+/*
+ * 'backendDataFree()' - Free the print data buffer.
+ */
+
+void
+backendDataFree(backend_data_t *data)	/* I - Print data */
+{
+  free(data->buffer);
+  data->buffer = NULL;
+}
+
+
+/*
+ * 'backendDataInit()' - Set up print data buffering.
+ */
+
+int					/* O - 0 on success, -1 on error */
+backendDataInit(backend_data_t *data,	/* O - Print data */
+                int            print_fd,/* I - Print file descriptor */
+		int            device_fd)/* I - Device file descriptor */
+{
+#ifdef HAVE_SPLICE
+  struct stat	fileinfo;		/* Print file information */
+#endif /* HAVE_SPLICE */
+
+
+  memset(data, 0, sizeof(backend_data_t));
+
+  data->print_fd  = print_fd;
+  data->device_fd = device_fd;
+  data->size      = DATA_BUFSIZE;
+
+  if ((data->buffer = malloc(data->size)) == NULL)
+  {
+    perror("ERROR: Unable to allocate print buffer");
+    return (-1);
+  }
+
+#ifdef HAVE_SPLICE
+ /*
+  * Terminals copy the data through the line discipline anyway, and are
+  * slower to splice into in the small chunks the serial backend uses...
+  */
+
+  if (!fstat(print_fd, &fileinfo) && S_ISFIFO(fileinfo.st_mode) &&
+      !isatty(device_fd))
+  {
+    data->use_splice = 1;
+
+#  ifdef F_SETPIPE_SZ
+    if (fcntl(print_fd, F_GETPIPE_SZ) < DATA_PIPESIZE)
+      fcntl(print_fd, F_SETPIPE_SZ, DATA_PIPESIZE);
+#  endif /* F_SETPIPE_SZ */
+  }
+#endif /* HAVE_SPLICE */
+
+  return (0);
+}
+
+
+/*
+ * 'backendDataPoll()' - Wait for print data or the device.
+ *
+ * Time spent waiting with print data pending counts as device stall time,
+ * time spent waiting with nothing to send as idle time...
+ */
+
+int					/* O - Number of ready descriptors */
+backendDataPoll(backend_data_t *data,	/* I - Print data */
+                struct pollfd  *pfds,	/* I - Descriptors to poll */
+		int            num_pfds,/* I - Number of descriptors */
+		int            timeout)	/* I - Timeout in milliseconds */
+{
+  int		ready;			/* Number of ready descriptors */
+  int		pending;		/* Print data pending? */
+  double	start;			/* Start of wait */
+
+
+  pending = backendDataWantWrite(data);
+  start   = data_time();
+  ready   = poll(pfds, num_pfds, timeout);
+
+  if (data->start_time && !data->eof)
+  {
+    if (pending)
+      data->stall_time += data_time() - start;
+    else
+      data->idle_time += data_time() - start;
+  }
+
+  backendDataReport(data, 0);
+
+  return (ready);
+}
+
+
+/*
+ * 'backendDataRead()' - Read print data into the buffer.
+ *
+ * Call this when the print file is readable.  With splice() this only
+ * notes that data is waiting in the pipe...
+ */
+
+ssize_t					/* O - Bytes read, 0 on EOF or full, -1 on error */
+backendDataRead(backend_data_t *data)	/* I - Print data */
+{
+  size_t	end,			/* End of pending data */
+		bytes;			/* Free bytes after it */
+  ssize_t	count;			/* Bytes read */
+
+
+  if (data->use_splice)
+  {
+    data->ready = 1;
+    return (1);
+  }
+
+ /*
+  * poll() reports POLLHUP even when we did not ask for more data, so don't
+  * overwrite pending data when the buffer is full...
+  */
+
+  if (data->used >= data->size)
+    return (0);
+
+  if ((end = data->start + data->used) >= data->size)
+    end -= data->size;
+
+  if (end >= data->start)
+    bytes = data->size - end;
+  else
+    bytes = data->start - end;
+
+  if ((count = read(data->print_fd, data->buffer + end, bytes)) > 0)
+    data->used += count;
+  else if (count == 0)
+    data->eof = 1;
+
+  return (count);
+}
+
+
+/*
+ * 'backendDataReport()' - Report the print data throughput.
+ *
+ * Reports are sent every few seconds while printing and once at the end...
+ */
+
+void
+backendDataReport(backend_data_t *data,	/* I - Print data */
+                  int            final)	/* I - End of the print data? */
+{
+  double	now,			/* Current time */
+		secs;			/* Seconds since first write */
+
+
+  if (!data->start_time)
+    return;
+
+  now = data_time();
+
+  if (!final && now < data->report_time + DATA_REPORT)
+    return;
+
+  data->report_time = now;
+
+  if ((secs = now - data->start_time) < 0.001)
+    secs = 0.001;
+
+  fprintf(stderr,
+          "DEBUG: %s %lld bytes in %.1f seconds (%.0f bytes/sec%s), "
+	  "%.1f seconds waiting for the device, %.1f seconds for print data.\n",
+	  final ? "Sent" : "Sending", (long long)data->total_bytes, secs,
+	  data->total_bytes / secs, data->use_splice ? ", spliced" : "",
+	  data->stall_time, data->idle_time);
+}
+
+
+/*
+ * 'backendDataWantRead()' - Is there room for more print data?
+ */
+
+int					/* O - 1 if print data can be read */
+backendDataWantRead(backend_data_t *data)/* I - Print data */
+{
+  if (data->eof)
+    return (0);
+  else if (data->use_splice)
+    return (!data->ready);
+  else
+    return (data->used < data->size);
+}
+
+
+/*
+ * 'backendDataWantWrite()' - Is there print data for the device?
+ */
+
+int					/* O - 1 if print data is pending */
+backendDataWantWrite(backend_data_t *data)/* I - Print data */
+{
+  return (data->ready || data->used > 0);
+}
+
+
+/*
+ * 'backendDataWrite()' - Write buffered print data to the device.
+ *
+ * Call this when the device is writable.  Returns 0 when splice() finds
+ * nothing to send after all, so that the caller polls again...
+ */
+
+ssize_t					/* O - Bytes written or -1 on error */
+backendDataWrite(backend_data_t *data,	/* I - Print data */
+                 size_t         max_bytes)
+					/* I - Maximum bytes to write or 0 */
+{
+  size_t	bytes;			/* Bytes to write */
+  ssize_t	count;			/* Bytes written */
+  double	start;			/* Start of write */
+
+
+ /*
+  * Devices like the parallel port block in write() rather than poll(),
+  * so the time spent writing counts as waiting for the device too...
+  */
+
+  start = data_time();
+
+  if (!data->start_time)
+    data->start_time = data->report_time = start;
+
+#ifdef HAVE_SPLICE
+  if (data->use_splice)
+  {
+    bytes = max_bytes ? max_bytes : DATA_PIPESIZE;
+
+    count = splice(data->print_fd, NULL, data->device_fd, NULL, bytes,
+                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+    data->stall_time += data_time() - start;
+
+    if (count > 0)
+    {
+      data->total_bytes += count;
+      return (count);
+    }
+
+    if (count == 0)
+    {
+     /*
+      * End of file...
+      */
+
+      data->ready = 0;
+      data->eof   = 1;
+      return (0);
+    }
+    else if (errno == EAGAIN)
+    {
+     /*
+      * The pipe is empty; poll for more...
+      */
+
+      data->ready = 0;
+      return (0);
+    }
+    else if (errno == EINVAL)
+    {
+     /*
+      * The device does not support splice(), copy the data ourselves...
+      */
+
+      fputs("DEBUG: Device does not support splice(), using buffer.\n",
+            stderr);
+
+      data->use_splice = 0;
+      data->ready      = 0;
+      return (0);
+    }
+
+    return (-1);
+  }
+#endif /* HAVE_SPLICE */
+
+  if ((bytes = data->size - data->start) > data->used)
+    bytes = data->used;
+  if (max_bytes && bytes > max_bytes)
+    bytes = max_bytes;
+
+  count = write(data->device_fd, data->buffer + data->start, bytes);
+
+  data->stall_time += data_time() - start;
+
+  if (count > 0)
+  {
+    data->total_bytes += count;
+    data->used        -= count;
+    data->start       += count;
+
+    if (data->start >= data->size || !data->used)
+      data->start = 0;
+  }
+
+  return (count);
+}
+
+
+/*
+ * 'data_time()' - Get the current time in seconds.
+ */
+
+static double				/* O - Time in seconds */
+data_time(void)
+{
+  struct timeval	curtime;	/* Current time */
+
+
+  gettimeofday(&curtime, NULL);
+
+  return (curtime.tv_sec + curtime.tv_usec * 0.000001);
+}
@@ -26,7 +26,6 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
-#include <sys/select.h>
 #ifdef HAVE_SYS_IOCTL_H
 #  include <sys/ioctl.h>
 #endif /* HAVE_SYS_IOCTL_H */
@@ -56,9 +55,8 @@
  * Local functions...
  */
 
-static int	drain_output(int print_fd, int device_fd);
 static void	list_devices(void);
-static int	side_cb(int print_fd, int device_fd, int use_bc);
+static int	side_cb(backend_data_t *print_data, int use_bc);
 
 
 /*
@@ -86,18 +84,13 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
   int		side_eof = 0,		/* Saw EOF on side-channel? */
 		print_fd,		/* Print file */
 		device_fd;		/* Serial device */
-  int		nfds;			/* Maximum file descriptor value + 1 */
-  fd_set	input,			/* Input set for reading */
-		output;			/* Output set for writing */
-  ssize_t	print_bytes,		/* Print bytes read */
-		bc_bytes,		/* Backchannel bytes read */
-		total_bytes,		/* Total bytes written */
+  backend_data_t data;			/* Print data buffering */
+  struct pollfd	pfds[3];		/* Descriptors to poll */
+  ssize_t	bc_bytes,		/* Backchannel bytes read */
 		bytes;			/* Bytes written */
   int		dtrdsr;			/* Do dtr/dsr flow control? */
   int		print_size;		/* Size of output buffer for writes */
-  char		print_buffer[8192],	/* Print data buffer */
-		*print_ptr,		/* Pointer into print data buffer */
-		bc_buffer[1024];	/* Back-channel data buffer */
+  char		bc_buffer[1024];	/* Back-channel data buffer */
   struct termios opts;			/* Serial port options */
   struct termios origopts;		/* Original port options */
 #if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
@@ -484,24 +477,16 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 #endif /* HAVE_SIGSET */
   }
 
- /*
-  * Figure out the maximum file descriptor value to use with select()...
-  */
-
-  nfds = (print_fd > device_fd ? print_fd : device_fd) + 1;
-
  /*
   * Finally, send the print file.  Ordinarily we would just use the
   * backendRunLoop() function, however since we need to use smaller
   * writes and may need to do DSR/DTR flow control, we duplicate much
   * of the code here instead...
+  *
+  * The print data is still read in large chunks so that the filters
+  * are not held up by the slow port...
   */
 
-  if (print_size > sizeof(print_buffer))
-    print_size = sizeof(print_buffer);
-
-  total_bytes = 0;
-
   while (copies > 0)
   {
     copies --;
@@ -512,42 +497,53 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
       lseek(print_fd, 0, SEEK_SET);
     }
 
+    if (backendDataInit(&data, print_fd, device_fd))
+    {
+      tcsetattr(device_fd, TCSADRAIN, &origopts);
+
+      close(device_fd);
+
+      if (print_fd != 0)
+	close(print_fd);
+
+      return (CUPS_BACKEND_FAILED);
+    }
+
    /*
     * Now loop until we are out of data from print_fd...
     */
 
-    for (print_bytes = 0, print_ptr = print_buffer;;)
+    while (!data.eof || backendDataWantWrite(&data))
     {
      /*
-      * Use select() to determine whether we have data to copy around...
+      * Use poll() to determine whether we have data to copy around...
       */
 
-      FD_ZERO(&input);
-      if (!print_bytes)
-	FD_SET(print_fd, &input);
-      FD_SET(device_fd, &input);
-      if (!print_bytes && !side_eof)
-        FD_SET(CUPS_SC_FD, &input);
-
-      FD_ZERO(&output);
-      if (print_bytes)
-	FD_SET(device_fd, &output);
-
-      if (select(nfds, &input, &output, NULL, NULL) < 0)
+      pfds[0].fd      = print_fd;
+      pfds[0].events  = backendDataWantRead(&data) ? POLLIN : 0;
+      pfds[0].revents = 0;
+      pfds[1].fd      = device_fd;
+      pfds[1].events  = POLLIN | (backendDataWantWrite(&data) ? POLLOUT : 0);
+      pfds[1].revents = 0;
+      pfds[2].fd      = side_eof ? -1 : CUPS_SC_FD;
+      pfds[2].events  = POLLIN;
+      pfds[2].revents = 0;
+
+      if (backendDataPoll(&data, pfds, 3, -1) < 0)
 	continue;			/* Ignore errors here */
 
      /*
       * Check if we have a side-channel request ready...
       */
 
-      if (FD_ISSET(CUPS_SC_FD, &input))
+      if (pfds[2].revents)
       {
        /*
-	* Do the side-channel request, then start back over in the select
-	* loop since it may have read from print_fd...
+	* Do the side-channel request, then start back over in the poll
+	* loop since it may have sent print data...
 	*/
 
-        if (side_cb(print_fd, device_fd, 1))
+        if (side_cb(&data, 1))
 	  side_eof = 1;
 	continue;
       }
@@ -556,7 +552,7 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
       * Check if we have back-channel data ready...
       */
 
-      if (FD_ISSET(device_fd, &input))
+      if (pfds[1].revents & POLLIN)
       {
 	if ((bc_bytes = read(device_fd, bc_buffer, sizeof(bc_buffer))) > 0)
 	{
@@ -570,9 +566,9 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
       * Check if we have print data ready...
       */
 
-      if (FD_ISSET(print_fd, &input))
+      if (pfds[0].events && (pfds[0].revents & (POLLIN | POLLHUP)))
       {
-	if ((print_bytes = read(print_fd, print_buffer, print_size)) < 0)
+	if (backendDataRead(&data) < 0)
 	{
 	 /*
           * Read error - bail if we don't see EAGAIN or EINTR...
@@ -582,6 +578,8 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 	  {
 	    perror("DEBUG: Unable to read print data");
 
+	    backendDataFree(&data);
+
             tcsetattr(device_fd, TCSADRAIN, &origopts);
 
 	    close(device_fd);
@@ -591,19 +589,7 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 
 	    return (CUPS_BACKEND_FAILED);
 	  }
-
-          print_bytes = 0;
 	}
-	else if (print_bytes == 0)
-	{
-	 /*
-          * End of file, break out of the loop...
-	  */
-
-          break;
-	}
-
-	print_ptr = print_buffer;
       }
 
      /*
@@ -611,7 +597,7 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
       * send...
       */
 
-      if (print_bytes && FD_ISSET(device_fd, &output))
+      if (backendDataWantWrite(&data) && (pfds[1].revents & POLLOUT))
       {
 	if (dtrdsr)
 	{
@@ -658,7 +644,7 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 		print_sleep = 1;
 	}
 
-	if ((bytes = write(device_fd, print_ptr, print_bytes)) < 0)
+	if ((bytes = backendDataWrite(&data, print_size)) < 0)
 	{
 	 /*
           * Write error - bail if we don't see an error we can retry...
@@ -668,6 +654,8 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 	  {
 	    perror("DEBUG: Unable to write print data");
 
+	    backendDataFree(&data);
+
             tcsetattr(device_fd, TCSADRAIN, &origopts);
 
 	    close(device_fd);
@@ -678,17 +666,16 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 	    return (CUPS_BACKEND_FAILED);
 	  }
 	}
-	else
+	else if (bytes > 0)
 	{
           tcdrain(device_fd);
           fprintf(stderr, "DEBUG: Wrote %d bytes.\n", (int)bytes);
-
-          print_bytes -= bytes;
-	  print_ptr   += bytes;
-	  total_bytes += bytes;
 	}
       }
     }
+
+    backendDataReport(&data, 1);
+    backendDataFree(&data);
   }
 
  /*
@@ -706,105 +693,6 @@ main(int  argc,				/* I - Number of command-line arguments (6 or 7) */
 }
 
 
-/*
- * 'drain_output()' - Drain pending print data to the device.
- */
-
-static int				/* O - 0 on success, -1 on error */
-drain_output(int print_fd,		/* I - Print file descriptor */
-             int device_fd)		/* I - Device file descriptor */
-{
-  int		nfds;			/* Maximum file descriptor value + 1 */
-  fd_set	input;			/* Input set for reading */
-  ssize_t	print_bytes,		/* Print bytes read */
-		bytes;			/* Bytes written */
-  char		print_buffer[8192],	/* Print data buffer */
-		*print_ptr;		/* Pointer into print data buffer */
-  struct timeval timeout;		/* Timeout for read... */
-
-
- /*
-  * Figure out the maximum file descriptor value to use with select()...
-  */
-
-  nfds = (print_fd > device_fd ? print_fd : device_fd) + 1;
-
- /*
-  * Now loop until we are out of data from print_fd...
-  */
-
-  for (;;)
-  {
-   /*
-    * Use select() to determine whether we have data to copy around...
-    */
-
-    FD_ZERO(&input);
-    FD_SET(print_fd, &input);
-
-    timeout.tv_sec  = 0;
-    timeout.tv_usec = 0;
-
-    if (select(nfds, &input, NULL, NULL, &timeout) < 0)
-      return (-1);
-
-    if (!FD_ISSET(print_fd, &input))
-      return (0);
-
-    if ((print_bytes = read(print_fd, print_buffer,
-			    sizeof(print_buffer))) < 0)
-    {
-     /*
-      * Read error - bail if we don't see EAGAIN or EINTR...
-      */
-
-      if (errno != EAGAIN && errno != EINTR)
-      {
-        perror("ERROR: Unable to read print data");
-	return (-1);
-      }
-
-      print_bytes = 0;
-    }
-    else if (print_bytes == 0)
-    {
-     /*
-      * End of file, return...
-      */
-
-      return (0);
-    }
-
-    fprintf(stderr, "DEBUG: Read %d bytes of print data.\n",
-	    (int)print_bytes);
-
-    for (print_ptr = print_buffer; print_bytes > 0;)
-    {
-      if ((bytes = write(device_fd, print_ptr, print_bytes)) < 0)
-      {
-       /*
-        * Write error - bail if we don't see an error we can retry...
-	*/
-
-        if (errno != ENOSPC && errno != ENXIO && errno != EAGAIN &&
-	    errno != EINTR && errno != ENOTTY)
-	{
-	  perror("ERROR: Unable to write print data");
-	  return (-1);
-	}
-      }
-      else
-      {
-        fprintf(stderr, "DEBUG: Wrote %d bytes of print data.\n", (int)bytes);
-
-        print_bytes -= bytes;
-	print_ptr   += bytes;
-      }
-    }
-  }
-}
-
-
 /*
  * 'list_devices()' - List all serial devices.
  */
@@ -1196,9 +1084,8 @@ list_devices(void)
  */
 
 static int				/* O - 0 on success, -1 on error */
-side_cb(int print_fd,			/* I - Print file */
-        int device_fd,			/* I - Device file */
-	int use_bc)			/* I - Using back-channel? */
+side_cb(backend_data_t *print_data,	/* I - Print data */
+	int            use_bc)		/* I - Using back-channel? */
 {
   cups_sc_command_t	command;	/* Request command */
   cups_sc_status_t	status;		/* Request/response status */
@@ -1214,9 +1101,9 @@ side_cb(int print_fd,			/* I - Print file */
   switch (command)
   {
     case CUPS_SC_CMD_DRAIN_OUTPUT :
-        if (drain_output(print_fd, device_fd))
+        if (backendDataDrain(print_data))
 	  status = CUPS_SC_STATUS_IO_ERROR;
-	else if (tcdrain(device_fd))
+	else if (tcdrain(print_data->device_fd))
 	  status = CUPS_SC_STATUS_IO_ERROR;
 	else
 	  status = CUPS_SC_STATUS_OK;
@@ -0,0 +1,190 @@
+/*
+ *   Print data buffering test program for OpenPrinting CUPS Filters.
+ *
+ *   These coded instructions, statements, and computer programs are the
+ *   property of Apple Inc. and are protected by Federal copyright
+ *   law.  Distribution and use rights are outlined in the file "COPYING"
+ *   which should have been included with this file.
+ *
+ * Contents:
+ *
+ *   main() - Test the print data ring buffer.
+ */
+
+/*
+ * Include necessary headers.
+ */
+
+#include "backend-private.h"
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+
+/*
+ * Constants...
+ */
+
+#define TEST_EXTRA	1000		/* Bytes past a full ring buffer */
+
+
+/*
+ * 'main()' - Test the print data ring buffer.
+ *
+ * The print data comes from a socket, which uses the ring buffer like a
+ * terminal would.  The writer sends a little more than fits in the buffer
+ * and closes its end, so that poll() reports POLLHUP while the buffer is
+ * full...
+ */
+
+int					/* O - Exit status */
+main(void)
+{
+  int			fds[2];		/* Print data socket */
+  FILE			*device;	/* Device file */
+  backend_data_t	data;		/* Print data */
+  struct pollfd		pfds[2];	/* Descriptors to poll */
+  unsigned char		*input,		/* Data sent */
+			*output;	/* Data received */
+  size_t		i,		/* Looping var */
+			total,		/* Bytes sent */
+			bytes;		/* Bytes received */
+  ssize_t		count;		/* Bytes written */
+  pid_t			pid;		/* Writer process */
+  int			status = 0;	/* Exit status */
+
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) || (device = tmpfile()) == NULL)
+  {
+    perror("testrunloop");
+    return (1);
+  }
+
+  if (backendDataInit(&data, fds[0], fileno(device)))
+    return (1);
+
+  total = data.size + TEST_EXTRA;
+
+  if ((input = malloc(total)) == NULL || (output = malloc(total + 1)) == NULL)
+  {
+    perror("testrunloop");
+    return (1);
+  }
+
+  for (i = 0; i < total; i ++)
+    input[i] = (unsigned char)(i * 7 + i / 251);
+
+  if ((pid = fork()) == 0)
+  {
+    close(fds[0]);
+
+    for (i = 0; i < total; i += (size_t)count)
+      if ((count = write(fds[1], input + i, total - i)) <= 0)
+        _exit(1);
+
+    _exit(0);
+  }
+
+  close(fds[1]);
+
+ /*
+  * Fill the ring buffer...
+  */
+
+  fputs("backendDataRead(full): ", stdout);
+
+  while (backendDataWantRead(&data))
+  {
+    pfds[0].fd     = fds[0];
+    pfds[0].events = POLLIN;
+
+    if (poll(pfds, 1, 10000) <= 0 || backendDataRead(&data) <= 0)
+    {
+      puts("FAIL (unable to fill buffer)");
+      return (1);
+    }
+  }
+
+  waitpid(pid, NULL, 0);
+
+ /*
+  * The writer is gone, so poll() reports POLLHUP even though we ask for
+  * nothing; a read now must not touch the pending data...
+  */
+
+  pfds[0].fd     = fds[0];
+  pfds[0].events = 0;
+
+  if (poll(pfds, 1, 10000) != 1 || !(pfds[0].revents & POLLHUP))
+    puts("SKIP (no POLLHUP)");
+  else if (backendDataRead(&data) != 0 || data.used != data.size || data.eof)
+  {
+    printf("FAIL (used=%d, size=%d, eof=%d)\n", (int)data.used,
+           (int)data.size, data.eof);
+    status = 1;
+  }
+  else
+    puts("PASS");
+
+ /*
+  * Send everything to the device the way the backends do...
+  */
+
+  fputs("backendDataWrite: ", stdout);
+
+  for (;;)
+  {
+    pfds[0].fd      = fds[0];
+    pfds[0].events  = backendDataWantRead(&data) ? POLLIN : 0;
+    pfds[0].revents = 0;
+    pfds[1].fd      = fileno(device);
+    pfds[1].events  = backendDataWantWrite(&data) ? POLLOUT : 0;
+    pfds[1].revents = 0;
+
+    if (!pfds[0].events && !pfds[1].events)
+      break;
+
+    if (backendDataPoll(&data, pfds, 2, 10000) <= 0)
+    {
+      puts("FAIL (poll)");
+      return (1);
+    }
+
+    if (pfds[0].events && (pfds[0].revents & (POLLIN | POLLHUP)) &&
+        backendDataRead(&data) < 0)
+    {
+      perror("FAIL (read)");
+      return (1);
+    }
+
+    if (pfds[1].events && (pfds[1].revents & POLLOUT) &&
+        backendDataWrite(&data, 0) < 0)
+    {
+      perror("FAIL (write)");
+      return (1);
+    }
+  }
+
+  rewind(device);
+  bytes = fread(output, 1, total + 1, device);
+
+  if (bytes != total)
+  {
+    printf("FAIL (%d bytes written, expected %d)\n", (int)bytes, (int)total);
+    status = 1;
+  }
+  else if (memcmp(input, output, total))
+  {
+    puts("FAIL (data differs)");
+    status = 1;
+  }
+  else
+    puts("PASS");
+
+  backendDataFree(&data);
+  fclose(device);
+  free(input);
+  free(output);
+
+  return (status);
+}
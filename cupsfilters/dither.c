@@ -11,9 +11,13 @@
  *
  * Contents:
  *
- *   cupsDitherDelete() - Free a dithering buffer.
- *   cupsDitherLine()   - Dither a line of pixels...
- *   cupsDitherNew()    - Create a dithering buffer.
+ *   cupsDitherDelete()      - Free a dithering buffer.
+ *   cupsDitherLine()        - Dither a line of pixels...
+ *   cupsDitherNew()         - Create a dithering buffer.
+ *   cupsDitherMultiDelete() - Free a multi-channel dithering buffer.
+ *   cupsDitherMultiLine()   - Dither all channels of a line of pixels...
+ *   cupsDitherMultiNew()    - Create a multi-channel dithering buffer.
+ *   dither_init()           - Initialize the shared dithering tables.
  */
 
 /*
@@ -24,6 +28,24 @@
 #include "driver.h"
 
 
+/*
+ * Local globals...
+ */
+
+static char		logtable[16384];/* Error magnitude for randomness */
+static unsigned char	ordertable[16][16];
+					/* 16x16 Bayer threshold matrix */
+static char		dither_inited = 0;
+					/* Have the tables been initialized? */
+
+
+/*
+ * Local functions...
+ */
+
+static void	dither_init(void);
+
+
 /*
  * 'cupsDitherDelete()' - Free a dithering buffer.
  *
@@ -62,25 +84,10 @@ cupsDitherLine(cups_dither_t    *d,	/* I - Dither data */
 		errrange;		/* Range of random multiplier */
   register int	*p0,			/* Error buffer pointers... */
 		*p1;
-  static char	logtable[16384];	/* Error magnitude for randomness */
-  static char	loginit = 0;		/* Has the table been initialized? */
 
 
-  if (!loginit)
-  {
-   /*
-    * Initialize a logarithmic table for the magnitude of randomness
-    * that is introduced.
-    */
-
-    loginit = 1;
-
-    logtable[0] = 0;
-    for (x = 1; x < 2049; x ++)
-      logtable[x] = (int)(log(x / 16.0) / log(2.0) + 1.0);
-    for (; x < 16384; x ++)
-      logtable[x] = logtable[2049];
-  }
+  if (!dither_inited)
+    dither_init();
 
   if (d->row == 0)
   {
@@ -297,3 +304,307 @@ cupsDitherNew(int width)	/* I - Width of output in pixels */
   return (d);
 }
 
+
+
+/*
+ * 'cupsDitherMultiDelete()' - Free a multi-channel dithering buffer.
+ */
+
+void
+cupsDitherMultiDelete(
+    cups_dither_multi_t *d)		/* I - Dithering buffer */
+{
+  if (d != NULL)
+    free(d);
+}
+
+
+/*
+ * 'cupsDitherMultiLine()' - Dither all channels of a line of pixels...
+ *
+ * The error buffer is interleaved by channel, so all planes of a line
+ * are dithered in a single pass over the separation data.  Each output
+ * plane receives one pixel value per byte, just like cupsDitherLine().
+ */
+
+void
+cupsDitherMultiLine(
+    cups_dither_multi_t *d,		/* I - Dither data */
+    cups_lut_t          **luts,		/* I - Lookup tables, one per channel */
+    const short         *data,		/* I - Separation data */
+    unsigned char       **p)		/* O - Pixels, one buffer per channel */
+{
+  int		x,			/* Horizontal position in line... */
+		xpos,			/* Output position in line... */
+		xdir,			/* Output direction */
+		c,			/* Current channel */
+		nc,			/* Number of channels */
+		step,			/* Step in interleaved buffers */
+		pixel,			/* Current adjusted pixel... */
+		e,			/* Current error */
+		e1;			/* New error value for next row */
+  int		errval0,		/* First half of error value */
+		errval1,		/* Second half of error value */
+		errbase,		/* Base multiplier */
+		errbase0,		/* Base multiplier for large values */
+		errbase1,		/* Base multiplier for small values */
+		errrange;		/* Range of random multiplier */
+  int		*p0,			/* Error buffer pointers... */
+		*p1;
+  int		e0s[CUPS_MAX_CHAN],	/* Per-channel error values */
+		e1s[CUPS_MAX_CHAN],
+		e2s[CUPS_MAX_CHAN],
+		steps[CUPS_MAX_CHAN];	/* Per-channel ordered dither step */
+  const cups_lut_t *lut;		/* Current lookup table */
+  const unsigned char *order;		/* Current threshold matrix row */
+
+
+  if (!dither_inited)
+    dither_init();
+
+  nc = d->num_channels;
+
+  if (d->mode == CUPS_DITHER_ORDERED)
+  {
+   /*
+    * Ordered dithering: offset each intensity by the threshold matrix,
+    * scaled to the distance between two output levels...
+    */
+
+    for (c = 0; c < nc; c ++)
+    {
+      if ((steps[c] = luts[c][CUPS_MAX_LUT].pixel) < 1)
+        steps[c] = 1;
+
+      steps[c] = CUPS_MAX_LUT / steps[c];
+    }
+
+    order = ordertable[d->row & 15];
+
+    for (x = 0; x < d->width; x ++, data += nc)
+      for (c = 0; c < nc; c ++)
+      {
+        if (data[c] == 0)
+	{
+	  p[c][x] = 0;
+	  continue;
+	}
+
+        lut   = luts[c];
+        pixel = lut[data[c]].intensity +
+	        (2 * order[x & 15] - 255) * steps[c] / 512;
+
+	if (pixel > CUPS_MAX_LUT)
+	  pixel = CUPS_MAX_LUT;
+	else if (pixel < 0)
+	  pixel = 0;
+
+        p[c][x] = lut[pixel].pixel;
+      }
+
+    d->row ++;
+    return;
+  }
+
+  if ((d->row & 1) == 0)
+  {
+   /*
+    * Dither from left to right:
+    *
+    *       e0   ==        p0[0]
+    *    e1 e2   == p1[-1] p1[0]
+    */
+
+    p0   = d->errors + 2 * nc;
+    p1   = d->errors + (2 + d->width + 4) * nc;
+    step = nc;
+    xpos = 0;
+    xdir = 1;
+  }
+  else
+  {
+   /*
+    * Dither from right to left:
+    *
+    *    e0      == p0[0]
+    *    e2 e1   == p1[0] p1[1]
+    */
+
+    p0   = d->errors + (d->width + 1 + d->width + 4) * nc;
+    p1   = d->errors + (d->width + 1) * nc;
+    step = -nc;
+    xpos = d->width - 1;
+    xdir = -1;
+  }
+
+  data += xpos * nc;
+
+  for (c = 0; c < nc; c ++)
+  {
+    e0s[c] = p0[c];
+    e1s[c] = 0;
+    e2s[c] = 0;
+  }
+
+ /*
+  * Error diffuse each output pixel, all channels at once...
+  */
+
+  for (x = d->width;
+       x > 0;
+       x --, xpos += xdir, p0 += step, p1 += step, data += step)
+    for (c = 0; c < nc; c ++)
+    {
+     /*
+      * Skip blank pixels...
+      */
+
+      if (data[c] == 0)
+      {
+        p[c][xpos]   = 0;
+	e0s[c]       = p0[step + c];
+	p1[c - step] = e1s[c];
+	e1s[c]       = e2s[c];
+	e2s[c]       = 0;
+	continue;
+      }
+
+     /*
+      * Compute the net pixel brightness and brightness error.  Set a dot
+      * if necessary...
+      */
+
+      lut   = luts[c];
+      pixel = lut[data[c]].intensity + e0s[c] / 128;
+
+      if (pixel > CUPS_MAX_LUT)
+	pixel = CUPS_MAX_LUT;
+      else if (pixel < 0)
+	pixel = 0;
+
+      p[c][xpos] = lut[pixel].pixel;
+      e          = lut[pixel].error;
+
+     /*
+      * Set the randomness factor...
+      */
+
+      if (e > 0)
+        errrange = logtable[e];
+      else
+        errrange = logtable[-e];
+
+      errbase  = 8 - errrange;
+      errrange = errrange * 2 + 1;
+
+     /*
+      * Randomize the error value.
+      */
+
+      if (errrange > 1)
+      {
+        errbase0 = errbase + (CUPS_RAND() % errrange);
+        errbase1 = errbase + (CUPS_RAND() % errrange);
+      }
+      else
+        errbase0 = errbase1 = errbase;
+
+     /*
+      *       X   7/16 =    X  e0
+      * 3/16 5/16 1/16 =    e1 e2
+      */
+
+      errval0 = errbase0 * e;
+      errval1 = (16 - errbase0) * e;
+      e0s[c]  = p0[step + c] + 7 * errval0;
+      e1      = e2s[c] + 5 * errval1;
+
+      errval0      = errbase1 * e;
+      errval1      = (16 - errbase1) * e;
+      e2s[c]       = errval0;
+      e1s[c]       = e1;
+      p1[c - step] = e1 + 3 * errval1;
+    }
+
+ /*
+  * Update to the next row...
+  */
+
+  d->row ++;
+}
+
+
+/*
+ * 'cupsDitherMultiNew()' - Create a multi-channel dithering buffer.
+ */
+
+cups_dither_multi_t *			/* O - New state array */
+cupsDitherMultiNew(
+    int                width,		/* I - Width of output in pixels */
+    int                num_channels,	/* I - Number of channels */
+    cups_dither_mode_t mode)		/* I - Dithering mode */
+{
+  cups_dither_multi_t	*d;		/* New dithering buffer */
+
+
+  if (width < 1 || num_channels < 1 || num_channels > CUPS_MAX_CHAN)
+    return (NULL);
+
+  if ((d = (cups_dither_multi_t *)calloc(1, sizeof(cups_dither_multi_t) +
+                                         2 * (width + 4) * num_channels *
+					     sizeof(int))) == NULL)
+    return (NULL);
+
+  d->width        = width;
+  d->num_channels = num_channels;
+  d->mode         = mode;
+  d->errors       = (int *)(d + 1);
+
+  return (d);
+}
+
+
+/*
+ * 'dither_init()' - Initialize the shared dithering tables.
+ */
+
+static void
+dither_init(void)
+{
+  int	x, y,				/* Looping vars */
+	size,				/* Current matrix size */
+	v;				/* Current matrix value */
+
+
+ /*
+  * Initialize a logarithmic table for the magnitude of randomness
+  * that is introduced.
+  */
+
+  logtable[0] = 0;
+  for (x = 1; x < 2049; x ++)
+    logtable[x] = (int)(log(x / 16.0) / log(2.0) + 1.0);
+  for (; x < 16384; x ++)
+    logtable[x] = logtable[2049];
+
+ /*
+  * Build the 16x16 Bayer matrix for ordered dithering by recursively
+  * doubling the 1x1 matrix...
+  */
+
+  ordertable[0][0] = 0;
+
+  for (size = 1; size < 16; size *= 2)
+    for (y = 0; y < size; y ++)
+      for (x = 0; x < size; x ++)
+      {
+        v = 4 * ordertable[y][x];
+
+        ordertable[y][x]               = v;
+        ordertable[y][x + size]        = v + 2;
+        ordertable[y + size][x]        = v + 3;
+        ordertable[y + size][x + size] = v + 1;
+      }
+
+  dither_inited = 1;
+}
@@ -0,0 +1,62 @@
+/*
+ *   Private printer driver utilities header file for CUPS.
+ *
+ *   This file is licensed as noted in "COPYING"
+ *   which should have been included with this file.
+ */
+
+#ifndef _CUPS_FILTERS_DRIVER_PRIVATE_H_
+#  define _CUPS_FILTERS_DRIVER_PRIVATE_H_
+
+/*
+ * Include necessary headers...
+ */
+
+#  include "driver.h"
+
+
+/*
+ * Constants...
+ */
+
+#  define CUPS_GRID_CHAN	CUPS_MAX_RGB
+					/* Channels stored per grid node */
+#  define CUPS_GRID_MAX		64	/* Maximum nodes on a side */
+
+
+/*
+ * Types and structures...
+ */
+
+typedef void (*_cups_grid_cb_t)(void *data, const unsigned char *input,
+                                unsigned char *output, int num_pixels);
+					/**** Separation to bake ****/
+
+typedef struct _cups_grid_s		/**** Separation baked into a grid ****/
+{
+  int		grid_size,		/* Number of nodes on a side */
+		num_channels;		/* Number of output channels */
+  short		*nodes;			/* Node values, CUPS_GRID_CHAN each */
+  int		offsets[3][256],	/* Lower node offset for R, G and B */
+		mult[256];		/* Weight of upper node (0-256) */
+} _cups_grid_t;
+
+
+/*
+ * Prototypes...
+ */
+
+extern void		_cupsGridDelete(_cups_grid_t *grid);
+extern void		_cupsGridDoRGB(const _cups_grid_t *grid,
+			               const unsigned char *input,
+			               unsigned char *output, int num_pixels);
+extern _cups_grid_t	*_cupsGridLoad(ppd_file_t *ppd,
+			               const char *colormodel,
+				       const char *media,
+				       const char *resolution,
+				       int num_channels, _cups_grid_cb_t cb,
+				       void *data);
+extern _cups_grid_t	*_cupsGridNew(int grid_size, int num_channels,
+			              _cups_grid_cb_t cb, void *data);
+
+#endif /* !_CUPS_FILTERS_DRIVER_PRIVATE_H_ */
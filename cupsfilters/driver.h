@@ -75,6 +75,21 @@ typedef struct cups_dither_s		/**** Dithering State ****/
   int		errors[96];		/* Error values */
 } cups_dither_t;
 
+typedef enum cups_dither_mode_e		/**** Dithering mode ****/
+{
+  CUPS_DITHER_DIFFUSE,			/* Error diffusion */
+  CUPS_DITHER_ORDERED			/* Ordered (16x16 Bayer) dithering */
+} cups_dither_mode_t;
+
+typedef struct cups_dither_multi_s	/**** Multi-channel Dithering State ****/
+{
+  int		width;			/* Width of buffer */
+  int		row;			/* Current row */
+  int		num_channels;		/* Number of channels */
+  cups_dither_mode_t mode;		/* Dithering mode */
+  int		*errors;		/* Error values, interleaved by channel */
+} cups_dither_multi_t;
+
 typedef struct cups_sample_s		/**** Color sample point ****/
 {
   unsigned char	rgb[3];			/* sRGB values */
@@ -91,6 +106,7 @@ typedef struct cups_rgb_s		/**** Color separation lookup table ****/
   int		cache_init;		/* Are cached values initialized? */
   unsigned char	black[CUPS_MAX_RGB];	/* Cached black (sRGB = 0,0,0) */
   unsigned char	white[CUPS_MAX_RGB];	/* Cached white (sRGB = 255,255,255) */
+  struct _cups_grid_s *grid;		/* Baked separation or NULL */
 } cups_rgb_t;
 
 typedef struct cups_cmyk_s		/**** Simple CMYK lookup table ****/
@@ -147,6 +163,13 @@ extern void		cupsDitherLine(cups_dither_t *d, const cups_lut_t *lut,
 				       unsigned char *p);
 extern cups_dither_t	*cupsDitherNew(int width);
 extern void		cupsDitherDelete(cups_dither_t *);
+extern void		cupsDitherMultiLine(cups_dither_multi_t *d,
+			                    cups_lut_t **luts,
+					    const short *data,
+					    unsigned char **p);
+extern cups_dither_multi_t *cupsDitherMultiNew(int width, int num_channels,
+					       cups_dither_mode_t mode);
+extern void		cupsDitherMultiDelete(cups_dither_multi_t *);
 
 /*
  * Lookup table functions for dithering...
@@ -0,0 +1,335 @@
+/*
+ *   Baked color separation code for CUPS.
+ *
+ *   This file is licensed as noted in "COPYING"
+ *   which should have been included with this file.
+ *
+ * Contents:
+ *
+ *   _cupsGridDelete() - Delete a baked separation.
+ *   _cupsGridDoRGB()  - Do an RGB separation with a baked grid.
+ *   _cupsGridLoad()   - Bake a separation if the PPD file asks for it.
+ *   _cupsGridNew()    - Bake a separation into a grid.
+ *   grid_pixel()      - Interpolate one pixel.
+ *
+ * The grid holds the separation at N x N x N sRGB nodes and interpolates
+ * between the 4 nodes of the tetrahedron around each pixel.  Node values
+ * come from the direct separation, so a grid size N where N - 1 divides
+ * 255 (16, 18, 52) gives exactly the direct result for node colors...
+ */
+
+/*
+ * Include necessary headers.
+ */
+
+#include "driver-private.h"
+#include <string.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif /* __SSE2__ */
+
+
+/*
+ * Swap weight/stride pairs without branches so that the larger weight
+ * comes first...
+ */
+
+#define GRID_SORT(fa,sa,fb,sb) \
+  m = -(fb > fa); \
+  t = (fa ^ fb) & m; fa ^= t; fb ^= t; \
+  t = (sa ^ sb) & m; sa ^= t; sb ^= t
+
+
+/*
+ * Local functions...
+ */
+
+static inline void	grid_pixel(const _cups_grid_t *grid,
+			           const unsigned char *input,
+				   unsigned char *output);
+
+
+/*
+ * '_cupsGridDelete()' - Delete a baked separation.
+ */
+
+void
+_cupsGridDelete(_cups_grid_t *grid)	/* I - Baked separation */
+{
+  if (!grid)
+    return;
+
+  free(grid->nodes);
+  free(grid);
+}
+
+
+/*
+ * '_cupsGridDoRGB()' - Do an RGB separation with a baked grid.
+ */
+
+void
+_cupsGridDoRGB(const _cups_grid_t  *grid,
+					/* I - Baked separation */
+               const unsigned char *input,
+					/* I - Input RGB pixels */
+	       unsigned char       *output,
+					/* O - Output Device-N pixels */
+	       int                 num_pixels)
+					/* I - Number of pixels */
+{
+  int		i;			/* Looping var */
+  int		num_channels;		/* Number of output channels */
+  int		rgb,			/* Current RGB color */
+		lastrgb;		/* Previous RGB color */
+  unsigned char	color[CUPS_GRID_CHAN];	/* Current output color */
+
+
+  if (!grid || !input || !output || num_pixels <= 0)
+    return;
+
+  num_channels = grid->num_channels;
+  lastrgb      = -1;
+
+  for (; num_pixels > 0; num_pixels --, input += 3, output += num_channels)
+  {
+    rgb = (((input[0] << 8) | input[1]) << 8) | input[2];
+
+    if (rgb != lastrgb)
+    {
+      grid_pixel(grid, input, color);
+      lastrgb = rgb;
+    }
+
+   /*
+    * Store all channels while the extra ones still land inside the output
+    * buffer; the next pixel overwrites them...
+    */
+
+    if (num_pixels * num_channels >= CUPS_GRID_CHAN)
+      memcpy(output, color, CUPS_GRID_CHAN);
+    else
+      for (i = 0; i < num_channels; i ++)
+        output[i] = color[i];
+  }
+}
+
+
+/*
+ * '_cupsGridLoad()' - Bake a separation if the PPD file asks for it.
+ *
+ * The optional cupsSeparationLUT attribute gives the grid size:
+ *
+ *     *cupsSeparationLUT ColorModel.MediaType.Resolution: "18"
+ */
+
+_cups_grid_t *				/* O - Baked separation or NULL */
+_cupsGridLoad(ppd_file_t      *ppd,	/* I - PPD file */
+              const char      *colormodel,
+					/* I - ColorModel value */
+	      const char      *media,	/* I - MediaType value */
+	      const char      *resolution,
+					/* I - Resolution value */
+	      int             num_channels,
+					/* I - Number of output channels */
+	      _cups_grid_cb_t cb,	/* I - Separation to bake */
+	      void            *data)	/* I - Separation data */
+{
+  ppd_attr_t	*attr;			/* Attribute from PPD file */
+  char		spec[PPD_MAX_NAME];	/* Profile name */
+  int		grid_size;		/* Number of nodes on a side */
+
+
+  if ((attr = cupsFindAttr(ppd, "cupsSeparationLUT", colormodel, media,
+                           resolution, spec, sizeof(spec))) == NULL)
+    return (NULL);
+
+  if (!attr->value || sscanf(attr->value, "%d", &grid_size) != 1 ||
+      grid_size < 2 || grid_size > CUPS_GRID_MAX)
+  {
+    fprintf(stderr, "ERROR: Bad cupsSeparationLUT attribute \'%s\'!\n",
+            attr->value ? attr->value : "(null)");
+    return (NULL);
+  }
+
+  fprintf(stderr, "DEBUG: Baking separation into %dx%dx%d grid for %s\n",
+          grid_size, grid_size, grid_size, spec);
+
+  return (_cupsGridNew(grid_size, num_channels, cb, data));
+}
+
+
+/*
+ * '_cupsGridNew()' - Bake a separation into a grid.
+ *
+ * The callback separates one row of grid_size nodes at a time...
+ */
+
+_cups_grid_t *				/* O - Baked separation or NULL */
+_cupsGridNew(int             grid_size,	/* I - Number of nodes on a side */
+             int             num_channels,
+					/* I - Number of output channels */
+	     _cups_grid_cb_t cb,	/* I - Separation to bake */
+	     void            *data)	/* I - Separation data */
+{
+  _cups_grid_t	*grid;			/* Baked separation */
+  int		i,			/* Looping var */
+		r, g, b;		/* Current node */
+  short		*node;			/* Current node values */
+  unsigned char	rgb[CUPS_GRID_MAX * 3];	/* Input for a row of nodes */
+  unsigned char	colors[CUPS_GRID_MAX * CUPS_GRID_CHAN];
+					/* Output for a row of nodes */
+  int		pos,			/* 8.8 fixed point node position */
+		index;			/* Lower node index */
+
+
+  if (grid_size < 2 || grid_size > CUPS_GRID_MAX || num_channels < 1 ||
+      num_channels > CUPS_GRID_CHAN || !cb)
+    return (NULL);
+
+  if ((grid = calloc(1, sizeof(_cups_grid_t))) == NULL)
+    return (NULL);
+
+  if ((grid->nodes = calloc(grid_size * grid_size * grid_size,
+                            CUPS_GRID_CHAN * sizeof(short))) == NULL)
+  {
+    free(grid);
+    return (NULL);
+  }
+
+  grid->grid_size    = grid_size;
+  grid->num_channels = num_channels;
+
+ /*
+  * Generate the lookup tables for the node offsets and weights; 255 maps
+  * to the far side of the last cell so every pixel has an upper node...
+  */
+
+  for (i = 0; i < 256; i ++)
+  {
+    pos = i * (grid_size - 1) * 256 / 255;
+
+    if ((index = pos >> 8) > grid_size - 2)
+      index = grid_size - 2;
+
+    grid->offsets[0][i] = index * grid_size * grid_size * CUPS_GRID_CHAN;
+    grid->offsets[1][i] = index * grid_size * CUPS_GRID_CHAN;
+    grid->offsets[2][i] = index * CUPS_GRID_CHAN;
+    grid->mult[i]       = pos - index * 256;
+  }
+
+ /*
+  * Then separate the node colors...
+  */
+
+  for (b = 0; b < grid_size; b ++)
+    rgb[b * 3 + 2] = (b * 255 + (grid_size - 1) / 2) / (grid_size - 1);
+
+  for (node = grid->nodes, r = 0; r < grid_size; r ++)
+    for (g = 0; g < grid_size; g ++)
+    {
+      for (b = 0; b < grid_size; b ++)
+      {
+        rgb[b * 3 + 0] = (r * 255 + (grid_size - 1) / 2) / (grid_size - 1);
+        rgb[b * 3 + 1] = (g * 255 + (grid_size - 1) / 2) / (grid_size - 1);
+      }
+
+      (*cb)(data, rgb, colors, grid_size);
+
+      for (b = 0; b < grid_size; b ++, node += CUPS_GRID_CHAN)
+        for (i = 0; i < num_channels; i ++)
+	  node[i] = colors[b * num_channels + i];
+    }
+
+  return (grid);
+}
+
+
+/*
+ * 'grid_pixel()' - Interpolate one pixel.
+ */
+
+static inline void
+grid_pixel(const _cups_grid_t  *grid,	/* I - Baked separation */
+           const unsigned char *input,	/* I - RGB pixel */
+	   unsigned char       *output)	/* O - CUPS_GRID_CHAN channel values */
+{
+  int		fr, fg, fb,		/* Weights of upper nodes */
+		sr, sg, sb,		/* Node strides */
+		f1, f2, f3,		/* Sorted weights */
+		s1, s2, s3,		/* Strides in weight order */
+		m, t,			/* Mask and temporary for swaps */
+		o1, o2,			/* Offsets of middle nodes */
+		w0, w1, w2, w3;		/* Node weights */
+  const short	*n0, *n1, *n2, *n3;	/* Tetrahedron nodes */
+
+
+  fr = grid->mult[input[0]];
+  fg = grid->mult[input[1]];
+  fb = grid->mult[input[2]];
+  sb = CUPS_GRID_CHAN;
+  sg = grid->grid_size * sb;
+  sr = grid->grid_size * sg;
+
+  n0 = grid->nodes + grid->offsets[0][input[0]] + grid->offsets[1][input[1]] +
+       grid->offsets[2][input[2]];
+
+ /*
+  * Walk from the lower node to the upper one along the axes in order of
+  * their weights, which picks the tetrahedron holding the pixel; sorting
+  * with conditional swaps avoids branches that photos mispredict...
+  */
+
+  f1 = fr; s1 = sr;
+  f2 = fg; s2 = sg;
+  f3 = fb; s3 = sb;
+
+  GRID_SORT(f1, s1, f2, s2);
+  GRID_SORT(f2, s2, f3, s3);
+  GRID_SORT(f1, s1, f2, s2);
+
+  o1 = s1;
+  o2 = s1 + s2;
+  w0 = 256 - f1;
+  w1 = f1 - f2;
+  w2 = f2 - f3;
+  w3 = f3;
+
+  n1 = n0 + o1;
+  n2 = n0 + o2;
+  n3 = n0 + sr + sg + sb;
+
+#ifdef __SSE2__
+ /*
+  * Each node's 4 channels are one 64-bit load; interleave each pair of
+  * nodes so that one multiply-add applies both weights...
+  */
+
+  {
+    __m128i	v0 = _mm_loadl_epi64((const __m128i *)n0),
+		v1 = _mm_loadl_epi64((const __m128i *)n1),
+		v2 = _mm_loadl_epi64((const __m128i *)n2),
+		v3 = _mm_loadl_epi64((const __m128i *)n3),
+		sum;			/* Weighted sum */
+    int		bytes;			/* Packed channel values */
+
+    sum = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(v0, v1),
+                                       _mm_set1_epi32((w1 << 16) | w0)),
+                        _mm_madd_epi16(_mm_unpacklo_epi16(v2, v3),
+			               _mm_set1_epi32((w3 << 16) | w2)));
+    sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+    sum = _mm_packs_epi32(sum, sum);
+
+    bytes = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+    memcpy(output, &bytes, CUPS_GRID_CHAN);
+  }
+#else
+  {
+    int	i;				/* Looping var */
+
+    for (i = 0; i < CUPS_GRID_CHAN; i ++)
+      output[i] = (n0[i] * w0 + n1[i] * w1 + n2[i] * w2 + n3[i] * w3 + 128) >> 8;
+  }
+#endif /* __SSE2__ */
+}
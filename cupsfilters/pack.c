@@ -15,6 +15,9 @@
  *   cupsPackHorizontal2()   - Pack 2-bit pixels horizontally...
  *   cupsPackHorizontalBit() - Pack pixels horizontally by bit...
  *   cupsPackVertical()      - Pack pixels vertically...
+ *   pack_bits_init()        - Pick the fastest packing for this processor.
+ *   pack_bits_words()       - Pack 8 adjacent pixels at a time.
+ *   pack_bits_avx2()        - Pack 32 adjacent pixels at a time with AVX2.
  */
 
 /*
@@ -22,6 +25,57 @@
  */
 
 #include "driver.h"
+#include <string.h>
+#include <stdint.h>
+
+
+/*
+ * When the byte order allows, adjacent pixels are packed 8 at a time using
+ * 64-bit words, or 32 at a time on x86 processors with AVX2 (found at run
+ * time)...
+ */
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define PACK_WORDS 1
+#  define ONES	0x0101010101010101ULL
+#  define LOWS	0x7f7f7f7f7f7f7f7fULL
+#  define HIGHS	0x8080808080808080ULL
+#  define GATHER 0x8040201008040201ULL	/* Moves bit 8*i to bit 63-i */
+#  if defined(__x86_64__) || defined(__i386__)
+#    define PACK_AVX2 1
+#    include <immintrin.h>
+#  endif /* __x86_64__ || __i386__ */
+#endif /* __GNUC__ && little endian */
+
+
+#ifdef PACK_WORDS
+/*
+ * Local functions...
+ */
+
+static void	pack_bits_init(const unsigned char *ipixels,
+		               unsigned char *obytes, int count,
+			       unsigned char clearto, unsigned char bit);
+static void	pack_bits_words(const unsigned char *ipixels,
+		                unsigned char *obytes, int count,
+				unsigned char clearto, unsigned char bit);
+#ifdef PACK_AVX2
+static void	pack_bits_avx2(const unsigned char *ipixels,
+		               unsigned char *obytes, int count,
+			       unsigned char clearto, unsigned char bit)
+		__attribute__((target("avx2")));
+#endif /* PACK_AVX2 */
+
+
+/*
+ * Local globals...
+ */
+
+static void	(*pack_bits)(const unsigned char *, unsigned char *, int,
+		             unsigned char, unsigned char) = pack_bits_init;
+					/* Packing to use */
+#endif /* PACK_WORDS */
 
 
 /*
@@ -38,6 +92,21 @@ cupsPackHorizontal(const unsigned char *ipixels,/* I - Input pixels */
   register unsigned char	b;		/* Current byte */
 
 
+#ifdef PACK_WORDS
+ /*
+  * Adjacent pixels can be packed many at a time...
+  */
+
+  if (step == 1 && width > 7)
+  {
+    (*pack_bits)(ipixels, obytes, width / 8, clearto, 0xff);
+
+    ipixels += width & ~7;
+    obytes  += width / 8;
+    width   &= 7;
+  }
+#endif /* PACK_WORDS */
+
  /*
   * Do whole bytes first...
   */
@@ -178,6 +247,21 @@ cupsPackHorizontalBit(const unsigned char *ipixels,	/* I - Input pixels */
   register unsigned char	b;			/* Current byte */
 
 
+#ifdef PACK_WORDS
+ /*
+  * Adjacent pixels can be packed many at a time...
+  */
+
+  if (width > 7)
+  {
+    (*pack_bits)(ipixels, obytes, width / 8, clearto, bit);
+
+    ipixels += width & ~7;
+    obytes  += width / 8;
+    width   &= 7;
+  }
+#endif /* PACK_WORDS */
+
  /*
   * Do whole bytes first...
   */
@@ -254,12 +338,33 @@ cupsPackVertical(const unsigned char *ipixels,	/* I - Input pixels */
                  const unsigned char bit,	/* I - Output bit */
                  const int           step)	/* I - Number of bytes between columns */
 {
+#ifdef PACK_WORDS
+  uint64_t	word;			/* 8 pixels */
+#endif /* PACK_WORDS */
+
+
  /*
   * Loop through the entire array...
   */
 
   while (width > 7)
   {
+#ifdef PACK_WORDS
+   /*
+    * Skip 8 blank pixels at once...
+    */
+
+    memcpy(&word, ipixels, sizeof(word));
+
+    if (!word)
+    {
+      ipixels += 8;
+      obytes  += 8 * step;
+      width   -= 8;
+      continue;
+    }
+#endif /* PACK_WORDS */
+
     if (*ipixels++)
       *obytes ^= bit;
     obytes += step;
@@ -298,3 +403,118 @@ cupsPackVertical(const unsigned char *ipixels,	/* I - Input pixels */
   }
 }
 
+
+
+#ifdef PACK_WORDS
+/*
+ * 'pack_bits_init()' - Pick the fastest packing for this processor.
+ *
+ * Threads racing here all store the same pointer...
+ */
+
+static void
+pack_bits_init(
+    const unsigned char *ipixels,	/* I - Input pixels */
+    unsigned char       *obytes,	/* O - Output bytes */
+    int                 count,		/* I - Number of output bytes */
+    unsigned char       clearto,	/* I - Initial value of bytes */
+    unsigned char       bit)		/* I - Bits to check */
+{
+  pack_bits = pack_bits_words;
+
+#ifdef PACK_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    pack_bits = pack_bits_avx2;
+#endif /* PACK_AVX2 */
+
+  (*pack_bits)(ipixels, obytes, count, clearto, bit);
+}
+
+
+/*
+ * 'pack_bits_words()' - Pack 8 adjacent pixels at a time.
+ *
+ * Sets a bit for each pixel with any of the given bits set, first pixel
+ * in the high bit...
+ */
+
+static void
+pack_bits_words(
+    const unsigned char *ipixels,	/* I - Input pixels */
+    unsigned char       *obytes,	/* O - Output bytes */
+    int                 count,		/* I - Number of output bytes */
+    unsigned char       clearto,	/* I - Initial value of bytes */
+    unsigned char       bit)		/* I - Bits to check */
+{
+  uint64_t	word,			/* 8 pixels */
+		bits = bit * ONES;	/* Bits to check in each pixel */
+
+
+  for (; count > 0; count --, ipixels += 8)
+  {
+    memcpy(&word, ipixels, sizeof(word));
+
+   /*
+    * Set the high bit of each non-zero byte, then gather the high bits
+    * into the top byte...
+    */
+
+    word &= bits;
+    word = (((word & LOWS) + LOWS) | word) & HIGHS;
+
+    *obytes++ = clearto ^ (unsigned char)(((word >> 7) * GATHER) >> 56);
+  }
+}
+
+
+#ifdef PACK_AVX2
+/*
+ * 'pack_bits_avx2()' - Pack 32 adjacent pixels at a time with AVX2.
+ */
+
+static void
+pack_bits_avx2(
+    const unsigned char *ipixels,	/* I - Input pixels */
+    unsigned char       *obytes,	/* O - Output bytes */
+    int                 count,		/* I - Number of output bytes */
+    unsigned char       clearto,	/* I - Initial value of bytes */
+    unsigned char       bit)		/* I - Bits to check */
+{
+  const __m256i	reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+			                   15, 14, 13, 12, 11, 10, 9, 8,
+			                   7, 6, 5, 4, 3, 2, 1, 0,
+			                   15, 14, 13, 12, 11, 10, 9, 8),
+					/* Reverses each group of 8 pixels */
+		bits    = _mm256_set1_epi8((char)bit),
+					/* Bits to check in each pixel */
+		zero    = _mm256_setzero_si256();
+  uint32_t	clear   = clearto * 0x01010101U,
+					/* 4 copies of clearto */
+		mask;			/* 4 output bytes */
+
+
+  while (count > 3)
+  {
+   /*
+    * movemask puts the first pixel of each group in the low bit, so
+    * reverse the groups first...
+    */
+
+    __m256i data = _mm256_loadu_si256((const __m256i *)ipixels);
+
+    data = _mm256_shuffle_epi8(_mm256_and_si256(data, bits), reverse);
+    mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, zero));
+    mask ^= clear;
+
+    memcpy(obytes, &mask, sizeof(mask));
+
+    ipixels += 32;
+    obytes  += 4;
+    count   -= 4;
+  }
+
+  pack_bits_words(ipixels, obytes, count, clearto, bit);
+}
+#endif /* PACK_AVX2 */
+#endif /* PACK_WORDS */
@@ -35,6 +35,7 @@
  */
 
 #include <errno.h>
+#include <sys/stat.h>
 #include "driver.h"
 #include <string.h>
 #include <ctype.h>
@@ -77,7 +78,7 @@
  */
 
 
-cups_array_t *opt_strings_catalog = NULL;
+struct opt_strings_s *opt_strings_catalog = NULL;
 char ppdgenerator_msg[1024];
 
 typedef struct _pwg_finishings_s	/**** PWG finishings mapping data ****/
@@ -555,190 +556,300 @@ _findCUPSMessageCatalog(const char *preferreddir)
   return catalog;
 }
 
-/* Data structure for IPP choice name and human-readable string */
-typedef struct ipp_choice_strings_s {
-  char *name, *human_readable;
-} ipp_choice_strings_t;
-
-/* Data structure for IPP option name, human-readable string, and choice list */
-typedef struct ipp_opt_strings_s {
-  char *name, *human_readable;
-  cups_array_t *choices;
-} ipp_opt_strings_t;
+/*
+ * Catalog of human-readable strings for IPP options and choices
+ *
+ * All strings are interned in a string pool, so that the many repeated
+ * option names of a catalog are stored only once, and the entries are
+ * found via a hash table (case-insensitive, as the option and choice
+ * names in catalog files are not always in the same case as the IPP
+ * attributes), so that a lookup does not depend on the catalog size.
+ */
 
-int
-compare_choices(void *a, void *b, void *user_data)
+#define OPT_STRINGS_CHUNK_SIZE 65536
+
+/* Block of memory for interned strings */
+typedef struct opt_strings_chunk_s {
+  struct opt_strings_chunk_s *next;
+  size_t used, size;
+} opt_strings_chunk_t;
+
+/* Human-readable string for an option (choice == NULL) or a choice */
+typedef struct opt_string_s {
+  const char	*option,		/* Interned option name */
+		*choice,		/* Interned choice name or NULL */
+		*human_readable;	/* Interned human-readable string */
+  unsigned	hash;			/* Hash of option and choice names */
+  int		next;			/* Next entry in bucket, -1 for none */
+} opt_string_t;
+
+typedef struct opt_strings_s {
+  int		num_entries,		/* Number of entries */
+		alloc_entries;		/* Allocated entries */
+  opt_string_t	*entries;		/* Entries */
+  int		num_buckets;		/* Number of buckets (power of 2) */
+  int		*buckets;		/* First entry of each bucket */
+  int		num_strings,		/* Number of interned strings */
+		alloc_strings;		/* Size of interned string table
+					   (power of 2) */
+  const char	**strings;		/* Interned string table */
+  opt_strings_chunk_t *chunks;		/* String storage */
+} opt_strings_t;
+
+static unsigned
+opt_strings_hash_name(unsigned hash, const char *name, int nocase)
 {
-  return strcasecmp(((ipp_choice_strings_t *)a)->name,
-		    ((ipp_choice_strings_t *)b)->name);
+  /* FNV-1a, optionally on the lowercase characters */
+  for (; *name; name ++)
+    hash = (hash ^ (unsigned char)(nocase ? tolower(*name) : *name)) *
+      16777619U;
+  return hash;
 }
 
-int
-compare_options(void *a, void *b, void *user_data)
+static unsigned
+opt_strings_hash(const char *option, const char *choice)
 {
-  return strcasecmp(((ipp_opt_strings_t *)a)->name,
-		    ((ipp_opt_strings_t *)b)->name);
+  unsigned hash = opt_strings_hash_name(2166136261U, option, 1);
+
+  if (choice)
+    hash = opt_strings_hash_name(hash * 16777619U, choice, 1);
+  return hash;
 }
 
-void
-free_choice_strings(void* entry, void* user_data)
+opt_strings_t *
+optStringsNew()
 {
-  ipp_choice_strings_t *entry_rec = (ipp_choice_strings_t *)entry;
+  opt_strings_t *cat;
+  int i;
 
-  if (entry_rec) {
-    if (entry_rec->name) free(entry_rec->name);
-    if (entry_rec->human_readable) free(entry_rec->human_readable);
-    free(entry_rec);
+  if ((cat = calloc(1, sizeof(opt_strings_t))) == NULL)
+    return NULL;
+  cat->num_buckets = 256;
+  cat->alloc_strings = 512;
+  if ((cat->buckets = malloc(cat->num_buckets * sizeof(int))) == NULL ||
+      (cat->strings = calloc(cat->alloc_strings, sizeof(char *))) == NULL) {
+    free(cat->buckets);
+    free(cat);
+    return NULL;
   }
+  for (i = 0; i < cat->num_buckets; i ++)
+    cat->buckets[i] = -1;
+  return cat;
 }
 
 void
-free_opt_strings(void* entry, void* user_data)
+optStringsDelete(opt_strings_t *cat)
 {
-  ipp_opt_strings_t *entry_rec = (ipp_opt_strings_t *)entry;
+  opt_strings_chunk_t *chunk, *next;
 
-  if (entry_rec) {
-    if (entry_rec->name) free(entry_rec->name);
-    if (entry_rec->human_readable) free(entry_rec->human_readable);
-    if (entry_rec->choices) cupsArrayDelete(entry_rec->choices);
-    free(entry_rec);
+  if (!cat)
+    return;
+  for (chunk = cat->chunks; chunk; chunk = next) {
+    next = chunk->next;
+    free(chunk);
   }
+  free(cat->strings);
+  free(cat->buckets);
+  free(cat->entries);
+  free(cat);
 }
 
-cups_array_t *
-optArrayNew()
+static const char *
+opt_strings_intern(opt_strings_t *cat, const char *s)
 {
-  return cupsArrayNew3(compare_options, NULL, NULL, 0,
-		       NULL, free_opt_strings);
-}
-
-ipp_opt_strings_t *
-find_opt_in_array(cups_array_t *options, char *name)
-{
-  ipp_opt_strings_t opt;
+  unsigned hash, mask;
+  int i;
+  size_t len;
+  const char **strings;
+  opt_strings_chunk_t *chunk;
+  char *copy;
 
-  if (!name || !options)
+  if (!s)
     return NULL;
 
-  opt.name = name;
-  return cupsArrayFind(options, &opt);
+  /* Already stored? (Open addressing, linear probing) */
+  hash = opt_strings_hash_name(2166136261U, s, 0);
+  mask = cat->alloc_strings - 1;
+  for (i = hash & mask; cat->strings[i]; i = (i + 1) & mask)
+    if (!strcmp(cat->strings[i], s))
+      return cat->strings[i];
+
+  /* Copy the string into the pool */
+  len = strlen(s) + 1;
+  chunk = cat->chunks;
+  if (!chunk || chunk->size - chunk->used < len) {
+    size_t size = len > OPT_STRINGS_CHUNK_SIZE ? len : OPT_STRINGS_CHUNK_SIZE;
+    if ((chunk = malloc(sizeof(opt_strings_chunk_t) + size)) == NULL)
+      return NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->next = cat->chunks;
+    cat->chunks = chunk;
+  }
+  copy = (char *)(chunk + 1) + chunk->used;
+  memcpy(copy, s, len);
+  chunk->used += len;
+
+  /* Keep the table at most half full */
+  if (2 * (cat->num_strings + 1) > cat->alloc_strings) {
+    int alloc = 2 * cat->alloc_strings;
+    if ((strings = calloc(alloc, sizeof(char *))) == NULL)
+      return NULL;
+    mask = alloc - 1;
+    for (i = 0; i < cat->alloc_strings; i ++)
+      if (cat->strings[i]) {
+	int j = opt_strings_hash_name(2166136261U, cat->strings[i], 0) & mask;
+	while (strings[j])
+	  j = (j + 1) & mask;
+	strings[j] = cat->strings[i];
+      }
+    free(cat->strings);
+    cat->strings = strings;
+    cat->alloc_strings = alloc;
+  }
+  for (i = hash & mask; cat->strings[i]; i = (i + 1) & mask);
+  cat->strings[i] = copy;
+  cat->num_strings ++;
+
+  return copy;
 }
 
-ipp_choice_strings_t *
-find_choice_in_array(cups_array_t *choices, char *name)
+static opt_string_t *
+opt_strings_find(opt_strings_t *cat, const char *option, const char *choice)
 {
-  ipp_choice_strings_t choice;
+  unsigned hash;
+  int i;
+  opt_string_t *entry;
 
-  if (!name || !choices)
+  if (!cat || !option)
     return NULL;
 
-  choice.name = name;
-  return cupsArrayFind(choices, &choice);
+  hash = opt_strings_hash(option, choice);
+  for (i = cat->buckets[hash & (cat->num_buckets - 1)]; i >= 0;
+       i = entry->next) {
+    entry = cat->entries + i;
+    if (entry->hash == hash && !strcasecmp(entry->option, option) &&
+	(choice ? (entry->choice && !strcasecmp(entry->choice, choice)) :
+	 !entry->choice))
+      return entry;
+  }
+  return NULL;
 }
 
-ipp_opt_strings_t *
-add_opt_to_array(char *name, char *human_readable, cups_array_t *options)
+static opt_string_t *
+opt_strings_add(opt_strings_t *cat, const char *option, const char *choice,
+		const char *human_readable)
 {
-  ipp_opt_strings_t *opt = NULL;
+  opt_string_t *entry;
+  int i, bucket;
 
-  if (!name || !options)
+  if (!cat || !option)
     return NULL;
 
-  if ((opt = find_opt_in_array(options, name)) == NULL) {
-    opt = calloc(1, sizeof(ipp_opt_strings_t));
-    if (!opt) return NULL;
-    opt->human_readable = NULL;
-    opt->choices = cupsArrayNew3(compare_choices, NULL, NULL, 0,
-				 NULL, free_choice_strings);
-    if (!opt->choices) {
-      free(opt);
-      return NULL;
+  if ((entry = opt_strings_find(cat, option, choice)) == NULL) {
+    /* Grow the entry array and rehash when the load factor exceeds 1 */
+    if (cat->num_entries >= cat->alloc_entries) {
+      int alloc = cat->alloc_entries ? 2 * cat->alloc_entries : 256;
+      opt_string_t *entries = realloc(cat->entries,
+				      alloc * sizeof(opt_string_t));
+      if (!entries)
+	return NULL;
+      cat->entries = entries;
+      cat->alloc_entries = alloc;
     }
-    opt->name = strdup(name);
-    if (!cupsArrayAdd(options, opt)) {
-      free_opt_strings(opt, NULL);
-      return NULL;
+    if (cat->num_entries >= cat->num_buckets) {
+      int *buckets = realloc(cat->buckets,
+			     2 * cat->num_buckets * sizeof(int));
+      if (!buckets)
+	return NULL;
+      cat->buckets = buckets;
+      cat->num_buckets *= 2;
+      for (i = 0; i < cat->num_buckets; i ++)
+	cat->buckets[i] = -1;
+      for (i = 0; i < cat->num_entries; i ++) {
+	bucket = cat->entries[i].hash & (cat->num_buckets - 1);
+	cat->entries[i].next = cat->buckets[bucket];
+	cat->buckets[bucket] = i;
+      }
     }
+    entry = cat->entries + cat->num_entries;
+    entry->option = opt_strings_intern(cat, option);
+    entry->choice = opt_strings_intern(cat, choice);
+    entry->human_readable = NULL;
+    entry->hash = opt_strings_hash(option, choice);
+    if (!entry->option || (choice && !entry->choice))
+      return NULL;
+    bucket = entry->hash & (cat->num_buckets - 1);
+    entry->next = cat->buckets[bucket];
+    cat->buckets[bucket] = cat->num_entries;
+    cat->num_entries ++;
   }
 
   if (human_readable)
-    opt->human_readable = strdup(human_readable);
+    entry->human_readable = opt_strings_intern(cat, human_readable);
 
-  return opt;
+  return entry;
 }
 
-ipp_choice_strings_t *
-add_choice_to_array(char *name, char *human_readable, char *opt_name,
-		    cups_array_t *options)
+opt_string_t *
+add_opt_to_array(char *name, char *human_readable, opt_strings_t *options)
 {
-  ipp_choice_strings_t *choice = NULL;
-  ipp_opt_strings_t *opt;
+  return opt_strings_add(options, name, NULL, human_readable);
+}
 
+opt_string_t *
+add_choice_to_array(char *name, char *human_readable, char *opt_name,
+		    opt_strings_t *options)
+{
   if (!name || !human_readable || !opt_name || !options)
     return NULL;
 
-  opt = add_opt_to_array(opt_name, NULL, options);
-  if (!opt) return NULL;
-
-  if ((choice = find_choice_in_array(opt->choices, name)) == NULL) {
-    choice = calloc(1, sizeof(ipp_choice_strings_t));
-    if (!choice) return NULL;
-    choice->human_readable = NULL;
-    choice->name = strdup(name);
-    if (!cupsArrayAdd(opt->choices, choice)) {
-      free_choice_strings(choice, NULL);
-      return NULL;
-    }
-  }
-
-  if (human_readable)
-    choice->human_readable = strdup(human_readable);
-
-  return choice;
+  /* Like an option with choices in a list, the option gets registered
+     also if it has no human-readable string by itself */
+  if (!add_opt_to_array(opt_name, NULL, options))
+    return NULL;
 
+  return opt_strings_add(options, opt_name, name, human_readable);
 }
 
 char *
-lookup_option(char *name, cups_array_t *options,
-	      cups_array_t *printer_options)
+lookup_option(char *name, opt_strings_t *options,
+	      opt_strings_t *printer_options)
 {
-  ipp_opt_strings_t *opt = NULL;
+  opt_string_t *opt = NULL;
 
   if (!name || !options)
     return NULL;
 
   if (printer_options &&
-      (opt = find_opt_in_array(printer_options, name)) != NULL)
-    return opt->human_readable;
-  if ((opt = find_opt_in_array(options, name)) != NULL)
-    return opt->human_readable;
+      (opt = opt_strings_find(printer_options, name, NULL)) != NULL)
+    return (char *)opt->human_readable;
+  if ((opt = opt_strings_find(options, name, NULL)) != NULL)
+    return (char *)opt->human_readable;
   else
     return NULL;
 }
 
 char *
-lookup_choice(char *name, char *opt_name, cups_array_t *options,
-	      cups_array_t *printer_options)
+lookup_choice(char *name, char *opt_name, opt_strings_t *options,
+	      opt_strings_t *printer_options)
 {
-  ipp_opt_strings_t *opt = NULL;
-  ipp_choice_strings_t *choice = NULL;
+  opt_string_t *choice = NULL;
 
   if (!name || !opt_name || !options)
     return NULL;
 
   if (printer_options &&
-      (opt = find_opt_in_array(printer_options, opt_name)) != NULL &&
-      (choice = find_choice_in_array(opt->choices, name)) != NULL)
-    return choice->human_readable;
-  else if ((opt = find_opt_in_array(options, opt_name)) != NULL &&
-	   (choice = find_choice_in_array(opt->choices, name)) != NULL)
-    return choice->human_readable;
+      (choice = opt_strings_find(printer_options, opt_name, name)) != NULL)
+    return (char *)choice->human_readable;
+  else if ((choice = opt_strings_find(options, opt_name, name)) != NULL)
+    return (char *)choice->human_readable;
   else
     return NULL;
 }
 
-void
-load_opt_strings_catalog(const char *location, cups_array_t *options)
+int
+load_opt_strings_catalog(const char *location, opt_strings_t *options)
 {
   char tmpfile[1024];
   const char *filename = NULL;
@@ -774,10 +885,15 @@ load_opt_strings_catalog(const char *location, cups_array_t *options)
       filename = tmpfile;
   }
   if (!filename)
-    return;
-
-  if ((fp = cupsFileOpen(filename, "r")) == NULL)
-    return;
+    return 0;
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL) {
+    if (filename == tmpfile)
+      unlink(filename);
+    if (found_in_catalog)
+      free((char *)filename);
+    return 0;
+  }
 
   while (cupsFileGets(fp, line, sizeof(line)) || (part = 10)) {
     /* Find a pair of quotes delimiting a string in each line
@@ -952,8 +1068,57 @@ load_opt_strings_catalog(const char *location, cups_array_t *options)
     unlink(filename);
   if (found_in_catalog)
     free((char *)filename);
+  return 1;
+}
+
+
+/* Printer-specific UI string catalogs already loaded by this process,
+   so that we do not download and parse them again each time a PPD for
+   the same printer is generated */
+typedef struct printer_catalog_s {
+  char *url;
+  opt_strings_t *options;
+} printer_catalog_t;
+
+static cups_array_t *printer_catalogs = NULL;
+
+static int
+compare_printer_catalogs(void *a, void *b, void *user_data)
+{
+  return strcmp(((printer_catalog_t *)a)->url,
+		((printer_catalog_t *)b)->url);
 }
 
+static opt_strings_t *
+get_printer_opt_strings_catalog(const char *url)
+{
+  printer_catalog_t key, *catalog;
+
+  if (printer_catalogs == NULL &&
+      (printer_catalogs = cupsArrayNew3(compare_printer_catalogs, NULL, NULL,
+					0, NULL, NULL)) == NULL)
+    return NULL;
+
+  key.url = (char *)url;
+  if ((catalog = cupsArrayFind(printer_catalogs, &key)) != NULL)
+    return catalog->options;
+
+  if ((catalog = calloc(1, sizeof(printer_catalog_t))) == NULL)
+    return NULL;
+  catalog->url = strdup(url);
+  catalog->options = optStringsNew();
+  /* Do not remember a catalog which we could not get, the printer may
+     simply not have been ready yet */
+  if (!load_opt_strings_catalog(url, catalog->options)) {
+    optStringsDelete(catalog->options);
+    free(catalog->url);
+    free(catalog);
+    return NULL;
+  }
+  cupsArrayAdd(printer_catalogs, catalog);
+
+  return catalog->options;
+}
 
 int
 compare_resolutions(void *resolution_a, void *resolution_b,
@@ -1516,6 +1681,257 @@ int is_colordevice(const char *keyword,ipp_attribute_t *attr)
   return 0;
 }
 
+/*
+ * PPD cache
+ *
+ * If the environment variable PPD_GENERATOR_CACHE_DIR is set, generated
+ * PPD files are stored in this directory, named by a hash of everything
+ * which goes into the PPD: the printer's IPP attributes (without the
+ * volatile status attributes), the other arguments of ppdCreateFromIPP2(),
+ * the cups-filters version, CUPS_SERVERBIN, and the language. When the
+ * same printer is seen again the cached PPD is simply copied.
+ */
+
+#define PPD_CACHE_FNV_OFFSET 14695981039346656037ULL
+#define PPD_CACHE_FNV_PRIME  1099511628211ULL
+
+typedef struct ppd_cache_hash_s {
+  unsigned long long h1, h2;		/* Two independent FNV-1a hashes */
+  size_t	     length;		/* Number of bytes hashed */
+} ppd_cache_hash_t;
+
+/* IPP attributes which change while the printer is running, but do not
+   influence the generated PPD */
+static const char * const ppd_cache_volatile_attrs[] =
+{
+  "marker-change-time",
+  "marker-colors",
+  "marker-high-levels",
+  "marker-levels",
+  "marker-low-levels",
+  "marker-message",
+  "marker-names",
+  "marker-types",
+  "printer-alert",
+  "printer-alert-description",
+  "printer-config-change-date-time",
+  "printer-config-change-time",
+  "printer-current-time",
+  "printer-is-accepting-jobs",
+  "printer-state",
+  "printer-state-change-date-time",
+  "printer-state-change-time",
+  "printer-state-message",
+  "printer-state-reasons",
+  "printer-supply",
+  "printer-supply-description",
+  "printer-up-time",
+  "queued-job-count"
+};
+
+static void
+ppd_cache_hash_data(ppd_cache_hash_t *hash, const void *data, size_t len)
+{
+  const unsigned char *ptr = (const unsigned char *)data;
+
+  hash->length += len;
+  while (len --) {
+    hash->h1 = (hash->h1 ^ *ptr) * PPD_CACHE_FNV_PRIME;
+    hash->h2 = (hash->h2 ^ (*ptr ^ 0x5c)) * PPD_CACHE_FNV_PRIME;
+    ptr ++;
+  }
+}
+
+static void
+ppd_cache_hash_string(ppd_cache_hash_t *hash, const char *s)
+{
+  /* Include the terminating zero, so that "ab","c" and "a","bc" differ,
+     and distinguish NULL from "" */
+  if (s)
+    ppd_cache_hash_data(hash, s, strlen(s) + 1);
+  else
+    ppd_cache_hash_data(hash, "\377", 1);
+}
+
+static int
+ppd_cache_is_volatile(const char *name)
+{
+  int i;
+
+  for (i = 0;
+       i < (int)(sizeof(ppd_cache_volatile_attrs) /
+		 sizeof(ppd_cache_volatile_attrs[0]));
+       i ++)
+    if (!strcmp(name, ppd_cache_volatile_attrs[i]))
+      return 1;
+  return 0;
+}
+
+static void
+ppd_cache_key(char         *key,		/* O - Cache key */
+	      size_t       keysize,		/* I - Size of key buffer */
+	      ipp_t        *response,
+	      const char   *make_model,
+	      const char   *pdl,
+	      int          color,
+	      int          duplex,
+	      cups_array_t *conflicts,
+	      cups_array_t *sizes,
+	      const char   *default_pagesize,
+	      const char   *default_cluster_color)
+{
+  ppd_cache_hash_t hash;
+  ipp_attribute_t *attr;
+  const char	  *name;
+  char		  buf[1024], *value;
+  int		  len, tag;
+  cups_size_t	  *size;
+  char		  *constraint;
+
+  hash.h1 = PPD_CACHE_FNV_OFFSET;
+  hash.h2 = PPD_CACHE_FNV_OFFSET ^ 0x9e3779b97f4a7c15ULL;
+  hash.length = 0;
+
+  for (attr = ippFirstAttribute(response); attr;
+       attr = ippNextAttribute(response)) {
+    if ((name = ippGetName(attr)) == NULL || ppd_cache_is_volatile(name))
+      continue;
+    ppd_cache_hash_string(&hash, name);
+    tag = ippGetValueTag(attr);
+    ppd_cache_hash_data(&hash, &tag, sizeof(tag));
+    if ((len = ippAttributeString(attr, buf, sizeof(buf))) <
+	(int)sizeof(buf))
+      ppd_cache_hash_string(&hash, buf);
+    else if ((value = malloc(len + 1)) != NULL) {
+      ippAttributeString(attr, value, len + 1);
+      ppd_cache_hash_string(&hash, value);
+      free(value);
+    }
+  }
+
+  ppd_cache_hash_string(&hash, make_model);
+  ppd_cache_hash_string(&hash, pdl);
+  ppd_cache_hash_data(&hash, &color, sizeof(color));
+  ppd_cache_hash_data(&hash, &duplex, sizeof(duplex));
+  if (conflicts)
+    for (constraint = (char *)cupsArrayFirst(conflicts); constraint;
+	 constraint = (char *)cupsArrayNext(conflicts))
+      ppd_cache_hash_string(&hash, constraint);
+  ppd_cache_hash_data(&hash, "\0", 1);
+  if (sizes)
+    for (size = (cups_size_t *)cupsArrayFirst(sizes); size;
+	 size = (cups_size_t *)cupsArrayNext(sizes)) {
+      snprintf(buf, sizeof(buf), "%s %d %d %d %d %d %d", size->media,
+	       size->width, size->length, size->bottom, size->left,
+	       size->right, size->top);
+      ppd_cache_hash_string(&hash, buf);
+    }
+  ppd_cache_hash_data(&hash, "\0", 1);
+  ppd_cache_hash_string(&hash, default_pagesize);
+  ppd_cache_hash_string(&hash, default_cluster_color);
+  ppd_cache_hash_string(&hash, VERSION);
+  ppd_cache_hash_string(&hash, getenv("CUPS_SERVERBIN"));
+  ppd_cache_hash_string(&hash, cupsLangDefault()->language);
+
+  snprintf(key, keysize, "%016llx%016llx-%lu", hash.h1, hash.h2,
+	   (unsigned long)hash.length);
+}
+
+static int				/* O - 1 on success, 0 on failure */
+ppd_cache_copy(cups_file_t *in,		/* I - Source file */
+	       cups_file_t *to)		/* I - Destination file */
+{
+  char	      buf[65536];
+  ssize_t     bytes;
+
+  while ((bytes = cupsFileRead(in, buf, sizeof(buf))) > 0)
+    if (cupsFileWrite(to, buf, (size_t)bytes) != bytes)
+      return (0);
+  return (bytes == 0);
+}
+
+/* The cache directory may be shared, only use it and the files in it if
+   they belong to us and nobody else can write to them */
+static int				/* O - 1 if trusted, 0 otherwise */
+ppd_cache_trusted(struct stat *st,	/* I - File information */
+		  int	      isdir)	/* I - Directory expected? */
+{
+  return ((isdir ? S_ISDIR(st->st_mode) : S_ISREG(st->st_mode)) &&
+	  st->st_uid == getuid() &&
+	  !(st->st_mode & (S_IWGRP | S_IWOTH)));
+}
+
+static int				/* O - 1 if found in cache, 0 otherwise */
+ppd_cache_fetch(const char *cachedir,	/* I - Cache directory */
+		const char *cachefile,	/* I - PPD file in the cache */
+		char       *buffer,	/* I - Filename buffer */
+		size_t     bufsize)	/* I - Size of filename buffer */
+{
+  cups_file_t *in, *fp;
+  struct stat st;
+  int	      fd;
+
+  if (lstat(cachedir, &st) || !ppd_cache_trusted(&st, 1))
+    return (0);
+  if ((fd = open(cachefile, O_RDONLY | O_NOFOLLOW)) < 0)
+    return (0);
+  if (fstat(fd, &st) || !ppd_cache_trusted(&st, 0) ||
+      (in = cupsFileOpenFd(fd, "r")) == NULL) {
+    close(fd);
+    return (0);
+  }
+  if ((fp = cupsTempFile2(buffer, (int)bufsize)) == NULL) {
+    cupsFileClose(in);
+    return (0);
+  }
+  if (!ppd_cache_copy(in, fp)) {
+    cupsFileClose(in);
+    cupsFileClose(fp);
+    unlink(buffer);
+    *buffer = '\0';
+    return (0);
+  }
+  cupsFileClose(in);
+  cupsFileClose(fp);
+  return (1);
+}
+
+static void
+ppd_cache_store(const char *ppdfile,	/* I - Generated PPD file */
+		const char *cachedir,	/* I - Cache directory */
+		const char *cachefile)	/* I - PPD file in the cache */
+{
+  cups_file_t *in, *fp;
+  struct stat st;
+  char	      tmpfile[1024];
+  int	      fd, ret;
+
+  /* Write to a new temporary file and rename, so that concurrent readers
+     never see a partial PPD */
+  if (mkdir(cachedir, 0700) && errno != EEXIST)
+    return;
+  if (lstat(cachedir, &st) || !ppd_cache_trusted(&st, 1))
+    return;
+  snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", cachefile);
+  if ((fd = mkstemp(tmpfile)) < 0)
+    return;
+  if ((fp = cupsFileOpenFd(fd, "w")) == NULL) {
+    close(fd);
+    unlink(tmpfile);
+    return;
+  }
+  if ((in = cupsFileOpen(ppdfile, "r")) == NULL) {
+    cupsFileClose(fp);
+    unlink(tmpfile);
+    return;
+  }
+  ret = ppd_cache_copy(in, fp);
+  cupsFileClose(in);
+  if (cupsFileClose(fp) || !ret || rename(tmpfile, cachefile))
+    unlink(tmpfile);
+}
+
+
 /*
  * 'ppdCreateFromIPP()' - Create a PPD file describing the capabilities
  *                        of an IPP printer (legacy interface).
@@ -1614,7 +2030,7 @@ ppdCreateFromIPP2(char         *buffer,          /* I - Filename buffer */
 					/* Localization info */
   struct lconv		*loc = localeconv();
 					/* Locale data */
-  cups_array_t          *printer_opt_strings_catalog = NULL;
+  opt_strings_t         *printer_opt_strings_catalog = NULL;
                                         /* Printer-specific option UI strings */
   char                  *human_readable,
                         *human_readable2;
@@ -1636,6 +2052,9 @@ ppdCreateFromIPP2(char         *buffer,          /* I - Filename buffer */
 			firsttolast = 1;
   int			manual_copies = -1,
 			is_fax = 0;
+  const char		*cachedir;	/* PPD cache directory */
+  char			cachekey[64],	/* Hash of the input data */
+			cachefile[1024];/* PPD file in the cache */
 
  /*
   * Range check input...
@@ -1654,6 +2073,23 @@ ppdCreateFromIPP2(char         *buffer,          /* I - Filename buffer */
     return (NULL);
   }
 
+ /*
+  * Did we already generate a PPD for exactly this input?
+  */
+
+  cachefile[0] = '\0';
+  if ((cachedir = getenv("PPD_GENERATOR_CACHE_DIR")) != NULL && cachedir[0]) {
+    ppd_cache_key(cachekey, sizeof(cachekey), response, make_model, pdl,
+		  color, duplex, conflicts, sizes, default_pagesize,
+		  default_cluster_color);
+    snprintf(cachefile, sizeof(cachefile), "%s/%s.ppd", cachedir, cachekey);
+    if (ppd_cache_fetch(cachedir, cachefile, buffer, bufsize)) {
+      snprintf(ppdgenerator_msg, sizeof(ppdgenerator_msg),
+	       "PPD taken from cache (%s).", cachekey);
+      return (buffer);
+    }
+  }
+
  /*
   * Open a temporary file for the PPD...
   */
@@ -1816,17 +2252,20 @@ ppdCreateFromIPP2(char         *buffer,          /* I - Filename buffer */
 
   /* Message catalogs for UI strings */
   if (opt_strings_catalog == NULL) {
-    opt_strings_catalog = optArrayNew();
+    opt_strings_catalog = optStringsNew();
     load_opt_strings_catalog(NULL, opt_strings_catalog);
   }
   if ((attr = ippFindAttribute(response, "printer-strings-uri",
 			       IPP_TAG_URI)) != NULL) {
-    printer_opt_strings_catalog = optArrayNew();
-    load_opt_strings_catalog(ippGetString(attr, 0, NULL),
-			     printer_opt_strings_catalog);
+    printer_opt_strings_catalog =
+      get_printer_opt_strings_catalog(ippGetString(attr, 0, NULL));
     if (printer_opt_strings_catalog)
       cupsFilePrintf(fp, "*cupsStringsURI: \"%s\"\n", ippGetString(attr, 0,
 								   NULL));
+    else
+      /* The PPD lacks the printer's own UI strings, do not cache it, so
+	 that we try again next time */
+      cachefile[0] = '\0';
   }
 
  /*
@@ -4258,8 +4697,9 @@ ppdCreateFromIPP2(char         *buffer,          /* I - Filename buffer */
 	   (is_fax ? "Fax " : ""));
 
   cupsFileClose(fp);
-  if (printer_opt_strings_catalog)
-    cupsArrayDelete(printer_opt_strings_catalog);
+
+  if (cachefile[0])
+    ppd_cache_store(buffer, cachedir, cachefile);
 
   return (buffer);
 
@@ -4275,8 +4715,6 @@ ppdCreateFromIPP2(char         *buffer,          /* I - Filename buffer */
   if (max_res) free(max_res);
 
   cupsFileClose(fp);
-  if (printer_opt_strings_catalog)
-    cupsArrayDelete(printer_opt_strings_catalog);
   unlink(buffer);
   *buffer = '\0';
 
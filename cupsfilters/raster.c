@@ -8,8 +8,20 @@
  *
  * Contents:
  *
- *   cupsRasterParseIPPOptions() - Parse IPP options from the command line
- *                                 and apply them to the CUPS Raster header.
+ *   cupsRasterParseIPPOptions()   - Parse IPP options from the command line
+ *                                   and apply them to the CUPS Raster header.
+ *   cupsRasterCopiesNew()         - Create a generator for copies of
+ *                                   rendered pages.
+ *   cupsRasterCopiesWriteHeader() - Start a new page.
+ *   cupsRasterCopiesWritePixels() - Write pixels of the current page.
+ *   cupsRasterCopiesFinish()      - Write the remaining copies.
+ *   cupsRasterCopiesDelete()      - Free a copies generator.
+ *   cupsRasterCopiesStream()      - Copy a raster stream, generating the
+ *                                   copies.
+ *   copies_append()               - Append data to the page store.
+ *   copies_read()                 - Read data from the page store.
+ *   copies_replay()               - Write the stored pages again.
+ *   copies_reset()                - Empty the page store.
  */
 
 #include <config.h>
@@ -24,12 +36,45 @@
  */
 
 #include "driver.h"
+#include "raster.h"
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 #ifdef HAVE_CUPS_1_7
 #include <cups/pwg.h>
 #endif /* HAVE_CUPS_1_7 */
 
+/*
+ * Copies of rendered pages: the first copy of every page goes straight
+ * to the output while it is kept in a page store, further copies are
+ * written from the store.  Collated copies need the whole job in the
+ * store, uncollated ones only the current page.  The store is kept in
+ * memory up to RIP_MAX_CACHE bytes and moved to a temporary file when
+ * it grows beyond that.
+ */
+
+struct cups_raster_copies_s		/**** Copies of rendered pages ****/
+{
+  int		copies,			/* Number of copies */
+		collate;		/* Collate copies? */
+  size_t	max_mem;		/* Max. size of the in-memory store */
+  unsigned char	*mem;			/* In-memory store */
+  size_t	mem_used,		/* Bytes used in the in-memory store */
+		mem_alloc;		/* Bytes allocated for it */
+  int		fd;			/* Store file or -1 */
+  off_t		file_used;		/* Bytes in the store file */
+  int		num_pages;		/* Number of pages in the store */
+  int		error;			/* Writing to the store failed? */
+};
+
+static int	copies_append(cups_raster_copies_t *rc, const void *data,
+		              size_t len);
+static int	copies_read(cups_raster_copies_t *rc, off_t pos, void *data,
+		            size_t len);
+static int	copies_replay(cups_raster_copies_t *rc, cups_raster_t *r);
+static void	copies_reset(cups_raster_copies_t *rc);
+
+
 /*
  * '_strlcpy()' - Safely copy two strings.
  */
@@ -1212,6 +1257,450 @@ cupsRasterParseIPPOptions(cups_page_header2_t *h, /* I - Raster header */
 }
 
 
+/*
+ * 'cupsRasterCopiesNew()' - Create a generator for copies of rendered pages.
+ */
+
+cups_raster_copies_t *			/* O - Copies generator or NULL */
+cupsRasterCopiesNew(int copies,		/* I - Number of copies */
+		    int collate)	/* I - 1 for collated copies */
+{
+  cups_raster_copies_t	*rc;		/* New copies generator */
+  char			*cache_env,	/* RIP_MAX_CACHE environment variable */
+			cache_units[255];/* Cache size units */
+  long			max_size;	/* Max. size of in-memory store */
+
+
+  if (copies < 1)
+    return (NULL);
+
+  if ((rc = calloc(1, sizeof(cups_raster_copies_t))) == NULL)
+    return (NULL);
+
+  rc->copies  = copies;
+  rc->collate = collate;
+  rc->fd      = -1;
+
+ /*
+  * Same units as for the image tile cache, "t" (tiles) is taken as 256k...
+  */
+
+  max_size = 32 * 1024 * 1024;
+  if ((cache_env = getenv("RIP_MAX_CACHE")) != NULL)
+  {
+    switch (sscanf(cache_env, "%ld%254s", &max_size, cache_units))
+    {
+      case 0 :
+          max_size = 32 * 1024 * 1024;
+	  break;
+      case 1 :
+          max_size *= 256 * 1024;
+	  break;
+      case 2 :
+          if (tolower(cache_units[0] & 255) == 'g')
+	    max_size *= 1024 * 1024 * 1024;
+          else if (tolower(cache_units[0] & 255) == 'm')
+	    max_size *= 1024 * 1024;
+	  else if (tolower(cache_units[0] & 255) == 'k')
+	    max_size *= 1024;
+	  else if (tolower(cache_units[0] & 255) == 't')
+	    max_size *= 256 * 1024;
+	  break;
+    }
+  }
+  rc->max_mem = max_size > 0 ? (size_t)max_size : 0;
+
+  return (rc);
+}
+
+
+/*
+ * 'cupsRasterCopiesWriteHeader()' - Start a new page.
+ *
+ * For uncollated copies this writes the remaining copies of the previous
+ * page first.
+ */
+
+unsigned				/* O - 1 on success, 0 on failure */
+cupsRasterCopiesWriteHeader(
+    cups_raster_copies_t *rc,		/* I - Copies generator */
+    cups_raster_t        *r,		/* I - Raster stream */
+    cups_page_header2_t  *h)		/* I - Page header */
+{
+  if (!rc || rc->copies == 1)
+    return (cupsRasterWriteHeader2(r, h));
+
+  if (!rc->collate && rc->num_pages > 0)
+  {
+    if (!copies_replay(rc, r))
+      return (0);
+    copies_reset(rc);
+  }
+
+  if (!cupsRasterWriteHeader2(r, h))
+    return (0);
+
+  rc->num_pages ++;
+  copies_append(rc, h, sizeof(cups_page_header2_t));
+
+  return (1);
+}
+
+
+/*
+ * 'cupsRasterCopiesWritePixels()' - Write pixels of the current page.
+ */
+
+unsigned				/* O - Number of bytes written */
+cupsRasterCopiesWritePixels(
+    cups_raster_copies_t *rc,		/* I - Copies generator */
+    cups_raster_t        *r,		/* I - Raster stream */
+    unsigned char        *p,		/* I - Pixels */
+    unsigned             len)		/* I - Number of bytes */
+{
+  if (rc && rc->copies > 1)
+    copies_append(rc, p, len);
+
+  return (cupsRasterWritePixels(r, p, len));
+}
+
+
+/*
+ * 'cupsRasterCopiesFinish()' - Write the remaining copies.
+ */
+
+int					/* O - 0 on success, -1 on error */
+cupsRasterCopiesFinish(
+    cups_raster_copies_t *rc,		/* I - Copies generator */
+    cups_raster_t        *r)		/* I - Raster stream */
+{
+  int	copy;				/* Current copy */
+
+
+  if (!rc || rc->copies == 1 || rc->num_pages == 0)
+    return (0);
+
+  if (rc->error)
+  {
+    fputs("ERROR: Unable to store rendered pages for copies\n", stderr);
+    return (-1);
+  }
+
+  if (rc->collate)
+  {
+    for (copy = 1; copy < rc->copies; copy ++)
+      if (!copies_replay(rc, r))
+	return (-1);
+  }
+  else if (!copies_replay(rc, r))
+    return (-1);
+
+  copies_reset(rc);
+
+  return (0);
+}
+
+
+/*
+ * 'cupsRasterCopiesDelete()' - Free a copies generator.
+ */
+
+void
+cupsRasterCopiesDelete(
+    cups_raster_copies_t *rc)		/* I - Copies generator */
+{
+  if (!rc)
+    return;
+
+  if (rc->fd >= 0)
+    close(rc->fd);
+  free(rc->mem);
+  free(rc);
+}
+
+
+/*
+ * 'cupsRasterCopiesStream()' - Copy a raster stream, generating the copies.
+ *
+ * Used by filters which let an external renderer write the raster data,
+ * the renderer's output is piped into infd.
+ */
+
+int					/* O - 0 on success, -1 on error */
+cupsRasterCopiesStream(int         infd,/* I - Raster input */
+		       int         outfd,/* I - Raster output */
+		       cups_mode_t mode,/* I - Output mode */
+		       int         copies,/* I - Number of copies */
+		       int         collate)/* I - 1 for collated copies */
+{
+  cups_raster_t		*in,		/* Input stream */
+			*out;		/* Output stream */
+  cups_raster_copies_t	*rc;		/* Copies generator */
+  cups_page_header2_t	h;		/* Page header */
+  unsigned char		*line = NULL;	/* Line buffer */
+  unsigned		y;		/* Current line */
+  int			ret = 0;	/* Return value */
+
+
+  if ((in = cupsRasterOpen(infd, CUPS_RASTER_READ)) == NULL)
+    return (-1);
+  if ((out = cupsRasterOpen(outfd, mode)) == NULL)
+  {
+    cupsRasterClose(in);
+    return (-1);
+  }
+  rc = cupsRasterCopiesNew(copies, collate);
+
+  while (ret == 0 && cupsRasterReadHeader2(in, &h))
+  {
+    if (!cupsRasterCopiesWriteHeader(rc, out, &h) ||
+        (line = realloc(line, h.cupsBytesPerLine ? h.cupsBytesPerLine : 1))
+	    == NULL)
+    {
+      ret = -1;
+      break;
+    }
+
+    for (y = 0; y < h.cupsHeight; y ++)
+    {
+      if (cupsRasterReadPixels(in, line, h.cupsBytesPerLine) !=
+	      h.cupsBytesPerLine ||
+          cupsRasterCopiesWritePixels(rc, out, line, h.cupsBytesPerLine) !=
+	      h.cupsBytesPerLine)
+      {
+	ret = -1;
+	break;
+      }
+    }
+  }
+
+  if (ret == 0)
+    ret = cupsRasterCopiesFinish(rc, out);
+
+  free(line);
+  cupsRasterCopiesDelete(rc);
+  cupsRasterClose(out);
+  cupsRasterClose(in);
+
+  return (ret);
+}
+
+
+/*
+ * 'copies_append()' - Append data to the page store.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+copies_append(cups_raster_copies_t *rc,	/* I - Copies generator */
+	      const void           *data,/* I - Data */
+	      size_t               len)	/* I - Number of bytes */
+{
+  const char	*ptr;			/* Pointer into data */
+  ssize_t	bytes;			/* Bytes written */
+  char		filename[1024];		/* Temporary file name */
+
+
+  if (rc->error)
+    return (-1);
+
+  if (rc->fd < 0 && rc->mem_used + len <= rc->max_mem)
+  {
+    if (rc->mem_used + len > rc->mem_alloc)
+    {
+      size_t	alloc = rc->mem_alloc ? 2 * rc->mem_alloc : 1024 * 1024;
+      unsigned char *mem;		/* New store */
+
+      while (alloc < rc->mem_used + len)
+	alloc *= 2;
+      if (alloc > rc->max_mem)
+	alloc = rc->max_mem;
+
+      if ((mem = realloc(rc->mem, alloc)) == NULL)
+	goto spill;
+
+      rc->mem       = mem;
+      rc->mem_alloc = alloc;
+    }
+
+    memcpy(rc->mem + rc->mem_used, data, len);
+    rc->mem_used += len;
+
+    return (0);
+  }
+
+  spill:
+
+  if (rc->fd < 0)
+  {
+   /*
+    * Move the store into a temporary file...
+    */
+
+    if ((rc->fd = cupsTempFd(filename, sizeof(filename))) < 0)
+    {
+      rc->error = 1;
+      return (-1);
+    }
+    unlink(filename);
+
+    fprintf(stderr, "DEBUG: Storing rendered pages for copies in a "
+		    "temporary file.\n");
+
+    rc->file_used = 0;
+    if (rc->mem_used > 0 && copies_append(rc, rc->mem, rc->mem_used))
+      return (-1);
+    free(rc->mem);
+    rc->mem       = NULL;
+    rc->mem_used  = 0;
+    rc->mem_alloc = 0;
+  }
+
+  for (ptr = data; len > 0; ptr += bytes, len -= (size_t)bytes)
+  {
+    if ((bytes = pwrite(rc->fd, ptr, len, rc->file_used)) < 0)
+    {
+      if (errno == EINTR)
+      {
+        bytes = 0;
+	continue;
+      }
+
+      rc->error = 1;
+      return (-1);
+    }
+    rc->file_used += bytes;
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'copies_read()' - Read data from the page store.
+ */
+
+static int				/* O - 0 on success, -1 on error */
+copies_read(cups_raster_copies_t *rc,	/* I - Copies generator */
+	    off_t                pos,	/* I - Position in store */
+	    void                 *data,	/* I - Buffer */
+	    size_t               len)	/* I - Number of bytes */
+{
+  char		*ptr;			/* Pointer into buffer */
+  ssize_t	bytes;			/* Bytes read */
+
+
+  if (rc->fd < 0)
+  {
+    if ((size_t)pos + len > rc->mem_used)
+      return (-1);
+
+    memcpy(data, rc->mem + pos, len);
+    return (0);
+  }
+
+  for (ptr = data; len > 0; ptr += bytes, pos += bytes, len -= (size_t)bytes)
+  {
+    if ((bytes = pread(rc->fd, ptr, len, pos)) <= 0)
+    {
+      if (bytes < 0 && errno == EINTR)
+      {
+        bytes = 0;
+	continue;
+      }
+
+      return (-1);
+    }
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'copies_replay()' - Write the stored pages again.
+ */
+
+static int				/* O - 1 on success, 0 on error */
+copies_replay(cups_raster_copies_t *rc,	/* I - Copies generator */
+	      cups_raster_t        *r)	/* I - Raster stream */
+{
+  int			page,		/* Current page */
+			copy,		/* Current copy */
+			copies;		/* Number of copies to write */
+  off_t			pos,		/* Position in store */
+			page_pos;	/* Start of page in store */
+  cups_page_header2_t	h;		/* Page header */
+  unsigned char		*buffer;	/* Pixel buffer */
+  size_t		page_bytes,	/* Pixel bytes in page */
+			chunk,		/* Bytes per read */
+			bytes;		/* Bytes to write */
+
+
+  if (rc->error)
+    return (0);
+
+ /*
+  * For uncollated copies the store only holds the current page which
+  * is repeated, collated copies repeat all pages once per call...
+  */
+
+  copies = rc->collate ? 1 : rc->copies - 1;
+
+  for (copy = 0; copy < copies; copy ++)
+  {
+    for (page = 0, pos = 0; page < rc->num_pages; page ++)
+    {
+      if (copies_read(rc, pos, &h, sizeof(h)))
+	return (0);
+
+      page_pos   = pos + sizeof(h);
+      page_bytes = (size_t)h.cupsBytesPerLine * h.cupsHeight;
+      chunk      = h.cupsBytesPerLine ?
+                       h.cupsBytesPerLine * (65536 / h.cupsBytesPerLine + 1) :
+		       65536;
+
+      if (!cupsRasterWriteHeader2(r, &h) ||
+	  (buffer = malloc(chunk)) == NULL)
+	return (0);
+
+      for (pos = page_pos; pos < page_pos + (off_t)page_bytes; pos += bytes)
+      {
+        bytes = page_pos + page_bytes - pos;
+	if (bytes > chunk)
+	  bytes = chunk;
+
+	if (copies_read(rc, pos, buffer, bytes) ||
+	    cupsRasterWritePixels(r, buffer, bytes) != bytes)
+	{
+	  free(buffer);
+	  return (0);
+	}
+      }
+
+      free(buffer);
+    }
+  }
+
+  return (1);
+}
+
+
+/*
+ * 'copies_reset()' - Empty the page store.
+ */
+
+static void
+copies_reset(cups_raster_copies_t *rc)	/* I - Copies generator */
+{
+  rc->mem_used  = 0;
+  rc->file_used = 0;
+  rc->num_pages = 0;
+
+  if (rc->fd >= 0 && ftruncate(rc->fd, 0))
+    rc->error = 1;
+}
+
+
 /*
  * End
  */
@@ -33,6 +33,14 @@ extern "C" {
 #  include <cups/cups.h>
 #  include <cups/raster.h>
 
+/*
+ * Types...
+ */
+
+typedef struct cups_raster_copies_s cups_raster_copies_t;
+					/**** Copies of rendered pages ****/
+
+
 /*
  * Prototypes...
  */
@@ -43,6 +51,21 @@ extern int              cupsRasterParseIPPOptions(cups_page_header2_t *h,
 						  int pwg_raster,
 						  int set_defaults);
 
+extern cups_raster_copies_t *cupsRasterCopiesNew(int copies, int collate);
+extern unsigned		cupsRasterCopiesWriteHeader(cups_raster_copies_t *rc,
+						    cups_raster_t *r,
+						    cups_page_header2_t *h);
+extern unsigned		cupsRasterCopiesWritePixels(cups_raster_copies_t *rc,
+						    cups_raster_t *r,
+						    unsigned char *p,
+						    unsigned len);
+extern int		cupsRasterCopiesFinish(cups_raster_copies_t *rc,
+					       cups_raster_t *r);
+extern void		cupsRasterCopiesDelete(cups_raster_copies_t *rc);
+extern int		cupsRasterCopiesStream(int infd, int outfd,
+					       cups_mode_t mode, int copies,
+					       int collate);
+
 #  ifdef __cplusplus
 }
 #  endif /* __cplusplus */
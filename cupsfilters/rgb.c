@@ -16,13 +16,22 @@
  *   cupsRGBDoRGB()  - Do a RGB separation...
  *   cupsRGBLoad()   - Load a RGB color profile from a PPD file.
  *   cupsRGBNew()    - Create a new RGB color separation.
+ *   rgb_bake()      - Separate grid nodes for baking.
  */
 
 /*
  * Include necessary headers.
  */
 
-#include "driver.h"
+#include "driver-private.h"
+
+
+/*
+ * Local functions...
+ */
+
+static void	rgb_bake(void *data, const unsigned char *input,
+		         unsigned char *output, int num_pixels);
 
 
 /*
@@ -35,6 +44,8 @@ cupsRGBDelete(cups_rgb_t *rgbptr)	/* I - Color separation */
   if (rgbptr == NULL)
     return;
 
+  _cupsGridDelete(rgbptr->grid);
+
   free(rgbptr->colors[0][0][0]);
   free(rgbptr->colors[0][0]);
   free(rgbptr->colors[0]);
@@ -193,6 +204,12 @@ cupsRGBDoRGB(cups_rgb_t          *rgbptr,
   if (!rgbptr || !input || !output || num_pixels <= 0)
     return;
 
+  if (rgbptr->grid)
+  {
+    _cupsGridDoRGB(rgbptr->grid, input, output, num_pixels);
+    return;
+  }
+
  /*
   * Initialize variables used for the duration of the separation...
   */
@@ -404,6 +421,14 @@ cupsRGBLoad(ppd_file_t *ppd,		/* I - PPD file */
   else
     rgbptr = NULL;
 
+ /*
+  * Bake the separation into a finer grid if the PPD file asks for it...
+  */
+
+  if (rgbptr)
+    rgbptr->grid = _cupsGridLoad(ppd, colormodel, media, resolution,
+                                 num_channels, rgb_bake, rgbptr);
+
  /*
   * Free the temporary sample array and return...
   */
@@ -549,3 +574,17 @@ cupsRGBNew(int           num_samples,	/* I - Number of samples */
   return (rgbptr);
 }
 
+
+/*
+ * 'rgb_bake()' - Separate grid nodes for baking.
+ */
+
+static void
+rgb_bake(void                *data,	/* I - Color separation */
+         const unsigned char *input,	/* I - Input RGB pixels */
+	 unsigned char       *output,	/* O - Output Device-N pixels */
+	 int                 num_pixels)/* I - Number of pixels */
+{
+  cupsRGBDoRGB((cups_rgb_t *)data, input, output, num_pixels);
+}
+
@@ -9,6 +9,11 @@
  *       testdither 0 63 127 170 198 227 255 > filename.ppm
  *       testdither 0 210 383 > filename.ppm
  *       testdither 0 82 255 > filename.ppm
+ *       testdither -m 0 255 > filename.ppm
+ *       testdither -o 0 127 255 > filename.ppm
+ *
+ *   The "-m" option uses the multi-channel error diffusion API and the
+ *   "-o" option uses multi-channel ordered dithering.
  *
  *   Copyright 2007-2011 by Apple Inc.
  *   Copyright 1993-2005 by Easy Software Products.
@@ -56,6 +61,9 @@ main(int  argc,			/* I - Number of command-line arguments */
   int		output;		/* Output pixel */
   cups_lut_t	*lut;		/* Dither lookup table */
   cups_dither_t	*dither;	/* Dither state */
+  cups_dither_multi_t *mdither;	/* Multi-channel dither state */
+  int		mode;		/* Multi-channel mode or -1 */
+  unsigned char	*pixplanes[1];	/* Pixel planes for multi-channel API */
   int		nlutvals;	/* Number of lookup values */
   float		lutvals[16];	/* Lookup values */
   int		pixvals[16];	/* Pixel values */
@@ -65,15 +73,24 @@ main(int  argc,			/* I - Number of command-line arguments */
   * See if we have lookup table values on the command-line...
   */
 
-  if (argc > 1)
+  nlutvals = 0;
+  mode     = -1;
+
+  for (x = 1; x < argc; x ++)
+    if (!strcmp(argv[x], "-m"))
+      mode = CUPS_DITHER_DIFFUSE;
+    else if (!strcmp(argv[x], "-o"))
+      mode = CUPS_DITHER_ORDERED;
+    else
+      break;
+
+  if (x < argc)
   {
    /*
     * Yes, collect them...
     */
 
-    nlutvals = 0;
-
-    for (x = 1; x < argc; x ++)
+    for (; x < argc; x ++)
       if (isdigit(argv[x][0]) && nlutvals < 16)
       {
         pixvals[nlutvals] = atoi(argv[x]);
@@ -107,8 +124,11 @@ main(int  argc,			/* I - Number of command-line arguments */
   * Create the lookup table and dither state...
   */
 
-  lut    = cupsLutNew(nlutvals, lutvals);
-  dither = cupsDitherNew(512);
+  lut          = cupsLutNew(nlutvals, lutvals);
+  dither       = cupsDitherNew(512);
+  mdither      = mode < 0 ? NULL :
+                 cupsDitherMultiNew(512, 1, (cups_dither_mode_t)mode);
+  pixplanes[0] = pixels;
 
  /*
   * Put out the PGM header for a raw 256x256x8-bit grayscale file...
@@ -133,7 +153,10 @@ main(int  argc,			/* I - Number of command-line arguments */
     * Dither the line...
     */
 
-    cupsDitherLine(dither, lut, line, 1, pixels);
+    if (mdither)
+      cupsDitherMultiLine(mdither, &lut, line, pixplanes);
+    else
+      cupsDitherLine(dither, lut, line, 1, pixels);
 
     if (y == 0)
     {
@@ -163,6 +186,7 @@ main(int  argc,			/* I - Number of command-line arguments */
   */
 
   cupsDitherDelete(dither);
+  cupsDitherMultiDelete(mdither);
   cupsLutDelete(lut);
 
  /*
@@ -180,7 +204,7 @@ main(int  argc,			/* I - Number of command-line arguments */
 void
 usage(void)
 {
-  puts("Usage: testdither [val1 val2 [... val16]] >filename.ppm");
+  puts("Usage: testdither [-m] [-o] [val1 val2 [... val16]] >filename.ppm");
   exit(1);
 }
 
@@ -0,0 +1,304 @@
+/*
+ *   Baked color separation test program for CUPS.
+ *
+ *   Try the following:
+ *
+ *       testgrid
+ *       testgrid 1000
+ *
+ *   Without arguments the baked separations are checked against the direct
+ *   ones; a number of rounds also times them.
+ *
+ *   This file is licensed as noted in "COPYING"
+ *   which should have been included with this file.
+ *
+ * Contents:
+ *
+ *   main()      - Check and time the baked separations.
+ *   check_rgb() - Compare a baked RGB separation with the direct one.
+ *   make_line() - Generate a line of sRGB pixels.
+ *   mpixels()   - Compute the speed of timed lines.
+ *   rgb_bake()  - Separate grid nodes for baking, as cupsRGBLoad() does.
+ */
+
+/*
+ * Include necessary headers.
+ */
+
+#include "driver-private.h"
+#include <string.h>
+#include <time.h>
+
+
+/*
+ * Constants...
+ */
+
+#define WIDTH		5100		/* 8.5" at 600dpi */
+#define GRID_SIZE	18		/* Grid size with exact nodes */
+#define MAX_AVERAGE	2.0		/* Maximum average difference */
+#define MAX_DIFF	24		/* Maximum difference of one channel */
+
+
+/*
+ * Local functions...
+ */
+
+static int	check_rgb(int num_channels, int rounds);
+static void	make_line(unsigned char *pixels, int width, int photo,
+		          unsigned *state);
+static double	mpixels(clock_t start, int rounds);
+static void	rgb_bake(void *data, const unsigned char *input,
+		         unsigned char *output, int num_pixels);
+
+
+/*
+ * 'main()' - Check and time the baked separations.
+ */
+
+int					/* O - Exit status */
+main(int  argc,				/* I - Number of command-line arguments */
+     char *argv[])			/* I - Command-line arguments */
+{
+  int	errors = 0;			/* Number of errors */
+  int	rounds;				/* Number of rounds to time */
+
+
+  rounds = argc > 1 ? atoi(argv[1]) : 0;
+
+  errors += check_rgb(1, rounds);
+  errors += check_rgb(3, rounds);
+  errors += check_rgb(4, rounds);
+
+  printf("%d errors\n", errors);
+
+  return (errors ? 1 : 0);
+}
+
+
+/*
+ * 'check_rgb()' - Compare a baked RGB separation with the direct one.
+ */
+
+static int				/* O - Number of errors */
+check_rgb(int num_channels,		/* I - Number of color components */
+          int rounds)			/* I - Number of rounds to time */
+{
+  static unsigned char	input[WIDTH * 3],
+					/* Input pixels */
+			direct[WIDTH * CUPS_MAX_RGB],
+					/* Direct separation */
+			baked[WIDTH * CUPS_MAX_RGB + 1];
+					/* Baked separation */
+  cups_sample_t		samples[5 * 5 * 5];
+					/* Profile samples */
+  cups_rgb_t		*rgbptr;	/* Color separation */
+  _cups_grid_t		*grid;		/* Baked separation */
+  const unsigned char	*pixel;		/* Input pixel of a channel */
+  int			i, r, g, b,	/* Looping vars */
+			k,		/* Black */
+			diff,		/* Difference of a channel */
+			maxdiff = 0,	/* Maximum difference */
+			maxmixed = 0,	/* Maximum with mixed weights */
+			errors = 0;	/* Number of errors */
+  double		sumdiff = 0.0;	/* Sum of differences */
+  unsigned		state = 1;	/* Random state */
+  clock_t		start;		/* Start time */
+
+
+ /*
+  * Make a 5x5x5 CMYK profile with a little color correction; fewer
+  * channels use the first ones...
+  */
+
+  for (i = 0, r = 0; r < 5; r ++)
+    for (g = 0; g < 5; g ++)
+      for (b = 0; b < 5; b ++, i ++)
+      {
+        samples[i].rgb[0] = r * 255 / 4;
+        samples[i].rgb[1] = g * 255 / 4;
+        samples[i].rgb[2] = b * 255 / 4;
+
+        k = 255 - (r > g ? (r > b ? r : b) : (g > b ? g : b)) * 255 / 4;
+
+        samples[i].colors[0] = (255 - r * 255 / 4 - k) * 9 / 10 + g * 5;
+        samples[i].colors[1] = (255 - g * 255 / 4 - k) * 9 / 10;
+        samples[i].colors[2] = (255 - b * 255 / 4 - k) * 9 / 10 + r * 5;
+        samples[i].colors[3] = k;
+      }
+
+  rgbptr = cupsRGBNew(5 * 5 * 5, samples, 5, num_channels);
+  grid   = _cupsGridNew(GRID_SIZE, num_channels, rgb_bake, rgbptr);
+
+ /*
+  * Node colors must match exactly...
+  */
+
+  for (r = 0; r < GRID_SIZE; r ++)
+    for (g = 0; g < GRID_SIZE; g ++)
+    {
+      for (b = 0; b < GRID_SIZE; b ++)
+      {
+        input[b * 3 + 0] = r * 255 / (GRID_SIZE - 1);
+        input[b * 3 + 1] = g * 255 / (GRID_SIZE - 1);
+        input[b * 3 + 2] = b * 255 / (GRID_SIZE - 1);
+      }
+
+      rgbptr->grid = NULL;
+      cupsRGBDoRGB(rgbptr, input, direct, GRID_SIZE);
+      rgbptr->grid = grid;
+      cupsRGBDoRGB(rgbptr, input, baked, GRID_SIZE);
+
+      if (memcmp(direct, baked, GRID_SIZE * num_channels))
+      {
+        printf("rgb %d: node %d,%d fails\n", num_channels, r, g);
+	errors ++;
+      }
+    }
+
+ /*
+  * Other colors must be close, and whole nodes stored at once must not
+  * spill past the end.  The direct separation weights one green/blue edge
+  * of the cube with the green multiplier instead of the blue one, so only
+  * pixels with the same green and blue multipliers bound the maximum
+  * difference...
+  */
+
+  for (i = 0; i < 20; i ++)
+  {
+    make_line(input, WIDTH, i & 1, &state);
+
+    rgbptr->grid = NULL;
+    cupsRGBDoRGB(rgbptr, input, direct, WIDTH);
+
+    rgbptr->grid = grid;
+    baked[WIDTH * num_channels] = 0x5a;
+    cupsRGBDoRGB(rgbptr, input, baked, WIDTH);
+
+    if (baked[WIDTH * num_channels] != 0x5a)
+    {
+      printf("rgb %d: output overflow\n", num_channels);
+      errors ++;
+    }
+
+    for (r = 0; r < WIDTH * num_channels; r ++)
+    {
+      diff    = abs(direct[r] - baked[r]);
+      sumdiff += diff;
+      pixel   = input + r / num_channels * 3;
+
+      if (rgbptr->cube_mult[cups_srgb_lut[pixel[1]]] !=
+              rgbptr->cube_mult[cups_srgb_lut[pixel[2]]])
+      {
+        if (diff > maxmixed)
+	  maxmixed = diff;
+      }
+      else if (diff > maxdiff)
+        maxdiff = diff;
+    }
+  }
+
+  sumdiff /= 20.0 * WIDTH * num_channels;
+
+  printf("rgb %d: average difference %.2f, maximum %d (%d with mixed "
+         "weights)\n", num_channels, sumdiff, maxdiff, maxmixed);
+
+  if (sumdiff > MAX_AVERAGE || maxdiff > MAX_DIFF)
+  {
+    puts("    too far from the direct separation");
+    errors ++;
+  }
+
+  if (rounds > 0)
+  {
+    make_line(input, WIDTH, 1, &state);
+
+    rgbptr->grid = NULL;
+    start        = clock();
+    for (i = 0; i < rounds; i ++)
+      cupsRGBDoRGB(rgbptr, input, direct, WIDTH);
+    printf("    direct %.1f, ", mpixels(start, rounds));
+
+    rgbptr->grid = grid;
+    start        = clock();
+    for (i = 0; i < rounds; i ++)
+      cupsRGBDoRGB(rgbptr, input, baked, WIDTH);
+    printf("baked %.1f Mpixels/s\n", mpixels(start, rounds));
+  }
+
+  cupsRGBDelete(rgbptr);
+
+  return (errors);
+}
+
+
+/*
+ * 'make_line()' - Generate a line of sRGB pixels.
+ *
+ * Photos are noisy gradients, other lines are runs of random colors as in
+ * text and graphics...
+ */
+
+static void
+make_line(unsigned char *pixels,	/* O - Pixels */
+          int           width,		/* I - Number of pixels */
+	  int           photo,		/* I - Photo? */
+	  unsigned      *state)		/* IO - Random state */
+{
+  int		x;			/* Current pixel */
+  unsigned char	rgb[3] = { 0, 0, 0 };	/* Current color */
+
+
+  for (x = 0; x < width; x ++, pixels += 3)
+  {
+    *state = *state * 1103515245 + 12345;
+
+    if (photo)
+    {
+      rgb[0] = (x * 255 / width + (*state >> 28)) & 255;
+      rgb[1] = (x * 511 / width + (*state >> 24)) & 255;
+      rgb[2] = ((*state >> 8) & 63) + 96;
+    }
+    else if (((*state >> 16) & 15) == 0)
+    {
+      rgb[0] = *state >> 24;
+      rgb[1] = *state >> 16;
+      rgb[2] = *state >> 8;
+    }
+
+    pixels[0] = rgb[0];
+    pixels[1] = rgb[1];
+    pixels[2] = rgb[2];
+  }
+}
+
+
+/*
+ * 'mpixels()' - Compute the speed of timed lines.
+ */
+
+static double				/* O - Megapixels per second */
+mpixels(clock_t start,			/* I - Start time */
+        int     rounds)			/* I - Number of lines */
+{
+  double	secs;			/* Elapsed time */
+
+
+  secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  return (secs > 0.0 ? (double)WIDTH * rounds / secs / 1e6 : 0.0);
+}
+
+
+/*
+ * 'rgb_bake()' - Separate grid nodes for baking, as cupsRGBLoad() does.
+ */
+
+static void
+rgb_bake(void                *data,	/* I - Color separation */
+         const unsigned char *input,	/* I - Input RGB pixels */
+	 unsigned char       *output,	/* O - Output Device-N pixels */
+	 int                 num_pixels)/* I - Number of pixels */
+{
+  cupsRGBDoRGB((cups_rgb_t *)data, input, output, num_pixels);
+}
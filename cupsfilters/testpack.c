@@ -0,0 +1,379 @@
+/*
+ *   Byte checking and bit packing test program for CUPS.
+ *
+ *   Try the following:
+ *
+ *       testpack
+ *       testpack 1000
+ *
+ *   Without arguments the routines are checked against simple reference
+ *   versions; a number of rounds also times them at typical line widths.
+ *
+ *   This file is licensed as noted in "COPYING"
+ *   which should have been included with this file.
+ *
+ * Contents:
+ *
+ *   main()          - Check and time the routines.
+ *   check_all()     - Compare the routines with the reference versions.
+ *   make_line()     - Generate a line of dithered pixels.
+ *   ref_check()     - Reference for cupsCheckValue().
+ *   ref_pack()      - Reference for cupsPackHorizontal[Bit]().
+ *   ref_vertical()  - Reference for cupsPackVertical().
+ *   time_all()      - Time the routines with the reference versions.
+ */
+
+/*
+ * Include necessary headers.
+ */
+
+#include "driver.h"
+#include <string.h>
+
+
+/*
+ * Constants...
+ */
+
+#define MAX_WIDTH	20400		/* 34" at 600dpi */
+#define MAX_STEP	4		/* Maximum step value */
+
+
+/*
+ * Local functions...
+ */
+
+static int	check_all(void);
+static void	make_line(unsigned char *pixels, int width, int density,
+		          unsigned *state);
+static int	ref_check(const unsigned char *bytes, int length,
+		          unsigned char value);
+static void	ref_pack(const unsigned char *ipixels, unsigned char *obytes,
+		         int width, unsigned char clearto, unsigned char bit,
+			 int step);
+static void	ref_vertical(const unsigned char *ipixels,
+		             unsigned char *obytes, int width,
+			     unsigned char bit, int step);
+static void	time_all(int rounds);
+
+
+/*
+ * 'main()' - Check and time the routines.
+ */
+
+int					/* O - Exit status */
+main(int  argc,				/* I - Number of command-line arguments */
+     char *argv[])			/* I - Command-line arguments */
+{
+  int	errors;				/* Number of errors */
+
+
+  errors = check_all();
+
+  printf("%d errors\n", errors);
+
+  if (argc > 1)
+    time_all(atoi(argv[1]));
+
+  return (errors ? 1 : 0);
+}
+
+
+/*
+ * 'check_all()' - Compare the routines with the reference versions.
+ */
+
+static int				/* O - Number of errors */
+check_all(void)
+{
+  static unsigned char	pixels[MAX_STEP * 300 + 64],
+					/* Input pixels */
+			obytes[MAX_STEP * 300 + 64],
+					/* Output bytes */
+			rbytes[MAX_STEP * 300 + 64];
+					/* Reference output bytes */
+  int			width,		/* Number of pixels */
+			offset,		/* Alignment of data */
+			density,	/* Percentage of set pixels */
+			step,		/* Step value */
+			errors = 0;	/* Number of errors */
+  unsigned		state = 1;	/* Random state */
+  unsigned char		value,		/* Value to check */
+			bit;		/* Bit to pack */
+
+
+  for (width = 0; width < 300; width ++)
+    for (offset = 0; offset < 8; offset ++)
+      for (density = 0; density <= 100; density += 25)
+      {
+        unsigned char *ipixels = pixels + offset;
+
+	make_line(ipixels, width * MAX_STEP, density, &state);
+
+       /*
+        * Checks, with a single differing byte at a random place...
+	*/
+
+        for (value = 0; value < 2; value ++)
+	{
+	  memset(ipixels, value ? 0xff : 0, width);
+	  if (density && width)
+	    ipixels[state % width] = 0x10;
+
+	  if (cupsCheckValue(ipixels, width, value ? 0xff : 0) !=
+	          ref_check(ipixels, width, value ? 0xff : 0) ||
+	      (!value && cupsCheckBytes(ipixels, width) !=
+	                     ref_check(ipixels, width, 0)))
+	  {
+	    printf("cupsCheckValue: width %d, offset %d, density %d fail\n",
+	           width, offset, density);
+	    errors ++;
+	  }
+	}
+
+	make_line(ipixels, width * MAX_STEP, density, &state);
+
+       /*
+        * Horizontal packing...
+	*/
+
+        for (step = 1; step <= MAX_STEP; step ++)
+	{
+	  memset(obytes, 0x5a, sizeof(obytes));
+	  memset(rbytes, 0x5a, sizeof(rbytes));
+
+	  cupsPackHorizontal(ipixels, obytes, width, step & 1 ? 0 : 0xff,
+	                     step);
+	  ref_pack(ipixels, rbytes, width, step & 1 ? 0 : 0xff, 0xff, step);
+
+	  if (memcmp(obytes, rbytes, sizeof(obytes)))
+	  {
+	    printf("cupsPackHorizontal: width %d, offset %d, density %d, "
+	           "step %d fail\n", width, offset, density, step);
+	    errors ++;
+	  }
+	}
+
+        for (bit = 1; bit; bit <<= 1)
+	{
+	  memset(obytes, 0x5a, sizeof(obytes));
+	  memset(rbytes, 0x5a, sizeof(rbytes));
+
+	  cupsPackHorizontalBit(ipixels, obytes, width, bit & 0x55 ? 0 : 0xff,
+	                        bit);
+	  ref_pack(ipixels, rbytes, width, bit & 0x55 ? 0 : 0xff, bit, 1);
+
+	  if (memcmp(obytes, rbytes, sizeof(obytes)))
+	  {
+	    printf("cupsPackHorizontalBit: width %d, offset %d, density %d, "
+	           "bit %02x fail\n", width, offset, density, bit);
+	    errors ++;
+	  }
+	}
+
+       /*
+        * Vertical packing...
+	*/
+
+        for (step = 1; step <= MAX_STEP; step ++)
+	{
+	  memset(obytes, 0x5a, sizeof(obytes));
+	  memset(rbytes, 0x5a, sizeof(rbytes));
+
+	  cupsPackVertical(ipixels, obytes, width, 0x20, step);
+	  ref_vertical(ipixels, rbytes, width, 0x20, step);
+
+	  if (memcmp(obytes, rbytes, sizeof(obytes)))
+	  {
+	    printf("cupsPackVertical: width %d, offset %d, density %d, "
+	           "step %d fail\n", width, offset, density, step);
+	    errors ++;
+	  }
+	}
+      }
+
+  return (errors);
+}
+
+
+/*
+ * 'make_line()' - Generate a line of dithered pixels.
+ *
+ * Pixels come in runs, as text and halftones do...
+ */
+
+static void
+make_line(unsigned char *pixels,	/* O - Pixels */
+          int           width,		/* I - Number of pixels */
+	  int           density,	/* I - Percentage of set pixels */
+	  unsigned      *state)		/* IO - Random state */
+{
+  int		x;			/* Current pixel */
+  unsigned char	value = 0;		/* Current value */
+
+
+  for (x = 0; x < width; x ++)
+  {
+    *state = *state * 1103515245 + 12345;
+
+    if (((*state >> 16) & 7) == 0)
+      value = (int)((*state >> 20) % 100) < density ?
+                  (*state >> 8) & 0xff : 0;
+
+    pixels[x] = value;
+  }
+}
+
+
+/*
+ * 'ref_check()' - Reference for cupsCheckValue().
+ */
+
+static int				/* O - 1 if they match */
+ref_check(const unsigned char *bytes,	/* I - Bytes to check */
+          int                 length,	/* I - Number of bytes */
+	  unsigned char       value)	/* I - Value to check */
+{
+  while (length -- > 0)
+    if (*bytes++ != value)
+      return (0);
+
+  return (1);
+}
+
+
+/*
+ * 'ref_pack()' - Reference for cupsPackHorizontal[Bit]().
+ */
+
+static void
+ref_pack(const unsigned char *ipixels,	/* I - Input pixels */
+         unsigned char       *obytes,	/* O - Output bytes */
+	 int                 width,	/* I - Number of pixels */
+	 unsigned char       clearto,	/* I - Initial value of bytes */
+	 unsigned char       bit,	/* I - Bits to check */
+	 int                 step)	/* I - Step value between pixels */
+{
+  int	x;				/* Current pixel */
+
+
+  for (x = 0; x < width; x ++)
+  {
+    if (!(x & 7))
+      obytes[x / 8] = clearto;
+
+    if (ipixels[x * step] & bit)
+      obytes[x / 8] ^= 0x80 >> (x & 7);
+  }
+}
+
+
+/*
+ * 'ref_vertical()' - Reference for cupsPackVertical().
+ */
+
+static void
+ref_vertical(const unsigned char *ipixels,
+					/* I - Input pixels */
+             unsigned char       *obytes,
+					/* O - Output bytes */
+	     int                 width,	/* I - Number of pixels */
+	     unsigned char       bit,	/* I - Output bit */
+	     int                 step)	/* I - Bytes between columns */
+{
+  int	x;				/* Current pixel */
+
+
+  for (x = 0; x < width; x ++)
+    if (ipixels[x])
+      obytes[x * step] ^= bit;
+}
+
+
+/*
+ * 'time_all()' - Time the routines with the reference versions.
+ */
+
+static void
+time_all(int rounds)			/* I - Number of rounds */
+{
+  static const int widths[] =		/* Typical widths in pixels */
+  {
+    2550,				/* 8.5" at 300dpi */
+    5100,				/* 8.5" at 600dpi */
+    10200,				/* 8.5" at 1200dpi */
+    MAX_WIDTH				/* 34" at 600dpi */
+  };
+  static unsigned char	pixels[MAX_WIDTH],
+					/* Input pixels */
+			obytes[MAX_WIDTH];
+					/* Output bytes */
+  int			i,		/* Looping var */
+			round,		/* Current round */
+			width,		/* Number of pixels */
+			sum = 0;	/* Sum of checks */
+  unsigned		state = 1;	/* Random state */
+  clock_t		start;		/* Start time */
+  double		secs[6];	/* Time for each routine */
+
+
+  if (rounds < 1)
+    rounds = 1;
+
+  puts("width  check    ref      pack     ref      vertical ref  "
+       "(Mpixels/s)");
+
+  for (i = 0; i < (int)(sizeof(widths) / sizeof(widths[0])); i ++)
+  {
+    width = widths[i];
+
+   /*
+    * Blank lines for the checks (the common case), a half-set line for
+    * packing...
+    */
+
+    memset(pixels, 0, width);
+
+    start = clock();
+    for (round = 0; round < rounds; round ++)
+      sum += cupsCheckBytes(pixels, width);
+    secs[0] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (round = 0; round < rounds; round ++)
+      sum += ref_check(pixels, width, 0);
+    secs[1] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    make_line(pixels, width, 50, &state);
+
+    start = clock();
+    for (round = 0; round < rounds; round ++)
+      cupsPackHorizontal(pixels, obytes, width, 0, 1);
+    secs[2] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (round = 0; round < rounds; round ++)
+      ref_pack(pixels, obytes, width, 0, 0xff, 1);
+    secs[3] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (round = 0; round < rounds; round ++)
+      cupsPackVertical(pixels, obytes, width / 8, 0x80, 8);
+    secs[4] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (round = 0; round < rounds; round ++)
+      ref_vertical(pixels, obytes, width / 8, 0x80, 8);
+    secs[5] = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%-6d", width);
+    for (round = 0; round < 6; round ++)
+      printf(" %-8.0f", secs[round] > 0.0 ?
+                           (double)width * rounds / secs[round] /
+			       (round < 4 ? 1e6 : 8e6) : 0.0);
+    putchar('\n');
+  }
+
+  if (sum == -1)
+    puts("");				/* Keep the checks */
+}
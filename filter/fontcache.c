@@ -0,0 +1,401 @@
+/*
+ *   Font lookup cache for texttopdf.
+ *
+ *   This file is licensed as noted in "COPYING"
+ *   which should have been included with this file.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <fontconfig/fontconfig.h>
+#include "fontcache.h"
+
+/* File format, one line per entry (fields separated by tabs):
+ *   fontwidth  font  fontname  font_mtime  dir_mtime  resolved_at
+ * preceded by the header line
+ *   FONTCACHE_MAGIC  config_stamp  config_id
+ */
+#define FONTCACHE_MAGIC  "texttopdf-fontcache-2"
+#define FONTCACHE_FILE   "texttopdf-fonts.cache"
+
+typedef struct {
+  int fontwidth;
+  char *font,*fontname;
+  long font_mtime,dir_mtime,resolved;
+} FONTCACHE_ENTRY;
+
+static int loaded=0,dirty=0;
+static long config_stamp;
+static char *config_id;
+static int num_entries,alloc_entries;
+static FONTCACHE_ENTRY *entries;
+
+static char *cache_filename(void) // {{{
+{
+  const char *dir=getenv("CUPS_CACHEDIR");
+  if ( (!dir)||(!*dir)||(access(dir,W_OK)!=0) ) {
+    dir=getenv("TMPDIR");
+    if ( (!dir)||(!*dir) ) {
+      dir="/tmp";
+    }
+  }
+  char *ret=malloc(strlen(dir)+strlen(FONTCACHE_FILE)+2);
+  if (ret) {
+    sprintf(ret,"%s/%s",dir,FONTCACHE_FILE);
+  }
+  return ret;
+}
+// }}}
+
+static long mtime_of(const char *path) // {{{  -1 on error
+{
+  struct stat st;
+  if (stat(path,&st)!=0) {
+    return -1;
+  }
+  return (long)st.st_mtime;
+}
+// }}}
+
+// fontconfig's configuration file and its conf.d; FcConfigFilename() does
+// not need FcInit()
+static long get_config_stamp(void) // {{{
+{
+  FcChar8 *conf=FcConfigFilename(NULL);
+  if (!conf) {
+    return -1;
+  }
+  long ret=mtime_of((const char *)conf);
+  char *slash=strrchr((char *)conf,'/');
+  if (slash) {
+    char *confd=malloc(slash-(char *)conf+sizeof("/conf.d"));
+    if (confd) {
+      sprintf(confd,"%.*s/conf.d",(int)(slash-(char *)conf),(char *)conf);
+      const long tmp=mtime_of(confd);
+      if (tmp>ret) {
+        ret=tmp;
+      }
+      free(confd);
+    }
+  }
+  FcStrFree(conf);
+  return ret;
+}
+// }}}
+
+// what else the matching depends on: the default languages, which
+// FcDefaultSubstitute() adds from the locale, and which configuration
+// file is used (e.g. FONTCONFIG_FILE); "langs\tconfig file"
+static char *get_config_id(void) // {{{  NULL on error
+{
+  FcChar8 *conf=FcConfigFilename(NULL);
+  FcStrSet *langs=FcGetDefaultLangs();
+  FcStrList *list=(langs)?FcStrListCreate(langs):NULL;
+  if (langs) {
+    FcStrSetDestroy(langs);
+  }
+  if ( (!conf)||(!list) ) {
+    if (conf) {
+      FcStrFree(conf);
+    }
+    if (list) {
+      FcStrListDone(list);
+    }
+    return NULL;
+  }
+
+  size_t len=strlen((const char *)conf)+2;
+  char *ret=malloc(len);
+  if (ret) {
+    *ret=0;
+    FcChar8 *lang;
+    while ((lang=FcStrListNext(list))!=NULL) {
+      len+=strlen((const char *)lang)+1;
+      char *tmp=realloc(ret,len);
+      if (!tmp) {
+        free(ret);
+        ret=NULL;
+        break;
+      }
+      ret=tmp;
+      if (*ret) {
+        strcat(ret,":");
+      }
+      strcat(ret,(const char *)lang);
+    }
+  }
+  if (ret) {
+    strcat(ret,"\t");
+    strcat(ret,(const char *)conf);
+    if (strchr(ret,'\n')) { // would break the header line
+      free(ret);
+      ret=NULL;
+    }
+  }
+  FcStrListDone(list);
+  FcStrFree(conf);
+  return ret;
+}
+// }}}
+
+// the file itself, or - for TTC subfonts ("file/index") - its collection file
+static long font_mtime(const char *fontname,long *dir_mtime) // {{{
+{
+  char *path=strdup(fontname);
+  if (!path) {
+    return -1;
+  }
+  long ret=mtime_of(path);
+  char *slash=strrchr(path,'/');
+  if ( (ret==-1)&&(slash) ) {
+    char *end;
+    strtoul(slash+1,&end,10);
+    if ( (slash[1])&&(!*end) ) {
+      *slash=0;
+      ret=mtime_of(path);
+      slash=strrchr(path,'/');
+    }
+  }
+  *dir_mtime=-1;
+  if ( (ret!=-1)&&(slash) ) {
+    *slash=0;
+    *dir_mtime=mtime_of((*path)?path:"/");
+  }
+  free(path);
+  return ret;
+}
+// }}}
+
+static void free_entry(FONTCACHE_ENTRY *entry) // {{{
+{
+  free(entry->font);
+  free(entry->fontname);
+}
+// }}}
+
+static FONTCACHE_ENTRY *add_entry(void) // {{{
+{
+  if (num_entries>=alloc_entries) {
+    const int new_alloc=alloc_entries+16;
+    FONTCACHE_ENTRY *tmp=realloc(entries,new_alloc*sizeof(FONTCACHE_ENTRY));
+    if (!tmp) {
+      return NULL;
+    }
+    entries=tmp;
+    alloc_entries=new_alloc;
+  }
+  return &entries[num_entries++];
+}
+// }}}
+
+static void load_cache(void) // {{{
+{
+  loaded=1;
+  config_stamp=get_config_stamp();
+  config_id=get_config_id();
+  if (!config_id) {
+    config_stamp=-1;
+  }
+
+  char *filename=cache_filename();
+  if (!filename) {
+    return;
+  }
+  // the cache may be in a shared directory like /tmp: only trust our own,
+  // not through a symlink, and not writable by others
+  const int fd=open(filename,O_RDONLY|O_NOFOLLOW);
+  free(filename);
+  if (fd==-1) {
+    return;
+  }
+  struct stat st;
+  FILE *f=NULL;
+  if ( (fstat(fd,&st)!=0)||(!S_ISREG(st.st_mode))||
+       (st.st_uid!=getuid())||(st.st_mode&(S_IWGRP|S_IWOTH))||
+       (!(f=fdopen(fd,"r"))) ) {
+    close(fd);
+    dirty=1; // replace it with our own
+    return;
+  }
+
+  char line[2048],*id=NULL;
+  long stamp;
+  if ( (!fgets(line,sizeof(line),f))||
+       (strncmp(line,FONTCACHE_MAGIC "\t",sizeof(FONTCACHE_MAGIC))!=0)||
+       (sscanf(line+sizeof(FONTCACHE_MAGIC),"%ld",&stamp)!=1)||
+       (stamp!=config_stamp)||
+       (!(id=strchr(line+sizeof(FONTCACHE_MAGIC),'\t')))||
+       (strcspn(++id,"\n")!=strlen(config_id))||
+       (strncmp(id,config_id,strlen(config_id))!=0) ) {
+    fclose(f);
+    dirty=1; // rewrite
+    return;
+  }
+  while (fgets(line,sizeof(line),f)) {
+    char *font=strchr(line,'\t'),*fontname=NULL,*rest=NULL;
+    if (font) {
+      *font++=0;
+      fontname=strchr(font,'\t');
+    }
+    if (fontname) {
+      *fontname++=0;
+      rest=strchr(fontname,'\t');
+    }
+    FONTCACHE_ENTRY entry;
+    if ( (!rest)||
+         (sscanf(line,"%d",&entry.fontwidth)!=1)||
+         (sscanf(rest,"%ld %ld %ld",&entry.font_mtime,&entry.dir_mtime,&entry.resolved)!=3) ) {
+      dirty=1; // drop bad lines
+      continue;
+    }
+    *rest=0;
+    FONTCACHE_ENTRY *ne=add_entry();
+    if (!ne) {
+      break;
+    }
+    entry.font=strdup(font);
+    entry.fontname=strdup(fontname);
+    *ne=entry;
+    if ( (!ne->font)||(!ne->fontname) ) {
+      free_entry(ne);
+      num_entries--;
+    }
+  }
+  fclose(f);
+}
+// }}}
+
+static FONTCACHE_ENTRY *find_entry(const char *font,int fontwidth) // {{{
+{
+  int iA;
+  for (iA=0;iA<num_entries;iA++) {
+    if ( (entries[iA].fontwidth==fontwidth)&&(strcmp(entries[iA].font,font)==0) ) {
+      return &entries[iA];
+    }
+  }
+  return NULL;
+}
+// }}}
+
+static void remove_entry(FONTCACHE_ENTRY *entry) // {{{
+{
+  free_entry(entry);
+  *entry=entries[--num_entries];
+  dirty=1;
+}
+// }}}
+
+char *fontcache_lookup(const char *font,int fontwidth) // {{{
+{
+  if (!loaded) {
+    load_cache();
+  }
+  if (config_stamp==-1) {
+    return NULL;
+  }
+  FONTCACHE_ENTRY *entry=find_entry(font,fontwidth);
+  if (!entry) {
+    return NULL;
+  }
+
+  long dir_mtime;
+  const long now=time(NULL);
+  if ( (entry->resolved>now)||(now-entry->resolved>FONTCACHE_MAX_AGE)||
+       (font_mtime(entry->fontname,&dir_mtime)!=entry->font_mtime)||
+       (dir_mtime!=entry->dir_mtime) ) {
+    remove_entry(entry);
+    return NULL;
+  }
+  return strdup(entry->fontname);
+}
+// }}}
+
+void fontcache_store(const char *font,int fontwidth,const char *fontname) // {{{
+{
+  if (!loaded) {
+    load_cache();
+  }
+  if ( (config_stamp==-1)||
+       (strpbrk(font,"\t\n"))||(strpbrk(fontname,"\t\n")) ) {
+    return;
+  }
+
+  FONTCACHE_ENTRY entry;
+  entry.fontwidth=fontwidth;
+  entry.font_mtime=font_mtime(fontname,&entry.dir_mtime);
+  entry.resolved=time(NULL);
+  if (entry.font_mtime==-1) {
+    return;
+  }
+
+  FONTCACHE_ENTRY *old=find_entry(font,fontwidth);
+  if (old) {
+    remove_entry(old);
+  }
+  entry.font=strdup(font);
+  entry.fontname=strdup(fontname);
+  FONTCACHE_ENTRY *ne=NULL;
+  if ( (entry.font)&&(entry.fontname) ) {
+    ne=add_entry();
+  }
+  if (!ne) {
+    free_entry(&entry);
+    return;
+  }
+  *ne=entry;
+  dirty=1;
+}
+// }}}
+
+void fontcache_flush(void) // {{{
+{
+  if ( (!dirty)||(config_stamp==-1) ) {
+    return;
+  }
+  dirty=0;
+
+  char *filename=cache_filename();
+  if (!filename) {
+    return;
+  }
+  // concurrent jobs: write a private copy, then atomically replace
+  char *tmpname=malloc(strlen(filename)+sizeof(".XXXXXX"));
+  if (!tmpname) {
+    free(filename);
+    return;
+  }
+  sprintf(tmpname,"%s.XXXXXX",filename);
+  const int fd=mkstemp(tmpname);
+  FILE *f=(fd!=-1)?fdopen(fd,"w"):NULL;
+  if (!f) {
+    fprintf(stderr,"DEBUG: Could not write font cache \"%s\": %s\n",tmpname,strerror(errno));
+    if (fd!=-1) {
+      close(fd);
+      unlink(tmpname);
+    }
+    free(tmpname);
+    free(filename);
+    return;
+  }
+
+  fprintf(f,FONTCACHE_MAGIC "\t%ld\t%s\n",config_stamp,config_id);
+  int iA;
+  for (iA=0;iA<num_entries;iA++) {
+    fprintf(f,"%d\t%s\t%s\t%ld %ld %ld\n",
+            entries[iA].fontwidth,entries[iA].font,entries[iA].fontname,
+            entries[iA].font_mtime,entries[iA].dir_mtime,entries[iA].resolved);
+  }
+  if ( (fclose(f)!=0)||(rename(tmpname,filename)!=0) ) {
+    fprintf(stderr,"DEBUG: Could not write font cache \"%s\": %s\n",filename,strerror(errno));
+    unlink(tmpname);
+  }
+  free(tmpname);
+  free(filename);
+}
+// }}}
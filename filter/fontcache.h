@@ -0,0 +1,28 @@
+/*
+ *   Font lookup cache for texttopdf.
+ *
+ *   This file is licensed as noted in "COPYING"
+ *   which should have been included with this file.
+ *
+ */
+#ifndef _FONTCACHE_H
+#define _FONTCACHE_H
+
+/* Remembers which font file fontconfig picked for a font name, so that
+ * following jobs can skip FcInit()/FcFontSort().
+ * The cache lives in CUPS_CACHEDIR (or TMPDIR); an entry is only used while
+ * the font file, its directory, the fontconfig configuration and the default
+ * languages are unchanged, and for at most FONTCACHE_MAX_AGE seconds (fonts
+ * installed elsewhere are picked up after that).
+ */
+#define FONTCACHE_MAX_AGE  (24*60*60)
+
+/* returns the cached font file name (to be free()d), or NULL */
+char *fontcache_lookup(const char *font,int fontwidth);
+
+void fontcache_store(const char *font,int fontwidth,const char *fontname);
+
+/* writes the cache back, if it was changed */
+void fontcache_flush(void);
+
+#endif
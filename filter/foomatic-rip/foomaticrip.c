@@ -29,6 +29,7 @@
 #include "process.h"
 #include "spooler.h"
 #include "renderer.h"
+#include "pool.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -198,6 +199,14 @@ void config_set_option(const char *key, const char *value)
         strlcpy(gspath, value, PATH_MAX);
     else if (strcmp(key, "echo") == 0)
         strlcpy(echopath, value, PATH_MAX);
+    else if (strcmp(key, "renderer_pool") == 0 && value)
+        strlcpy(renderer_pool, value, PATH_MAX);
+    /* Anything but a positive number keeps the default, a pool without a
+     * timeout would never stop */
+    else if (strcmp(key, "renderer_pool_size") == 0 && value && atoi(value) > 0)
+        renderer_pool_size = atoi(value);
+    else if (strcmp(key, "renderer_pool_timeout") == 0 && value && atoi(value) > 0)
+        renderer_pool_timeout = atoi(value);
 }
 
 int config_from_file(const char *filename)
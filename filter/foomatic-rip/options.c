@@ -80,6 +80,9 @@ char **qualifier = NULL;
 option_t *optionlist = NULL;
 option_t *optionlist_sorted_by_order = NULL;
 
+/* optionlist indexed by name, for find_option() */
+static hash_t *optionhash = NULL;
+
 int optionset_alloc, optionset_count;
 char **optionsets;
 
@@ -265,6 +268,7 @@ static void free_option(option_t *opt)
         opt->choicelist = opt->choicelist->next;
         free(choice);
     }
+    hash_free(opt->choicehash);
     while (opt->paramlist) {
         param = opt->paramlist;
         opt->paramlist = opt->paramlist->next;
@@ -309,6 +313,9 @@ void options_free()
         optionlist = optionlist->next;
         free_option(opt);
     }
+    optionlist_sorted_by_order = NULL;
+    hash_free(optionhash);
+    optionhash = NULL;
 
     if (postpipe)
         free_dstr(postpipe);
@@ -336,12 +343,13 @@ option_t * find_option(const char *name)
     if (!strcasecmp(name, "PageRegion"))
         return find_option("PageSize");
 
-    for (opt = optionlist; opt; opt = opt->next) {
-      if ((!strcasecmp(opt->name, name)) ||
-	  ((!strcasecmp(opt->name, &name[2])) &&
-	   (!prefixcasecmp(name, "no"))))
-            return opt;
-    }
+    if ((opt = hash_find(optionhash, name)))
+        return opt;
+
+    /* "noFoo" is boolean option "Foo" set to false */
+    if (!prefixcasecmp(name, "no"))
+        return hash_find(optionhash, &name[2]);
+
     return NULL;
 }
 
@@ -378,6 +386,10 @@ option_t * assure_option(const char *name)
     else
         optionlist = opt;
 
+    if (!optionhash)
+        optionhash = hash_create();
+    hash_insert(optionhash, opt->name, opt);
+
     /* prepend opt to optionlist_sorted_by_order
        (0 is always at the beginning) */
     if (optionlist_sorted_by_order) {
@@ -481,13 +493,8 @@ static param_t * option_find_param_index(option_t *opt, const char *name, int *i
 
 static choice_t * option_find_choice(option_t *opt, const char *name)
 {
-    choice_t *choice;
     assert(opt && name);
-    for (choice = opt->choicelist; choice; choice = choice->next) {
-        if (!strcasecmp(choice->value, name))
-            return choice;
-    }
-    return NULL;
+    return hash_find(opt->choicehash, name);
 }
 
 void free_paramvalues(option_t *opt, char **paramvalues)
@@ -1128,21 +1135,24 @@ void option_set_from_string(option_t *opt, const char *str)
 
 static choice_t * option_assure_choice(option_t *opt, const char *name)
 {
-    choice_t *choice, *last = NULL;
+    choice_t *choice, *last;
 
-    for (choice = opt->choicelist; choice; choice = choice->next) {
-        if (!strcasecmp(choice->value, name))
-            return choice;
-        last = choice;
-    }
-    if (!choice) {
-        choice = calloc(1, sizeof(choice_t));
-        if (last)
-            last->next = choice;
-        else
-            opt->choicelist = choice;
-        strlcpy(choice->value, name, 128);
+    if ((choice = option_find_choice(opt, name)))
+        return choice;
+
+    choice = calloc(1, sizeof(choice_t));
+    if (opt->choicelist) {
+        for (last = opt->choicelist; last->next; last = last->next);
+        last->next = choice;
     }
+    else
+        opt->choicelist = choice;
+    strlcpy(choice->value, name, 128);
+
+    if (!opt->choicehash)
+        opt->choicehash = hash_create();
+    hash_insert(opt->choicehash, choice->value, choice);
+
     return choice;
 }
 
@@ -89,6 +89,7 @@ typedef struct option_s {
     int notfirst;               /* TODO remove */
 
     choice_t *choicelist;
+    hash_t *choicehash;         /* choicelist indexed by value */
 
     /* Foomatic PPD extensions */
     char *proto;                /* *FoomaticRIPOptionPrototype: if this is set
@@ -0,0 +1,645 @@
+/* pool.c
+ *
+ * This file is part of foomatic-rip.
+ *
+ * Foomatic-rip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Foomatic-rip is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Renderer pool
+ *
+ * Starting the renderer (Ghostscript loading its initialization files and
+ * font maps, or a driver's own interpreter) takes a good part of the time
+ * of short jobs. With a renderer pool the renderer is started before the
+ * job arrives, so that this happens while the printer is idle or busy with
+ * the previous job.
+ *
+ * The pool for a renderer command line (and printer) is a daemon which is
+ * started by the first job. It listens on a Unix socket in the
+ * "renderer_pool" directory and keeps "renderer_pool_size" slot processes,
+ * each of which starts the renderer with pipes for its stdin, stdout and
+ * stderr and waits for a job. A job sends its stdin, stdout and stderr
+ * over the socket, the slot copies the job's data to the renderer and the
+ * renderer's output and messages back, and sends the renderer's exit
+ * status when it is done. Then the slot exits and the daemon starts a new
+ * one. After "renderer_pool_timeout" seconds without a job the daemon
+ * shuts down. As every job still gets a renderer of its own, the output
+ * is the same as without the pool.
+ *
+ * Only processes of the same user may talk to each other over the socket,
+ * and the directory must not be writable for others. The slot compares the
+ * command line of the job with its own before taking the job, the socket
+ * name is only a hash of it.
+ *
+ * If the pool cannot be used, the renderer is started directly.
+ */
+
+#include "foomaticrip.h"
+#include "pool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+char renderer_pool[PATH_MAX] = "";
+int renderer_pool_size = 1;
+int renderer_pool_timeout = 300;
+
+#define POOL_CONNECT_TRIES 50   /* 100 ms apart */
+#define POOL_MAX_FAILURES 3     /* renderers dying before getting a job */
+#define POOL_BUFSIZE 65536
+
+typedef struct {
+    int from;
+    int to;
+    size_t start;
+    size_t len;
+    char buf[POOL_BUFSIZE];
+} channel_t;
+
+static volatile sig_atomic_t terminated = 0;
+static volatile sig_atomic_t childexited = 0;
+static volatile sig_atomic_t timedout = 0;
+
+static void pool_signal(int sig)
+{
+    if (sig == SIGCHLD)
+        childexited = 1;
+    else if (sig == SIGALRM)
+        timedout = 1;
+    else
+        terminated = 1;
+}
+
+/* Socket or lock file name for the pool of the command line, the printer
+   and its PPD file are part of it as the renderer sees their environment */
+static int pool_path(char *path, size_t size, const char *cmdline, const char *ext)
+{
+    const char *parts[3];
+    const char *p;
+    unsigned long long hash = 14695981039346656037ULL;
+    int i;
+
+    parts[0] = cmdline;
+    parts[1] = getenv("PRINTER");
+    parts[2] = getenv("PPD");
+    for (i = 0; i < 3; i++) {
+        for (p = parts[i]; p && *p; p++) {
+            hash ^= (unsigned char)*p;
+            hash *= 1099511628211ULL;
+        }
+        hash ^= 0xff;
+        hash *= 1099511628211ULL;
+    }
+
+    return snprintf(path, size, "%s/%016llx.%s", renderer_pool, hash, ext) < (int)size;
+}
+
+/* Whether the process at the other end of the socket runs as our user */
+static int peer_is_user(int sock)
+{
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    return getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+        len == sizeof(cred) && cred.uid == getuid();
+#else
+    return 0;
+#endif
+}
+
+/* The pool directory must be ours and not writable for anybody else */
+static int pool_dir_ok()
+{
+    struct stat st;
+
+    return stat(renderer_pool, &st) == 0 && S_ISDIR(st.st_mode) &&
+        st.st_uid == getuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+static int read_all(int fd, char *buf, size_t len)
+{
+    ssize_t bytes;
+
+    while (len) {
+        bytes = read(fd, buf, len);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            return -1;
+        buf += bytes;
+        len -= bytes;
+    }
+    return 0;
+}
+
+/* Send stdin, stdout and stderr, with the length of the command line,
+   followed by the command line */
+static int send_fds(int sock, const char *cmdline)
+{
+    struct msghdr msg;
+    struct iovec iov[2];
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+    int fds[3] = { 0, 1, 2 };
+    size_t len = strlen(cmdline);
+
+    memset(&msg, 0, sizeof(msg));
+    iov[0].iov_base = &len;
+    iov[0].iov_len = sizeof(len);
+    iov[1].iov_base = (char *)cmdline;
+    iov[1].iov_len = len;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == (ssize_t)(sizeof(len) + len) ? 0 : -1;
+}
+
+/* Receive the job's stdin, stdout and stderr, if the job is for the
+   command line */
+static int receive_fds(int sock, int fds[3], const char *cmdline)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+    size_t len;
+    char *buf;
+    int same;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &len;
+    iov.iov_len = sizeof(len);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if (recvmsg(sock, &msg, 0) != sizeof(len))
+        return -1;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+            cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+        return -1;
+    memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+
+    same = len == strlen(cmdline) && (buf = malloc(len + 1)) != NULL;
+    if (same) {
+        same = read_all(sock, buf, len) == 0 && memcmp(buf, cmdline, len) == 0;
+        free(buf);
+    }
+    if (!same) {
+        close(fds[0]);
+        close(fds[1]);
+        close(fds[2]);
+        return -1;
+    }
+    return 0;
+}
+
+/* Start the renderer with pipes for stdin, stdout and stderr, in its own
+   process group as start_system_process() does */
+static pid_t start_renderer(const char *cmdline, int fds[3])
+{
+    int pfds[3][2];
+    sigset_t mask;
+    pid_t pid;
+    int i;
+
+    for (i = 0; i < 3; i++)
+        if (pipe(pfds[i]) < 0)
+            return -1;
+
+    pid = fork();
+    if (pid == 0) {
+        setpgid(0, 0);
+        dup2(pfds[0][0], 0);
+        dup2(pfds[1][1], 1);
+        dup2(pfds[2][1], 2);
+        for (i = 0; i < 3; i++) {
+            close(pfds[i][0]);
+            close(pfds[i][1]);
+        }
+
+        /* The pool daemon ignores these */
+        signal(SIGPIPE, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGHUP, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        sigemptyset(&mask);
+        sigprocmask(SIG_SETMASK, &mask, NULL);
+
+        execl(get_modern_shell(), get_modern_shell(), "-e", "-c", cmdline, (char *)NULL);
+        _exit(EXIT_PRNERR_NORETRY_BAD_SETTINGS);
+    }
+    if (pid > 0)
+        setpgid(pid, pid);
+
+    close(pfds[0][0]);
+    close(pfds[1][1]);
+    close(pfds[2][1]);
+    fds[0] = pfds[0][1];
+    fds[1] = pfds[1][0];
+    fds[2] = pfds[2][0];
+    return pid;
+}
+
+/* Copy the job's data to the renderer and the renderer's output and
+   messages to the job until the renderer has closed both. If the job's
+   output goes away, the renderer gets a SIGPIPE as it would when writing
+   there itself. */
+static void relay(channel_t *ch, pid_t renderer)
+{
+    struct pollfd pfds[3];
+    ssize_t bytes;
+    size_t len;
+    int i;
+
+    while (ch[1].from >= 0 || ch[1].len || ch[2].from >= 0 || ch[2].len) {
+        for (i = 0; i < 3; i++) {
+            pfds[i].fd = -1;
+            pfds[i].events = 0;
+            if (ch[i].len) {
+                pfds[i].fd = ch[i].to;
+                pfds[i].events = POLLOUT;
+            }
+            else if (ch[i].from >= 0) {
+                pfds[i].fd = ch[i].from;
+                pfds[i].events = POLLIN;
+            }
+        }
+
+        if (poll(pfds, 3, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (i = 0; i < 3; i++) {
+            if (!pfds[i].revents)
+                continue;
+
+            if (ch[i].len) {
+                /* The job's stderr is shared with foomatic-rip and stays
+                   blocking, so write no more than fits into a pipe */
+                len = ch[i].len;
+                if (i == 2 && len > PIPE_BUF)
+                    len = PIPE_BUF;
+                bytes = write(ch[i].to, ch[i].buf + ch[i].start, len);
+                if (bytes > 0) {
+                    ch[i].start += bytes;
+                    ch[i].len -= bytes;
+                }
+                else if (bytes < 0 && errno != EINTR && errno != EAGAIN) {
+                    close(ch[i].to);
+                    ch[i].to = -1;
+                    ch[i].len = 0;
+                    if (i == 0) {
+                        close(ch[0].from);
+                        ch[0].from = -1;
+                    }
+                    else if (i == 1)
+                        kill(-renderer, SIGPIPE);
+                }
+            }
+            else {
+                bytes = read(ch[i].from, ch[i].buf, POOL_BUFSIZE);
+                if (bytes > 0) {
+                    if (ch[i].to >= 0) {
+                        ch[i].start = 0;
+                        ch[i].len = bytes;
+                    }
+                }
+                else if (bytes == 0 || (errno != EINTR && errno != EAGAIN)) {
+                    close(ch[i].from);
+                    ch[i].from = -1;
+                    if (i == 0 && ch[0].to >= 0) {
+                        /* End of the job's data for the renderer */
+                        close(ch[0].to);
+                        ch[0].to = -1;
+                    }
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (ch[i].from >= 0)
+            close(ch[i].from);
+        if (ch[i].to >= 0)
+            close(ch[i].to);
+    }
+}
+
+/* A slot starts the renderer and waits for a job for it. Exits with 0 after
+   the job and with 1 if the renderer has died before. */
+static void pool_slot(int listenfd, const char *cmdline)
+{
+    static channel_t ch[3];
+    struct pollfd pfd;
+    sigset_t waitmask;
+    int rfds[3], jobfds[3];
+    int conn, status;
+    pid_t renderer;
+
+    if ((renderer = start_renderer(cmdline, rfds)) < 0)
+        _exit(1);
+
+    /* Signals are blocked but while waiting for a job, a job which has been
+       taken is not interrupted */
+    sigemptyset(&waitmask);
+    pfd.fd = listenfd;
+    pfd.events = POLLIN;
+    for (;;) {
+        if (terminated) {
+            kill(-renderer, SIGTERM);
+            waitpid(renderer, NULL, 0);
+            _exit(0);
+        }
+        if (childexited) {
+            childexited = 0;
+            if (waitpid(renderer, NULL, WNOHANG) == renderer)
+                _exit(1);
+        }
+        if (ppoll(&pfd, 1, NULL, &waitmask) <= 0)
+            continue;
+        /* Another slot may have been faster */
+        if ((conn = accept(listenfd, NULL, NULL)) < 0)
+            continue;
+        if (peer_is_user(conn) && receive_fds(conn, jobfds, cmdline) == 0) {
+            if (write(conn, "", 1) == 1)
+                break;
+            close(jobfds[0]);
+            close(jobfds[1]);
+            close(jobfds[2]);
+        }
+        close(conn);
+    }
+    close(listenfd);
+
+    ch[0].from = jobfds[0];
+    ch[0].to = rfds[0];
+    ch[1].from = rfds[1];
+    ch[1].to = jobfds[1];
+    ch[2].from = rfds[2];
+    ch[2].to = jobfds[2];
+    fcntl(ch[0].to, F_SETFL, fcntl(ch[0].to, F_GETFL) | O_NONBLOCK);
+    fcntl(ch[1].to, F_SETFL, fcntl(ch[1].to, F_GETFL) | O_NONBLOCK);
+    relay(ch, renderer);
+
+    /* The job is done, even if its process is gone and misses the status */
+    waitpid(renderer, &status, 0);
+    if (write(conn, &status, sizeof(status)) < 0)
+        _exit(0);
+    _exit(0);
+}
+
+/* The pool daemon, tells 'ready' whether it listens ('1') or another
+   daemon has the pool ('0') */
+static void pool_daemon(const char *cmdline, const char *sockpath,
+                        const char *lockpath, int ready)
+{
+    struct sockaddr_un addr;
+    struct sigaction action;
+    sigset_t mask;
+    pid_t *slots, pid;
+    int lockfd, listenfd, size, status, i;
+    int failures = 0;
+
+    umask(077);
+    if ((lockfd = open(lockpath, O_RDWR | O_CREAT, 0600)) < 0)
+        _exit(1);
+    if (flock(lockfd, LOCK_EX | LOCK_NB) < 0)
+        _exit(write(ready, "0", 1) == 1 ? 0 : 1);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sockpath);
+    unlink(sockpath);
+    if ((listenfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+            bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(listenfd, 16) < 0)
+        _exit(1);
+    fcntl(listenfd, F_SETFL, fcntl(listenfd, F_GETFL) | O_NONBLOCK);
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGALRM);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = pool_signal;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGCHLD, &action, NULL);
+    sigaction(SIGALRM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+
+    size = renderer_pool_size > 0 ? renderer_pool_size : 1;
+    slots = calloc(size, sizeof(pid_t));
+    if (!slots)
+        _exit(1);
+
+    if (write(ready, "1", 1) != 1)
+        _exit(1);
+    close(ready);
+
+    sigemptyset(&mask);
+    alarm(renderer_pool_timeout);
+    while (!terminated && !timedout && failures < POOL_MAX_FAILURES) {
+        for (i = 0; i < size; i++) {
+            if (slots[i])
+                continue;
+            if ((slots[i] = fork()) == 0)
+                pool_slot(listenfd, cmdline);
+            if (slots[i] < 0)
+                slots[i] = 0;
+        }
+
+        sigsuspend(&mask);
+        childexited = 0;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (i = 0; i < size; i++) {
+                if (slots[i] != pid)
+                    continue;
+                slots[i] = 0;
+                if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                    failures = 0;
+                    alarm(renderer_pool_timeout);
+                }
+                else
+                    failures++;
+            }
+        }
+    }
+
+    /* New jobs start their renderer directly or a new pool from now on, jobs
+       which have been taken are finished */
+    unlink(sockpath);
+    close(listenfd);
+    for (i = 0; i < size; i++)
+        if (slots[i])
+            kill(slots[i], SIGTERM);
+    while (wait(NULL) > 0);
+    _exit(0);
+}
+
+/* Start the pool daemon, detached from the job. Returns 1 if it listens,
+   0 if another one has the pool and -1 on failure. */
+static int pool_start(const char *cmdline, const char *sockpath, const char *lockpath)
+{
+    int pfd[2];
+    int fd, maxfd;
+    pid_t pid;
+    char c;
+
+    if (pipe(pfd) < 0)
+        return -1;
+
+    pid = fork();
+    if (pid == 0) {
+        setsid();
+        if (fork() == 0) {
+            /* Keep nothing of the job open, its pipes must see their end */
+            fd = open("/dev/null", O_RDWR);
+            dup2(fd, 0);
+            dup2(fd, 1);
+            dup2(fd, 2);
+            maxfd = sysconf(_SC_OPEN_MAX);
+            for (fd = 3; fd < maxfd; fd++)
+                if (fd != pfd[1])
+                    close(fd);
+            if (chdir("/") < 0)
+                _exit(1);
+            pool_daemon(cmdline, sockpath, lockpath, pfd[1]);
+        }
+        _exit(0);
+    }
+    close(pfd[1]);
+    if (pid > 0)
+        waitpid(pid, NULL, 0);
+
+    if (pid < 0 || read(pfd[0], &c, 1) != 1)
+        c = 'x';
+    close(pfd[0]);
+
+    return c == '1' ? 1 : c == '0' ? 0 : -1;
+}
+
+static int pool_connect(const char *sockpath)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sockpath);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int pool_run_renderer(const char *cmdline)
+{
+    struct sockaddr_un addr;
+    char sockpath[sizeof(addr.sun_path)];
+    char lockpath[PATH_MAX];
+    int fd, tries, status;
+    ssize_t bytes;
+    char ack;
+
+    if (!pool_dir_ok()) {
+        _log("Renderer pool directory %s missing, not ours or writable for others, "
+             "starting renderer directly\n", renderer_pool);
+        return -1;
+    }
+    if (!pool_path(sockpath, sizeof(sockpath), cmdline, "sock") ||
+            !pool_path(lockpath, sizeof(lockpath), cmdline, "lock")) {
+        _log("Renderer pool directory name too long, starting renderer directly\n");
+        return -1;
+    }
+
+    if ((fd = pool_connect(sockpath)) < 0) {
+        _log("Starting renderer pool %s\n", sockpath);
+        if (pool_start(cmdline, sockpath, lockpath) < 0) {
+            _log("Could not start renderer pool, starting renderer directly\n");
+            return -1;
+        }
+        for (tries = 0; (fd = pool_connect(sockpath)) < 0 && tries < POOL_CONNECT_TRIES; tries++)
+            usleep(100000);
+        if (fd < 0) {
+            _log("Could not connect to renderer pool, starting renderer directly\n");
+            return -1;
+        }
+    }
+
+    if (!peer_is_user(fd)) {
+        _log("Renderer pool %s runs as another user, starting renderer directly\n",
+             sockpath);
+        close(fd);
+        return -1;
+    }
+
+    /* Until a slot has acknowledged the job, it can still be run here */
+    if (send_fds(fd, cmdline) < 0 || read(fd, &ack, 1) != 1) {
+        _log("Renderer pool did not take the job, starting renderer directly\n");
+        close(fd);
+        return -1;
+    }
+    _log("Renderer from pool %s took the job\n", sockpath);
+
+    while ((bytes = read(fd, &status, sizeof(status))) < 0 && errno == EINTR);
+    close(fd);
+
+    if (bytes != sizeof(status)) {
+        _log("Lost the renderer pool during the job\n");
+        /* As if the renderer got a SIGUSR1, which exec_kid3() reports as a
+           printer error, so that the job is retried */
+        return SIGUSR1;
+    }
+    return status;
+}
@@ -0,0 +1,43 @@
+/* pool.h
+ *
+ * This file is part of foomatic-rip.
+ *
+ * Foomatic-rip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Foomatic-rip is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef pool_h
+#define pool_h
+
+#include <limits.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+/* Directory for the renderer pool sockets, the pool is off if empty */
+extern char renderer_pool[PATH_MAX];
+/* Number of renderers which are kept waiting for a job */
+extern int renderer_pool_size;
+/* Seconds without a job after which a pool shuts down */
+extern int renderer_pool_timeout;
+
+/* Runs the renderer command line on stdin/stdout/stderr with an already
+   started renderer from the pool, starting the pool if needed. Returns the
+   renderer's wait status, or -1 if no pool renderer took the job and it has
+   to be run directly. */
+int pool_run_renderer(const char *cmdline);
+
+#endif
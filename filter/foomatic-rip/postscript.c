@@ -135,37 +135,101 @@ int line_type(const char *line)
 #define MAX_NON_DSC_LINES_IN_HEADER 1000
 #define MAX_LINES_FOR_PAGE_OPTIONS 200
 
+#define STREAM_BUFSIZE 262144
+
+/* The input is read in large blocks. The data which the main program has
+   already read from the file comes first, it is only copied into the block
+   buffer when a line continues beyond it. */
 typedef struct {
-    size_t pos;
+    size_t pos;         /* current position in data */
+    size_t len;         /* number of bytes in data */
+    const char *data;   /* alreadyread, then buf */
+    char *buf;
 
     FILE *file;
-    const char *alreadyread;
-    size_t len;
 } stream_t;
 
 void _print_ps(stream_t *stream);
 
+/* Move the unread rest to the start of the buffer and read more data behind
+   it, returns the number of bytes read */
+static size_t stream_fill(stream_t *s)
+{
+    size_t rest = s->len - s->pos;
+    size_t bytes;
+
+    if (!s->buf)
+        s->buf = malloc(STREAM_BUFSIZE);
+    if (rest)
+        memmove(s->buf, s->data + s->pos, rest);
+    bytes = fread_or_die(s->buf + rest, 1, STREAM_BUFSIZE - rest, s->file);
+
+    s->data = s->buf;
+    s->pos = 0;
+    s->len = rest + bytes;
+    return bytes;
+}
+
 int stream_next_line(dstr_t *line, stream_t *s)
 {
-    int c;
-    size_t cnt = 0;
+    const char *p;
+    size_t n, cnt = 0;
 
     dstrclear(line);
-    while (s->pos < s->len) {
-        c = s->alreadyread[s->pos++];
-        dstrputc(line, c);
-        cnt++;
-        if (c == '\n')
+    for (;;) {
+        if (s->pos == s->len && !stream_fill(s))
+            return cnt;
+        p = memchr(s->data + s->pos, '\n', s->len - s->pos);
+        n = p ? (size_t)(p - s->data) + 1 - s->pos : s->len - s->pos;
+        dstrcatbuf(line, s->data + s->pos, n);
+        s->pos += n;
+        cnt += n;
+        if (p)
             return cnt;
     }
+}
 
-    while ((c = fgetc(s->file)) != EOF) {
-        dstrputc(line, c);
-        cnt++;
-        if (c == '\n')
-            return cnt;
+/* Send the input to the renderer up to the next line starting with "%%",
+   which stays in the stream. Only the '%' characters are looked at, so the
+   PostScript code in between is written out in whole blocks. Returns 1 if
+   such a line was found and 0 at the end of the input. */
+int stream_pass_to_dsc(stream_t *s, FILE *out)
+{
+    const char *start, *end, *p;
+    int bol = 1;    /* at the beginning of a line */
+
+    for (;;) {
+        /* Two bytes tell whether a line starts with "%%" */
+        if (s->len - s->pos < 2)
+            stream_fill(s);
+        start = s->data + s->pos;
+        end = s->data + s->len;
+        if (start == end)
+            return 0;
+        if (bol && end - start >= 2 && start[0] == '%' && start[1] == '%')
+            return 1;
+
+        for (p = start; (p = memchr(p, '%', end - p)); p++) {
+            if (p == start || p[-1] != '\n')
+                continue;
+            if (p + 1 == end || p[1] == '%')
+                break;
+        }
+
+        if (p) {
+            /* Line start at p, a DSC comment or cut off by the block end */
+            fwrite_or_die(start, p - start, 1, out);
+            s->pos = p - s->data;
+            if (p + 1 < end)
+                return 1;
+            bol = 1;
+        }
+        else {
+            fwrite_or_die(start, end - start, 1, out);
+            s->pos = s->len;
+            bol = end[-1] == '\n';
+        }
     }
-    return cnt;
 }
 
 int ps_pages(const char *filename)
@@ -208,10 +272,12 @@ int print_ps(FILE *file, const char *alreadyread, size_t len, const char *filena
     }
 
     stream.pos = 0;
+    stream.len = alreadyread ? len : 0;
+    stream.data = alreadyread;
+    stream.buf = NULL;
     stream.file = file;
-    stream.alreadyread = alreadyread;
-    stream.len = len;
     _print_ps(&stream);
+    free(stream.buf);
     return 1;
 }
 
@@ -1055,18 +1121,16 @@ void _print_ps(stream_t *stream)
                     if (!printprevpage) {
                         fwrite_or_die(line->data, line->len, 1, rendererhandle);
 
-                        while (stream_next_line(line, stream) > 0) {
-                            if (startswith(line->data, "%%")) {
-                                _log("Found: %s", line->data);
-                                _log(" --> Continue DSC parsing now.\n\n");
-                                saved = 1;
-                                break;
-                            }
-                            else {
-                                fwrite_or_die(line->data, line->len, 1, rendererhandle);
-                                linect++;
-                            }
+                        /* The lines passed through are not counted, the
+                           line count only matters in the header */
+                        if (stream_pass_to_dsc(stream, rendererhandle)) {
+                            stream_next_line(line, stream);
+                            _log("Found: %s", line->data);
+                            _log(" --> Continue DSC parsing now.\n\n");
+                            saved = 1;
                         }
+                        else
+                            dstrclear(line);
                     }
                 }
                 else {
@@ -1160,10 +1224,9 @@ void _print_ps(stream_t *stream)
         }
 
         /* Print the rest of the input data */
-        if (more_stuff) {
-            while (stream_next_line(tmp, stream))
-                fwrite_or_die(tmp->data, tmp->len, 1, rendererhandle);
-        }
+        if (more_stuff)
+            copy_file(rendererhandle, stream->file,
+                      stream->data + stream->pos, stream->len - stream->pos);
     }
 
     /*  At every "%%Page:..." comment we have saved the PostScript state
@@ -30,6 +30,7 @@
 #include "util.h"
 #include "process.h"
 #include "options.h"
+#include "pool.h"
 
 /*
  * Check whether we have a Ghostscript version with redirection of the standard
@@ -445,8 +446,13 @@ int exec_kid3(FILE *in, FILE *out, void *user_arg)
         dstrcat(commandline, ")");
     }
 
-    /* Actually run the thing */
-    status = run_system_process("renderer", commandline->data);
+    /* Actually run the thing. A renderer which reads the job from stdin can
+       be taken from the renderer pool, if there is one */
+    status = -1;
+    if (in && *renderer_pool)
+        status = pool_run_renderer(commandline->data);
+    if (status == -1)
+        status = run_system_process("renderer", commandline->data);
 
     if (in)
         fclose(in);
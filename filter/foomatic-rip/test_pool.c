@@ -0,0 +1,229 @@
+/* test_pool.c
+ *
+ * This file is part of foomatic-rip.
+ *
+ * Foomatic-rip is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Foomatic-rip is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Test of the renderer pool. The renderers are stub shell command lines
+ * which are slow to start, convert the job to upper case, write messages
+ * or fail. Run with "-v" to see the log.
+ */
+
+#include "foomaticrip.h"
+#include "pool.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define NOT_TAKEN 99    /* exit status of a job which the pool did not take */
+
+static int verbose = 0;
+static char dir[] = "/tmp/test_pool-XXXXXX";
+
+/* The functions of foomatic-rip which the pool uses */
+void _log(const char* msg, ...)
+{
+    va_list ap;
+
+    if (!verbose)
+        return;
+    va_start(ap, msg);
+    vfprintf(stderr, msg, ap);
+    va_end(ap);
+}
+
+const char * get_modern_shell()
+{
+    return "/bin/sh";
+}
+
+static double now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static size_t read_file(const char *name, char *buf, size_t size)
+{
+    size_t bytes = 0;
+    FILE *fh = fopen(name, "r");
+
+    if (fh) {
+        bytes = fread(buf, 1, size - 1, fh);
+        fclose(fh);
+    }
+    buf[bytes] = '\0';
+    return bytes;
+}
+
+/* Run a job through the pool as exec_kid3() does, with stdin, stdout and
+   stderr on files. Returns the exit status of the renderer, or NOT_TAKEN. */
+static int run_job(const char *cmdline, const char *input, size_t len,
+                   char *output, size_t outsize, char *messages, size_t msgsize,
+                   double *secs)
+{
+    char in[64], out[64], err[64];
+    double start = now();
+    FILE *fh;
+    pid_t pid;
+    int status;
+
+    snprintf(in, sizeof(in), "%s/in", dir);
+    snprintf(out, sizeof(out), "%s/out", dir);
+    snprintf(err, sizeof(err), "%s/err", dir);
+
+    fh = fopen(in, "w");
+    fwrite(input, 1, len, fh);
+    fclose(fh);
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        if (!freopen(in, "r", stdin) || !freopen(out, "w", stdout))
+            exit(1);
+        if (!verbose && !freopen(err, "w", stderr))
+            exit(1);
+
+        status = pool_run_renderer(cmdline);
+        if (status == -1)
+            exit(NOT_TAKEN);
+        exit(WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+    }
+    waitpid(pid, &status, 0);
+
+    *secs = now() - start;
+    read_file(out, output, outsize);
+    read_file(err, messages, msgsize);
+    return WEXITSTATUS(status);
+}
+
+static int count_sockets()
+{
+    DIR *d = opendir(dir);
+    struct dirent *ent;
+    int count = 0;
+
+    while ((ent = readdir(d)))
+        if (strstr(ent->d_name, ".sock"))
+            count++;
+    closedir(d);
+    return count;
+}
+
+/* Wait until pool sockets exist or not, for at most the given time */
+static int wait_sockets(int running, double secs)
+{
+    double end = now() + secs;
+
+    while ((count_sockets() > 0) != running && now() < end)
+        usleep(100000);
+    return (count_sockets() > 0) == running;
+}
+
+static int check(int ok, const char *what)
+{
+    printf("%s: %s\n", what, ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    static char output[8 << 20], messages[4096], big[4 << 20];
+    double secs, cold;
+    size_t i;
+    int status, errors = 0;
+
+    verbose = argc > 1 && !strcmp(argv[1], "-v");
+    unsetenv("PRINTER");
+    unsetenv("PPD");
+
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    /* Without a pool directory the renderer is started directly */
+    strcpy(renderer_pool, "/nonexistent/test_pool");
+    status = run_job("cat", "x", 1, output, sizeof(output), messages, sizeof(messages), &secs);
+    errors += check(status == NOT_TAKEN, "missing directory");
+
+    /* Nor if others could put their sockets there */
+    strcpy(renderer_pool, dir);
+    chmod(dir, 0770);
+    status = run_job("cat", "x", 1, output, sizeof(output), messages, sizeof(messages), &secs);
+    errors += check(status == NOT_TAKEN && count_sockets() == 0, "group writable directory");
+    chmod(dir, 0700);
+
+    renderer_pool_timeout = 3;
+
+    /* The first job starts the pool and waits for the renderer to start, the
+       next one finds it started already if it comes as late again */
+    status = run_job("sleep 1; tr a-z A-Z", "hello\n", 6, output, sizeof(output),
+                     messages, sizeof(messages), &cold);
+    errors += check(status == 0 && !strcmp(output, "HELLO\n") && cold >= 1.0 &&
+                    count_sockets() == 1, "first job");
+    usleep(cold * 1000000);
+    status = run_job("sleep 1; tr a-z A-Z", "world\n", 6, output, sizeof(output),
+                     messages, sizeof(messages), &secs);
+    errors += check(status == 0 && !strcmp(output, "WORLD\n") && secs < cold / 2,
+                    "started renderer");
+
+    /* Messages and exit status of the renderer */
+    status = run_job("echo rendering >&2; cat; exit 3", "page\n", 5, output, sizeof(output),
+                     messages, sizeof(messages), &secs);
+    errors += check(status == 3 && !strcmp(output, "page\n") &&
+                    (verbose || strstr(messages, "rendering")), "status and messages");
+
+    /* Data larger than the pipes in both directions */
+    for (i = 0; i < sizeof(big); i++)
+        big[i] = "abcdefghijklmnopqrstuvwxyz\n"[i % 27];
+    status = run_job("tr a-z A-Z", big, sizeof(big), output, sizeof(output),
+                     messages, sizeof(messages), &secs);
+    for (i = 0; i < sizeof(big); i++)
+        big[i] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ\n"[i % 27];
+    errors += check(status == 0 && !memcmp(output, big, sizeof(big)) &&
+                    output[sizeof(big)] == '\0', "large job");
+
+    /* Idle pools shut down */
+    errors += check(count_sockets() > 0, "pools running");
+    errors += check(wait_sockets(0, renderer_pool_timeout + 10), "pools shut down");
+
+    if (!errors) {
+        DIR *d = opendir(dir);
+        struct dirent *ent;
+        char name[PATH_MAX];
+
+        while ((ent = readdir(d))) {
+            snprintf(name, sizeof(name), "%s/%s", dir, ent->d_name);
+            unlink(name);
+        }
+        closedir(d);
+        rmdir(dir);
+    }
+
+    return errors ? 1 : 0;
+}
@@ -648,6 +648,22 @@ void dstrncat(dstr_t *ds, const char *src, size_t n)
     ds->data[ds->len] = '\0';
 }
 
+void dstrcatbuf(dstr_t *ds, const char *buf, size_t n)
+{
+    size_t needed = ds->len + n;
+
+    if (needed >= ds->alloc) {
+        do {
+            ds->alloc *= 2;
+        } while (needed >= ds->alloc);
+        ds->data = realloc(ds->data, ds->alloc);
+    }
+
+    memcpy(&ds->data[ds->len], buf, n);
+    ds->len = needed;
+    ds->data[ds->len] = '\0';
+}
+
 void dstrcpyf(dstr_t *ds, const char *src, ...)
 {
     va_list ap;
@@ -1045,6 +1061,106 @@ listitem_t * list_get(list_t *list, int idx)
     return i;
 }
 
+
+/*
+ *  HASH
+ */
+
+/* FNV-1a over the lower-cased key, so that keys differing only in case
+   land in the same bucket */
+static size_t hash_key(const char *key)
+{
+    size_t h = 2166136261u;
+    for (; *key; key++)
+        h = (h ^ (unsigned char)tolower((unsigned char)*key)) * 16777619u;
+    return h;
+}
+
+hash_t * hash_create()
+{
+    hash_t *h = malloc(sizeof(hash_t));
+    h->size = 16;
+    h->count = 0;
+    h->buckets = calloc(h->size, sizeof(hashitem_t *));
+    return h;
+}
+
+void hash_free(hash_t *hash)
+{
+    hashitem_t *i, *tmp;
+    size_t b;
+
+    if (!hash)
+        return;
+
+    for (b = 0; b < hash->size; b++) {
+        for (i = hash->buckets[b]; i; i = tmp) {
+            tmp = i->next;
+            free(i);
+        }
+    }
+    free(hash->buckets);
+    free(hash);
+}
+
+static void hash_grow(hash_t *hash)
+{
+    hashitem_t **buckets, *i, *tmp;
+    size_t b, size = hash->size * 2;
+
+    buckets = calloc(size, sizeof(hashitem_t *));
+    for (b = 0; b < hash->size; b++) {
+        for (i = hash->buckets[b]; i; i = tmp) {
+            tmp = i->next;
+            i->next = buckets[i->hash & (size - 1)];
+            buckets[i->hash & (size - 1)] = i;
+        }
+    }
+    free(hash->buckets);
+    hash->buckets = buckets;
+    hash->size = size;
+}
+
+void hash_insert(hash_t *hash, const char *key, void *data)
+{
+    hashitem_t *item, **last;
+    size_t h = hash_key(key);
+
+    assert(hash);
+
+    /* Keep the first item for a key, as a list scan would find it */
+    for (last = &hash->buckets[h & (hash->size - 1)]; *last; last = &(*last)->next) {
+        if ((*last)->hash == h && !strcasecmp((*last)->key, key))
+            return;
+    }
+
+    item = malloc(sizeof(hashitem_t));
+    item->key = key;
+    item->data = data;
+    item->hash = h;
+    item->next = NULL;
+    *last = item;
+
+    if (++hash->count > hash->size)
+        hash_grow(hash);
+}
+
+void * hash_find(hash_t *hash, const char *key)
+{
+    hashitem_t *i;
+    size_t h;
+
+    if (!hash)
+        return NULL;
+
+    h = hash_key(key);
+    for (i = hash->buckets[h & (hash->size - 1)]; i; i = i->next) {
+        if (i->hash == h && !strcasecmp(i->key, key))
+            return i->data;
+    }
+    return NULL;
+}
+
 listitem_t * arglist_find(list_t *list, const char *name)
 {
     listitem_t *i;
@@ -154,6 +154,7 @@ void dstrassure(dstr_t *ds, size_t alloc);
 void dstrcpy(dstr_t *ds, const char *src);
 void dstrncpy(dstr_t *ds, const char *src, size_t n);
 void dstrncat(dstr_t *ds, const char *src, size_t n);
+void dstrcatbuf(dstr_t *ds, const char *buf, size_t n); /* appends n bytes, even '\0' */
 void dstrcpyf(dstr_t *ds, const char *src, ...);
 void dstrcat(dstr_t *ds, const char *src);
 void dstrcatf(dstr_t *ds, const char *src, ...);
@@ -198,6 +199,26 @@ void list_remove(list_t *list, listitem_t *item);
 listitem_t * list_get(list_t *list, int idx);
 
 
+/* Case-insensitive string hash, keys and values are NOT copied */
+typedef struct hashitem_s {
+    const char *key;
+    void *data;
+    size_t hash;
+    struct hashitem_s *next;
+} hashitem_t;
+
+typedef struct {
+    hashitem_t **buckets;
+    size_t size, count;
+} hash_t;
+
+hash_t * hash_create();
+void hash_free(hash_t *hash);
+
+void hash_insert(hash_t *hash, const char *key, void *data);
+void * hash_find(hash_t *hash, const char *key);
+
+
 /* Argument values may be seperated from their keys in the following ways:
     - with whitespace (i.e. it is in the next list entry)
     - with a '='
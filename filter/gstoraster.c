@@ -45,6 +45,7 @@ MIT Open Source License  -  http://www.opensource.org/
 #include <cupsfilters/colormanager.h>
 #include <cupsfilters/raster.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <signal.h>
 #include <errno.h>
@@ -86,7 +87,8 @@ parse_doc_type(FILE *fp)
 }
 
 static void
-parse_pdf_header_options(FILE *fp, gs_page_header *h)
+parse_pdf_header_options(FILE *fp, gs_page_header *h,
+			 int *raster_copies, int *raster_collate)
 {
   char buf[4096];
   int i;
@@ -115,10 +117,59 @@ parse_pdf_header_options(FILE *fp, gs_page_header *h)
       } else {
         h->Collate = CUPS_FALSE;
       }
+    } else if (strncmp(buf,"%%PDFTOPDFRasterCopies",22) == 0) {
+      char *p;
+
+      p = strchr(buf+22,':');
+      *raster_copies = p ? atoi(p+1) : 1;
+      if (*raster_copies < 1)
+        *raster_copies = 1;
+    } else if (strncmp(buf,"%%PDFTOPDFRasterCollate",23) == 0) {
+      char *p;
+
+      if ((p = strchr(buf+23,':')) == NULL)
+        continue;
+      p++;
+      while (*p == ' ' || *p == '\t') p++;
+      *raster_collate = (strncasecmp(p,"true",4) == 0);
     }
   }
 }
 
+/*
+ * Let a child process generate the copies from Ghostscript's raster
+ * output: Ghostscript writes into a pipe instead of stdout, the child
+ * copies the pages to stdout, storing them for the copies.
+ */
+
+static pid_t
+start_raster_copies(int copies, int collate, cups_mode_t mode)
+{
+  int fds[2];
+  pid_t pid;
+
+  if (pipe(fds) < 0)
+    return (-1);
+
+  fflush(stdout);
+
+  if ((pid = fork()) == 0) {
+    close(fds[1]);
+    exit(cupsRasterCopiesStream(fds[0], 1, mode, copies, collate) < 0 ? 1 : 0);
+  }
+  if (pid < 0 || dup2(fds[1], 1) < 0) {
+    if (pid > 0)
+      kill(pid, SIGTERM);
+    close(fds[0]);
+    close(fds[1]);
+    return (-1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  return (pid);
+}
+
 static void
 add_pdf_header_options(gs_page_header *h, cups_array_t *gs_args,
 		       OutFormatType outformat, int pxlcolor)
@@ -582,6 +633,66 @@ out:
 }
 #endif
 
+/*
+ * 'copy_fd()' - Copy everything from one file descriptor to another.
+ *               Returns 0 on success, -1 on error.
+ */
+
+static int
+copy_fd(int infd,
+	int outfd)
+{
+  char *buf;
+  const char *p;
+  ssize_t n, w;
+  const size_t bufsize = 1 << 18;
+#ifdef HAVE_SPLICE
+  int spliced = 0;
+
+ /*
+  * Our input usually is a pipe from the previous filter, let the kernel
+  * move the data into the file without copying it through user space...
+  */
+
+  while ((n = splice(infd, NULL, outfd, NULL, 1 << 20,
+		     SPLICE_F_MOVE | SPLICE_F_MORE)) != 0) {
+    if (n < 0) {
+      if (errno == EINTR)
+	continue;
+      if (!spliced && (errno == EINVAL || errno == ESPIPE))
+	break;				/* Not a pipe, copy it ourselves */
+      return (-1);
+    }
+    spliced = 1;
+  }
+  if (n == 0)
+    return (0);
+#endif /* HAVE_SPLICE */
+
+  if ((buf = malloc(bufsize)) == NULL)
+    return (-1);
+
+  while ((n = read(infd, buf, bufsize)) != 0) {
+    if (n < 0) {
+      if (errno == EINTR)
+	continue;
+      free(buf);
+      return (-1);
+    }
+    for (p = buf; n > 0; p += w, n -= w)
+      if ((w = write(outfd, p, n)) < 0) {
+	if (errno != EINTR) {
+	  free(buf);
+	  return (-1);
+	}
+	w = 0;
+      }
+  }
+
+  free(buf);
+  return (0);
+}
+
 // Returns the number of pages in the document |filename|. Returns -1 if there was an error.
 static int
 count_pages(char* filename, GsDocType doc_type) {
@@ -635,9 +746,14 @@ main (int argc, char **argv, char *envp[])
   gs_page_header h;
   int fd;
   int cm_disabled;
-  int n;
   int num_options;
   int status = 1;
+  int is_tempfile = 0;
+  struct stat st;
+  int raster_copies = 1;
+  int raster_collate = 0;
+  pid_t copies_pid = -1;
+  int wstatus;
   ppd_file_t *ppd = NULL;
   struct sigaction sa;
   cm_calibration_t cm_calibrate;
@@ -691,7 +807,18 @@ main (int argc, char **argv, char *envp[])
     cupsMarkOptions (ppd, num_options, options);
   }
 
-  if (argc == 6) {
+  if (argc == 6 && fstat(0, &st) == 0 && S_ISREG(st.st_mode) &&
+      lseek(0, 0, SEEK_CUR) == 0 && (fd = dup(0)) >= 0) {
+    /* stdin is a regular file, Ghostscript and QPDF can read it directly */
+
+    if ((fp = fdopen(fd,"rb")) == 0) {
+        fprintf(stderr, "ERROR: Can't fdopen stdin\n");
+        close(fd);
+        goto out;
+    }
+    filename = "/dev/fd/0";
+    fprintf(stderr, "DEBUG: Reading seekable stdin directly\n");
+  } else if (argc == 6) {
     /* stdin */
 
     fd = cupsTempFd(buf,BUFSIZ);
@@ -701,14 +828,13 @@ main (int argc, char **argv, char *envp[])
     }
 
     filename = strdup(buf);
+    is_tempfile = 1;
 
     /* copy stdin to the tmp file */
-    while ((n = read(0,buf,BUFSIZ)) > 0) {
-      if (write(fd,buf,n) != n) {
-        fprintf(stderr, "ERROR: Can't copy stdin to temporary file\n");
-        close(fd);
-        goto out;
-      }
+    if (copy_fd(0, fd) < 0) {
+      fprintf(stderr, "ERROR: Can't copy stdin to temporary file\n");
+      close(fd);
+      goto out;
     }
     if (lseek(fd,0,SEEK_SET) < 0) {
         fprintf(stderr, "ERROR: Can't rewind temporary file\n");
@@ -766,7 +892,7 @@ main (int argc, char **argv, char *envp[])
     num_options = cupsAddIntegerOption("job-impressions", pagecount, num_options, &options);
   }
 
-  if (argc == 6) {
+  if (is_tempfile) {
     /* input from stdin */
     /* remove name of temp file*/
     unlink(filename);
@@ -949,7 +1075,7 @@ main (int argc, char **argv, char *envp[])
 
   /* set PDF-specific options */
   if (doc_type == GS_DOC_TYPE_PDF) {
-    parse_pdf_header_options(fp, &h);
+    parse_pdf_header_options(fp, &h, &raster_copies, &raster_collate);
   }
 
   /* fixed other values that pdftopdf handles */
@@ -1026,10 +1152,37 @@ main (int argc, char **argv, char *envp[])
   /* Execute Ghostscript command line ... */
   snprintf(tmpstr, sizeof(tmpstr), "%s", CUPS_GHOSTSCRIPT);
 
+  /* Software copies requested by pdftopdf get made from the rendered
+     pages, so that the document does not need to get rendered again for
+     every copy */
+  if (raster_copies > 1 && outformat == OUTPUT_FORMAT_RASTER) {
+    cups_mode_t mode = CUPS_RASTER_WRITE;
+#ifdef HAVE_CUPS_1_7
+    if (pwgraster)
+      mode = CUPS_RASTER_WRITE_PWG;
+#endif /* HAVE_CUPS_1_7 */
+    fprintf(stderr, "DEBUG: Generating %d %scollated copies from the rendered pages\n",
+	    raster_copies, raster_collate ? "" : "un");
+    if ((copies_pid = start_raster_copies(raster_copies, raster_collate,
+					  mode)) < 0) {
+      fprintf(stderr, "ERROR: Unable to start process for generating copies\n");
+      goto out;
+    }
+  }
+
   /* call Ghostscript */
   rewind(fp);
   status = gs_spawn (tmpstr, gs_args, envp, fp);
   if (status != 0) status = 1;
+
+  if (copies_pid > 0) {
+    close(1);
+    while (waitpid(copies_pid, &wstatus, 0) < 0 && errno == EINTR);
+    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+      fprintf(stderr, "ERROR: Generating copies failed\n");
+      status = 1;
+    }
+  }
 out:
   if (fp)
     fclose(fp);
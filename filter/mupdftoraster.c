@@ -84,7 +84,8 @@ parse_doc_type(FILE *fp)
 }
 
 static void
-parse_pdf_header_options(FILE *fp, mupdf_page_header *h)
+parse_pdf_header_options(FILE *fp, mupdf_page_header *h,
+			 int *raster_copies, int *raster_collate)
 {
   char buf[4096];
   int i;
@@ -113,10 +114,60 @@ parse_pdf_header_options(FILE *fp, mupdf_page_header *h)
       } else {
         h->Collate = CUPS_FALSE;
       }
+    } else if (strncmp(buf,"%%PDFTOPDFRasterCopies",22) == 0) {
+      char *p;
+
+      p = strchr(buf+22,':');
+      *raster_copies = p ? atoi(p+1) : 1;
+      if (*raster_copies < 1)
+        *raster_copies = 1;
+    } else if (strncmp(buf,"%%PDFTOPDFRasterCollate",23) == 0) {
+      char *p;
+
+      if ((p = strchr(buf+23,':')) == NULL)
+        continue;
+      p++;
+      while (*p == ' ' || *p == '\t') p++;
+      *raster_collate = (strncasecmp(p,"true",4) == 0);
     }
   }
 }
 
+/*
+ * Let a child process generate the copies from mutool's raster output:
+ * mutool writes into a pipe instead of stdout, the child copies the
+ * pages to stdout, storing them for the copies.
+ */
+
+static pid_t
+start_raster_copies(int copies, int collate)
+{
+  int fds[2];
+  pid_t pid;
+
+  if (pipe(fds) < 0)
+    return (-1);
+
+  fflush(stdout);
+
+  if ((pid = fork()) == 0) {
+    close(fds[1]);
+    exit(cupsRasterCopiesStream(fds[0], 1, CUPS_RASTER_WRITE_PWG, copies,
+				collate) < 0 ? 1 : 0);
+  }
+  if (pid < 0 || dup2(fds[1], 1) < 0) {
+    if (pid > 0)
+      kill(pid, SIGTERM);
+    close(fds[0]);
+    close(fds[1]);
+    return (-1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  return (pid);
+}
+
 static void
 add_pdf_header_options(mupdf_page_header *h,
 		       cups_array_t 	 *mupdf_args)
@@ -248,6 +299,10 @@ main (int argc, char **argv, char *envp[])
   int num_options;
   int empty = 0;
   int status = 1;
+  int raster_copies = 1;
+  int raster_collate = 0;
+  pid_t copies_pid = -1;
+  int wstatus;
   ppd_file_t *ppd = NULL;
   struct sigaction sa;
   cm_calibration_t cm_calibrate;
@@ -396,7 +451,7 @@ main (int argc, char **argv, char *envp[])
   }
 
   /* set PDF-specific options */
-  parse_pdf_header_options(fp, &h);
+  parse_pdf_header_options(fp, &h, &raster_copies, &raster_collate);
 
   /* fixed other values that pdftopdf handles */
   h.MirrorPrint = CUPS_FALSE;
@@ -411,10 +466,32 @@ main (int argc, char **argv, char *envp[])
   /* Execute mutool command line ... */
   snprintf(tmpstr, sizeof(tmpstr), "%s", CUPS_MUTOOL);
 		
+  /* Software copies requested by pdftopdf get made from the rendered
+     pages, so that the document does not need to get rendered again for
+     every copy */
+  if (raster_copies > 1 && !empty) {
+    fprintf(stderr, "DEBUG: Generating %d %scollated copies from the rendered pages\n",
+	    raster_copies, raster_collate ? "" : "un");
+    if ((copies_pid = start_raster_copies(raster_copies,
+					  raster_collate)) < 0) {
+      fprintf(stderr, "ERROR: Unable to start process for generating copies\n");
+      goto out;
+    }
+  }
+
   /* call mutool */
   status = mutool_spawn (tmpstr, mupdf_args, envp);
   if (status != 0) status = 1;
 
+  if (copies_pid > 0) {
+    close(1);
+    while (waitpid(copies_pid, &wstatus, 0) < 0 && errno == EINTR);
+    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+      fprintf(stderr, "ERROR: Generating copies failed\n");
+      status = 1;
+    }
+  }
+
   if(empty)
   {
      fprintf(stderr, "DEBUG: Input is empty, outputting empty file.\n");
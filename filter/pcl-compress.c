@@ -0,0 +1,410 @@
+/*
+ *   HP-PCL raster compression for CUPS.
+ *
+ *   Copyright 2007-2011 by Apple Inc.
+ *   Copyright 1993-2005 by Easy Software Products
+ *
+ *   These coded instructions, statements, and computer programs are the
+ *   property of Apple Inc. and are protected by Federal copyright
+ *   law.  Distribution and use rights are outlined in the file "COPYING"
+ *   which should have been included with this file.
+ *
+ * Contents:
+ *
+ *   pcl_compress_packbits() - Compress a line with TIFF pack-bits (mode 2).
+ *   pcl_compress_delta()    - Compress a line with delta-row (mode 3).
+ *   pcl_compress_best()     - Pick the smallest of modes 0, 2 and 3.
+ *   same_bytes()            - Count matching leading bytes.
+ *   first_pair()            - Find the first pair of equal adjacent bytes.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "pcl-compress.h"
+#include <string.h>
+#include <stdint.h>
+
+
+/*
+ * The scanners below compare 8 bytes at a time when the byte order allows
+ * telling which byte differs first; they fall back to bytes otherwise...
+ */
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define PCL_WORDS 1
+#  define ONES	0x0101010101010101ULL
+#  define HIGHS	0x8080808080808080ULL
+#endif /* __GNUC__ && little endian */
+
+
+/*
+ * Local functions...
+ */
+
+static int	same_bytes(const unsigned char *a, const unsigned char *b,
+		           int length);
+static int	first_pair(const unsigned char *line, int length);
+
+
+#ifdef PCL_WORDS
+/*
+ * 'load_word()' - Load 8 unaligned bytes.
+ */
+
+static inline uint64_t			/* O - Bytes */
+load_word(const unsigned char *ptr)	/* I - Bytes to load */
+{
+  uint64_t	word;			/* Word */
+
+  memcpy(&word, ptr, sizeof(word));
+
+  return (word);
+}
+#endif /* PCL_WORDS */
+
+
+/*
+ * 'pcl_compress_packbits()' - Compress a line with TIFF pack-bits (mode 2).
+ */
+
+int					/* O - Number of bytes in comp */
+pcl_compress_packbits(
+    const unsigned char *line,		/* I - Data to compress */
+    int                 length,		/* I - Number of bytes */
+    unsigned char       *comp)		/* O - Compressed data */
+{
+  const unsigned char	*line_ptr,	/* Current byte pointer */
+			*line_end;	/* End-of-line byte pointer */
+  unsigned char		*comp_ptr;	/* Pointer into compression buffer */
+  int			count;		/* Count of bytes for output */
+
+
+  line_ptr = line;
+  line_end = line + length;
+  comp_ptr = comp;
+
+  while (line_ptr < line_end)
+  {
+    if ((line_ptr + 1) >= line_end)
+    {
+     /*
+      * Single byte on the end...
+      */
+
+      *comp_ptr++ = 0x00;
+      *comp_ptr++ = *line_ptr++;
+    }
+    else if (line_ptr[0] == line_ptr[1])
+    {
+     /*
+      * Repeated sequence of up to 127 bytes...
+      */
+
+      count = line_end - line_ptr - 1;
+      if (count > 126)
+        count = 126;
+
+      count = same_bytes(line_ptr, line_ptr + 1, count) + 1;
+
+      *comp_ptr++ = 257 - count;
+      *comp_ptr++ = *line_ptr;
+      line_ptr    += count;
+    }
+    else
+    {
+     /*
+      * Non-repeated sequence, up to the next repeated pair (which starts
+      * a run) or 127 bytes...
+      */
+
+      count = line_end - line_ptr - 2;
+      if (count > 126)
+        count = 126;
+
+      count = first_pair(line_ptr + 1, count) + 1;
+
+      *comp_ptr++ = count - 1;
+      memcpy(comp_ptr, line_ptr, count);
+      comp_ptr += count;
+      line_ptr += count;
+    }
+  }
+
+  return (comp_ptr - comp);
+}
+
+
+/*
+ * 'pcl_compress_delta()' - Compress a line with delta-row (mode 3).
+ *
+ * Without a seed (after "\033*b#Y"), the line is sent as 8 byte
+ * replacements at offset 0...
+ */
+
+int					/* O - Number of bytes in comp */
+pcl_compress_delta(
+    const unsigned char *line,		/* I - Data to compress */
+    const unsigned char *seed,		/* I - Previous line or NULL */
+    int                 length,		/* I - Number of bytes */
+    unsigned char       *comp)		/* O - Compressed data */
+{
+  const unsigned char	*line_ptr,	/* Current byte pointer */
+			*line_end,	/* End-of-line byte pointer */
+			*start;		/* Start of compression sequence */
+  unsigned char		*comp_ptr;	/* Pointer into compression buffer */
+  int			count,		/* Count of bytes for output */
+			offset;		/* Offset of bytes for output */
+
+
+  line_ptr = line;
+  line_end = line + length;
+  comp_ptr = comp;
+
+  while (line_ptr < line_end)
+  {
+    if (!seed)
+    {
+     /*
+      * The seed buffer is invalid, so do the next 8 bytes, max...
+      */
+
+      start  = line_ptr;
+      offset = 0;
+
+      if ((count = line_end - line_ptr) > 8)
+	count = 8;
+
+      line_ptr += count;
+    }
+    else
+    {
+     /*
+      * Skip the bytes that match the seed...
+      */
+
+      offset   = same_bytes(line_ptr, seed, line_end - line_ptr);
+      line_ptr += offset;
+      seed     += offset;
+
+      if (line_ptr == line_end)
+	break;
+
+     /*
+      * Find up to 8 non-matching bytes...
+      */
+
+      start = line_ptr;
+      count = 0;
+      while (line_ptr < line_end && *line_ptr != *seed && count < 8)
+      {
+	line_ptr ++;
+	seed ++;
+	count ++;
+      }
+    }
+
+   /*
+    * Place mode 3 compression data in the buffer; see HP manuals
+    * for details...
+    */
+
+    if (offset >= 31)
+    {
+     /*
+      * Output multi-byte offset...
+      */
+
+      *comp_ptr++ = ((count - 1) << 5) | 31;
+
+      offset -= 31;
+      while (offset >= 255)
+      {
+	*comp_ptr++ = 255;
+	offset      -= 255;
+      }
+
+      *comp_ptr++ = offset;
+    }
+    else
+    {
+     /*
+      * Output single-byte offset...
+      */
+
+      *comp_ptr++ = ((count - 1) << 5) | offset;
+    }
+
+    memcpy(comp_ptr, start, count);
+    comp_ptr += count;
+  }
+
+  return (comp_ptr - comp);
+}
+
+
+/*
+ * 'pcl_compress_best()' - Pick the smallest of modes 0, 2 and 3.
+ *
+ * Switching modes costs a "\033*b#M" command, so the current mode wins
+ * unless another one is smaller by more than that.  Mode 3 is only a
+ * candidate with a valid seed (the previous line of the same plane, which
+ * the printer keeps whatever mode that line was sent in), and mode 0
+ * sends blank lines as zero bytes...
+ */
+
+int					/* O - Mode to use */
+pcl_compress_best(
+    const unsigned char *line,		/* I - Data to compress */
+    const unsigned char *seed,		/* I - Previous line or NULL */
+    int                 length,		/* I - Number of bytes */
+    int                 max_mode,	/* I - Highest mode (2 or 3) */
+    int                 cur_mode,	/* I - Current mode */
+    unsigned char       *comp[2],	/* I - Compression buffers */
+    const unsigned char **data,		/* O - Data to send */
+    int                 *datalen)	/* O - Number of bytes to send */
+{
+  int	mode,				/* Best mode */
+	cost,				/* Bytes for best mode */
+	temp;				/* Bytes for other mode */
+
+
+ /*
+  * Identical and blank lines are cheapest to find; take them directly
+  * when no switch is needed...
+  */
+
+  if (max_mode >= 3 && seed && cur_mode == 3 &&
+      same_bytes(line, seed, length) == length)
+  {
+    *data    = comp[0];
+    *datalen = 0;
+    return (3);
+  }
+
+  if (length == 0 ||
+      (!line[0] && same_bytes(line, line + 1, length - 1) == length - 1))
+  {
+    *data    = line;
+    *datalen = 0;
+
+    if (cur_mode == 0)
+      return (0);
+
+    mode = 0;
+    cost = PCL_MODE_SWITCH_SIZE;
+  }
+  else
+  {
+    *data    = line;
+    *datalen = length;
+
+    mode = 0;
+    cost = length + (cur_mode != 0 ? PCL_MODE_SWITCH_SIZE : 0);
+  }
+
+ /*
+  * Try pack-bits...
+  */
+
+  temp = pcl_compress_packbits(line, length, comp[0]);
+  if ((temp + (cur_mode != 2 ? PCL_MODE_SWITCH_SIZE : 0)) < cost ||
+      ((temp + (cur_mode != 2 ? PCL_MODE_SWITCH_SIZE : 0)) == cost &&
+       cur_mode == 2))
+  {
+    mode     = 2;
+    cost     = temp + (cur_mode != 2 ? PCL_MODE_SWITCH_SIZE : 0);
+    *data    = comp[0];
+    *datalen = temp;
+  }
+
+ /*
+  * Try delta-row...
+  */
+
+  if (max_mode >= 3 && seed)
+  {
+    temp = pcl_compress_delta(line, seed, length, comp[1]);
+    if ((temp + (cur_mode != 3 ? PCL_MODE_SWITCH_SIZE : 0)) < cost ||
+        ((temp + (cur_mode != 3 ? PCL_MODE_SWITCH_SIZE : 0)) == cost &&
+	 cur_mode == 3))
+    {
+      mode     = 3;
+      *data    = comp[1];
+      *datalen = temp;
+    }
+  }
+
+  return (mode);
+}
+
+
+/*
+ * 'same_bytes()' - Count matching leading bytes.
+ */
+
+static int				/* O - Number of matching bytes */
+same_bytes(const unsigned char *a,	/* I - First buffer */
+           const unsigned char *b,	/* I - Second buffer */
+	   int                 length)	/* I - Maximum number of bytes */
+{
+  int	count = 0;			/* Matching bytes */
+
+
+#ifdef PCL_WORDS
+  while (count + 8 <= length)
+  {
+    uint64_t diff = load_word(a + count) ^ load_word(b + count);
+
+    if (diff)
+      return (count + (__builtin_ctzll(diff) >> 3));
+
+    count += 8;
+  }
+#endif /* PCL_WORDS */
+
+  while (count < length && a[count] == b[count])
+    count ++;
+
+  return (count);
+}
+
+
+/*
+ * 'first_pair()' - Find the first pair of equal adjacent bytes.
+ *
+ * Looks at line[0..length], returns length when no pair starts before...
+ */
+
+static int				/* O - Index of pair */
+first_pair(const unsigned char *line,	/* I - Data */
+           int                 length)	/* I - Number of pair starts */
+{
+  int	i = 0;				/* Current index */
+
+
+#ifdef PCL_WORDS
+  while (i + 8 <= length)
+  {
+   /*
+    * A zero byte in "diff" marks a pair; the lowest flagged byte is always
+    * a real one...
+    */
+
+    uint64_t diff  = load_word(line + i) ^ load_word(line + i + 1);
+    uint64_t zeros = (diff - ONES) & ~diff & HIGHS;
+
+    if (zeros)
+      return (i + (__builtin_ctzll(zeros) >> 3));
+
+    i += 8;
+  }
+#endif /* PCL_WORDS */
+
+  while (i < length && line[i] != line[i + 1])
+    i ++;
+
+  return (i);
+}
@@ -0,0 +1,40 @@
+/*
+ *   HP-PCL raster compression for CUPS.
+ *
+ *   Copyright 2007-2011 by Apple Inc.
+ *   Copyright 1993-2005 by Easy Software Products, All Rights Reserved.
+ *
+ *   These coded instructions, statements, and computer programs are the
+ *   property of Apple Inc. and are protected by Federal copyright
+ *   law.  Distribution and use rights are outlined in the file "COPYING"
+ *   which should have been included with this file.
+ */
+
+#ifndef _PCL_COMPRESS_H_
+#  define _PCL_COMPRESS_H_
+
+/*
+ * Size of the "\033*b#M" command to switch between modes 0, 2 and 3...
+ */
+
+#  define PCL_MODE_SWITCH_SIZE	5
+
+
+/*
+ * Functions...
+ *
+ * The output buffers must hold at least 2 * length + 16 bytes.
+ */
+
+extern int	pcl_compress_packbits(const unsigned char *line, int length,
+		                      unsigned char *comp);
+extern int	pcl_compress_delta(const unsigned char *line,
+		                   const unsigned char *seed, int length,
+				   unsigned char *comp);
+extern int	pcl_compress_best(const unsigned char *line,
+		                  const unsigned char *seed, int length,
+				  int max_mode, int cur_mode,
+				  unsigned char *comp[2],
+				  const unsigned char **data, int *datalen);
+
+#endif /* !_PCL_COMPRESS_H_ */
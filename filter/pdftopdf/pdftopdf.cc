@@ -20,7 +20,9 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <errno.h>
 
 #include "pdftopdf_processor.h"
 #include "pdftopdf_jcl.h"
@@ -304,6 +306,7 @@ static bool parseBorder(const char *val,BorderType &ret) // {{{
 void getParameters(ppd_file_t *ppd,int num_options,cups_option_t *options,ProcessingParameters &param) // {{{
 {
   const char *val;
+  ppd_attr_t *attr;
 
   if ((val = cupsGetOption("copies",num_options,options)) != NULL) {
     int copies = atoi(val);
@@ -562,6 +565,33 @@ void getParameters(ppd_file_t *ppd,int num_options,cups_option_t *options,Proces
     param.emitJCL=!is_false(val)&&(strcmp(val,"0")!=0);
   }
 
+  // smaller output for printers behind slow links
+  param.compressOutput=is_true(cupsGetOption("pdftopdf-compress-output",num_options,options));
+  param.stripResources=is_true(cupsGetOption("pdftopdf-strip-resources",num_options,options));
+
+  // tell the raster filter which pages are blank or monochrome
+  param.pageHints=is_true(cupsGetOption("pdftopdf-page-hints",num_options,options));
+
+  // instrumentation: per output page stats as JSON. The job only turns
+  // them on, the directory is up to the administrator and the file is new.
+  if (is_true(cupsGetOption("pdftopdf-stats",num_options,options)) ||
+      ((attr=ppdFindAttr(ppd,"pdftopdfStats",0)) != NULL && is_true(attr->value))) {
+    const char *dir=getenv("PDFTOPDF_STATS_DIR");
+    if ((!dir || !*dir) && (attr=ppdFindAttr(ppd,"pdftopdfStatsDir",0)) != NULL) {
+      dir=attr->value;
+    }
+    if (!dir || !*dir) {
+      dir="/var/tmp";
+    }
+    char name[1024];
+    snprintf(name,sizeof(name),"%s/pdftopdf-stats-%d-%d.json",
+             dir,param.jobId,(int)getpid());
+    param.statsFile=name;
+  }
+
+  // let the raster filter make the software copies from the rendered pages
+  param.rasterCopies=is_true(cupsGetOption("pdftopdf-raster-copies",num_options,options));
+
   param.booklet=BookletMode::BOOKLET_OFF;
   if ((val=cupsGetOption("booklet",num_options,options)) != NULL) {
     if (strcasecmp(val,"shuffle-only")==0) {
@@ -622,7 +652,6 @@ bool checkFeature(const char *feature, int num_options, cups_option_t *options)
   // make pages a multiple of two (only considered when duplex is on).
   // i.e. printer has hardware-duplex, but needs pre-inserted filler pages
   // FIXME? pdftopdf also supports it as cmdline option (via checkFeature())
-  ppd_attr_t *attr;
   if ((attr=ppdFindAttr(ppd,"cupsEvenDuplex",0)) != NULL) {
     param.evenDuplex=is_true(attr->value);
   }
@@ -863,6 +892,21 @@ void calculate(ppd_file_t *ppd,ProcessingParameters &param) // {{{
     param.numCopies=1; // disable sw copy
   }
 
+  // sw copies can only be left to the next filter if it renders the pages
+  // (gstoraster, pdftoraster, mupdftoraster)
+  if ((param.rasterCopies)&&(param.numCopies>1)) {
+    char *final_content_type=getenv("FINAL_CONTENT_TYPE");
+    if ((!final_content_type)||
+	((!strcasestr(final_content_type,"raster"))&&
+	 (!strcasestr(final_content_type,"/urf"))&&
+	 (!strcasestr(final_content_type,"/PCLm")))) {
+      fprintf(stderr,"DEBUG: pdftopdf: Output is not rendered, making copies in the PDF\n");
+      param.rasterCopies=false;
+    }
+  } else {
+    param.rasterCopies=false;
+  }
+
   if ((param.collate)&&(!param.deviceCollate)) { // software collate
     ppdMarkOption(ppd,"Collate","False"); // disable any hardware-collate (in JCL)
     param.evenDuplex=true; // fillers always needed
@@ -874,11 +918,77 @@ void calculate(ppd_file_t *ppd,ProcessingParameters &param) // {{{
 }
 // }}}
 
+// copies everything from infd to outfd; false on error
+static bool copy_fd(int infd,int outfd) // {{{
+{
+#ifdef HAVE_SPLICE
+  // stdin usually is a pipe from the previous filter: let the kernel move
+  // the pages into the file without a trip through user space
+  ssize_t n;
+  bool spliced=false;
+  while ((n=splice(infd,NULL,outfd,NULL,1<<20,SPLICE_F_MOVE|SPLICE_F_MORE)) != 0) {
+    if (n<0) {
+      if (errno==EINTR) {
+        continue;
+      }
+      if ((!spliced)&&((errno==EINVAL)||(errno==ESPIPE))) {
+        break; // not a pipe, do it the traditional way
+      }
+      return false;
+    }
+    spliced=true;
+  }
+  if (n==0) {
+    return true;
+  }
+#endif
+
+  const size_t bufsize=1<<18;
+  std::unique_ptr<char[]> buf(new char[bufsize]);
+  ssize_t n2;
+  while ((n2=read(infd,buf.get(),bufsize)) != 0) {
+    if (n2<0) {
+      if (errno==EINTR) {
+        continue;
+      }
+      return false;
+    }
+    const char *p=buf.get();
+    while (n2>0) {
+      ssize_t w=write(outfd,p,n2);
+      if (w<0) {
+        if (errno==EINTR) {
+          continue;
+        }
+        return false;
+      }
+      p+=w;
+      n2-=w;
+    }
+  }
+  return true;
+}
+// }}}
+
 // reads from stdin into temporary file. returns FILE *  or NULL on error
 FILE *copy_stdin_to_temp() // {{{
 {
   char buf[BUFSIZ];
-  int n;
+
+  // stdin redirected from a regular file: QPDF can seek in it directly,
+  // no need to copy the whole job first
+  struct stat st;
+  if ((fstat(0,&st)==0)&&(S_ISREG(st.st_mode))&&(lseek(0,0,SEEK_CUR)==0)) {
+    int fd=dup(0);
+    FILE *f;
+    if ((fd>=0)&&((f=fdopen(fd,"rb"))!=NULL)) {
+      fprintf(stderr,"DEBUG: pdftopdf: Reading seekable stdin directly\n");
+      return f;
+    }
+    if (fd>=0) {
+      close(fd);
+    }
+  }
 
   // FIXME:  what does >buf mean here?
   int fd=cupsTempFd(buf,sizeof(buf));
@@ -890,12 +1000,10 @@ FILE *copy_stdin_to_temp() // {{{
   unlink(buf);
 
   // copy stdin to the tmp file
-  while ((n=read(0,buf,BUFSIZ)) > 0) {
-    if (write(fd,buf,n) != n) {
-      error("Can't copy stdin to temporary file");
-      close(fd);
-      return NULL;
-    }
+  if (!copy_fd(0,fd)) {
+    error("Can't copy stdin to temporary file");
+    close(fd);
+    return NULL;
   }
   if (lseek(fd,0,SEEK_SET) < 0) {
     error("Can't rewind temporary file");
@@ -1192,8 +1300,12 @@ int main(int argc,char **argv)
     }
 
     /* If the input file contains a PDF form and we opted for not
-       using QPDF for flattening the form, we pipe the PDF through
-       pdftocairo or Ghostscript here */
+       using QPDF for flattening the form, we first try to paint the
+       appearance streams stored for the fields into the pages. Only
+       if some filled in field has none, so that it would need to be
+       rendered, we pipe the PDF through pdftocairo or Ghostscript */
+    if (!qpdf_flatten && proc->hasAcroForm() && proc->flattenFormFields())
+      fprintf(stderr, "DEBUG: PDF form flattened in-process using the fields' appearance streams\n");
     if (!qpdf_flatten && proc->hasAcroForm()) {
       /* Prepare the input file for being read by the form flattening
 	 process */
@@ -1304,7 +1416,9 @@ int main(int argc,char **argv)
     }
 */
 
-    if (!processPDFTOPDF(*proc,param)) {
+    std::vector<PageStats> stats;
+    const bool withStats=!param.statsFile.empty();
+    if (!processPDFTOPDF(*proc,param,(withStats)?&stats:NULL)) {
       ppdClose(ppd);
       return 2;
     }
@@ -1312,8 +1426,13 @@ int main(int argc,char **argv)
     emitPreamble(ppd,param); // ppdEmit, JCL stuff
     emitComment(*proc,param); // pass information to subsequent filters via PDF comments
 
+    const double emitStart=statsTime();
     //proc->emitFile(stdout);
     proc->emitFilename(NULL);
+    if (withStats) {
+      fflush(stdout);
+      writePageStats(param.statsFile.c_str(),stats,statsTime()-emitStart);
+    }
 
     emitPostamble(ppd,param);
     ppdClose(ppd);
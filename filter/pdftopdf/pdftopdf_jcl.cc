@@ -197,6 +197,54 @@ void emitComment(PDFTOPDF_Processor &proc,const ProcessingParameters &param) //
     }
   }
 
+  // software copies, to be made by *toraster from the rendered pages
+  if (param.rasterCopies) {
+    char buf[256];
+    snprintf(buf,sizeof(buf),"%d",param.numCopies);
+    output.push_back(std::string("%%PDFTOPDFRasterCopies : ")+buf);
+
+    if (param.collate) {
+      output.push_back("%%PDFTOPDFRasterCollate : true");
+    } else {
+      output.push_back("%%PDFTOPDFRasterCollate : false");
+    }
+  }
+
+  // one letter per page (B: blank, M: monochrome, C: color), runs of
+  // equal pages as letter+count, e.g. "M12BC3"
+  if (param.pageHints) {
+    static const char letter[3]={'B','M','C'};
+    const std::vector<PageContents> pages=proc.classifyPages();
+    std::string hints;
+    int blank=0,mono=0;
+    const int len=pages.size();
+    for (int iA=0;iA<len;) {
+      int iB=iA+1;
+      while ( (iB<len)&&(pages[iB]==pages[iA]) ) {
+        iB++;
+      }
+      hints.push_back(letter[pages[iA]]);
+      if (iB-iA>1) {
+        char buf[32];
+        snprintf(buf,sizeof(buf),"%d",iB-iA);
+        hints.append(buf);
+      }
+      if (pages[iA]==PAGE_BLANK) {
+        blank+=iB-iA;
+      } else if (pages[iA]==PAGE_MONO) {
+        mono+=iB-iA;
+      }
+      iA=iB;
+    }
+    fprintf(stderr,"DEBUG: pdftopdf: %d pages, %d blank, %d monochrome\n",
+            len,blank,mono);
+    if (hints.size()<=1000) { // the readers use fixed size line buffers
+      output.push_back("%%PDFTOPDFPageHints : "+hints);
+    } else {
+      fprintf(stderr,"DEBUG: pdftopdf: Too many changes between page types, no hints given\n");
+    }
+  }
+
   proc.setComments(output);
 }
 // }}}
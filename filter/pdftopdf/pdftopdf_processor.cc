@@ -28,6 +28,22 @@ bool ProcessingParameters::withPage(int outno) const // {{{
 }
 // }}}
 
+// shuffle[i] is the input page placed at position i; with nup cells per
+// sheet position i ends up on output page i/nup+1 (see NupState::nextPage)
+std::vector<bool> ProcessingParameters::selectedInputPages(const std::vector<int> &shuffle,int numOrigPages) const // {{{
+{
+  std::vector<bool> ret(numOrigPages,false);
+  const int nupcells=nup.nupX*nup.nupY;
+  const int len=shuffle.size();
+  for (int iA=0;iA<len;iA++) {
+    if ( (shuffle[iA]<numOrigPages)&&(withPage(iA/nupcells+1)) ) {
+      ret[shuffle[iA]]=true;
+    }
+  }
+  return ret;
+}
+// }}}
+
 void ProcessingParameters::dump() const // {{{
 {
   fprintf(stderr,"jobId: %d, numCopies: %d\n",
@@ -99,6 +115,15 @@ void ProcessingParameters::dump() const // {{{
 	  (deviceCollate)?"true":"false");
   fprintf(stderr,"setDuplex: %s\n",
 	  (setDuplex)?"true":"false");
+  fprintf(stderr,"rasterCopies: %s\n",
+	  (rasterCopies)?"true":"false");
+  fprintf(stderr,"compressOutput: %s, stripResources: %s\n",
+	  (compressOutput)?"true":"false",
+	  (stripResources)?"true":"false");
+  fprintf(stderr,"statsFile: %s\n",
+	  (statsFile.empty())?"(none)":statsFile.c_str());
+  fprintf(stderr,"pageHints: %s\n",
+	  (pageHints)?"true":"false");
 }
 // }}}
 
@@ -142,7 +167,35 @@ std::vector<int> bookletShuffle(int numPages,int signature) // {{{
 }
 // }}}
 
-bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param) // {{{
+// rotate/mirror the finished output page, add it and log it
+static void addOutputPage(PDFTOPDF_Processor &proc,const ProcessingParameters &param,const std::shared_ptr<PDFTOPDF_PageHandle> &curpage,int &outputno,std::vector<PageStats> *stats,PageStats &curstats) // {{{
+{
+  double start=(stats)?statsTime():0;
+  curpage->rotate(param.orientation);
+  if (param.mirror)
+    curpage->mirror();
+  // TODO? update rect? --- not needed any more
+  if (stats) {
+    const double now=statsTime();
+    curstats.finishTime+=now-start;
+    curpage->getStats(curstats); // not timed
+    start=statsTime();
+  }
+  proc.add_page(curpage,param.reverse); // reverse -> insert at beginning
+  // Log page in /var/log/cups/page_log
+  outputno++;
+  if (param.page_logging == 1)
+    fprintf(stderr, "PAGE: %d %d\n", outputno,
+	    param.copies_to_be_logged);
+  if (stats) {
+    curstats.finishTime+=statsTime()-start;
+    curstats.outputPage=outputno;
+    stats->push_back(curstats);
+  }
+}
+// }}}
+
+bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param,std::vector<PageStats> *stats) // {{{
 {
   if (!proc.check_print_permissions()) {
     fprintf(stderr,"Not allowed to print\n");
@@ -156,11 +209,9 @@ bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param) // {{
   if (param.paper_is_landscape)
     std::swap(param.nup.nupX, param.nup.nupY);
 
-  if (param.autoRotate)
-    proc.autoRotateAll(dst_lscape,param.normal_landscape);
+  proc.setCompression(param.compressOutput,param.stripResources);
 
-  std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> pages=proc.get_pages();
-  const int numOrigPages=pages.size();
+  const int numOrigPages=proc.get_num_pages();
 
   // TODO FIXME? elsewhere
   std::vector<int> shuffle;
@@ -176,7 +227,16 @@ bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param) // {{
     shuffle.resize(numOrigPages);
     std::iota(shuffle.begin(),shuffle.end(),0);
   }
-  const int numPages=std::max(shuffle.size(),pages.size());
+  const int numPages=std::max((int)shuffle.size(),numOrigPages);
+
+  // Only pages which end up on a selected output page get a handle,
+  // the others are never looked at (page-ranges on huge documents)
+  const std::vector<bool> wanted=param.selectedInputPages(shuffle,numOrigPages);
+
+  if (param.autoRotate)
+    proc.autoRotateAll(dst_lscape,param.normal_landscape,&wanted);
+
+  std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> pages=proc.get_pages(wanted);
 
   fprintf(stderr, "DEBUG: pdftopdf: \"print-scaling\" IPP attribute: %s\n",
 	  (param.autoprint ? "auto" :
@@ -197,6 +257,8 @@ bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param) // {{
 
     for (int i = 0; i < (int)pages.size(); i ++)
     {
+      if (!pages[i])
+	continue;
       PageRect r = pages[i]->getRect();
       int w = r.width * 100 / 102; // 2% of tolerance
       int h = r.height * 100 / 102;
@@ -255,10 +317,17 @@ bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param) // {{
     param.page.top = param.page.height;
   }
 
+  std::vector<double> cropTimes; // per input page, only with stats
+  if (stats)
+    cropTimes.resize(pages.size(),0);
+
   if(param.fillprint||param.cropfit){
     for(int i=0;i<(int)pages.size();i++)
     {
       std::shared_ptr<PDFTOPDF_PageHandle> page = pages[i];
+      if (!page)
+	continue;
+      const double start=(stats)?statsTime():0;
       Rotation orientation;
       if (page->is_landscape(param.orientation))
 	orientation = param.normal_landscape;
@@ -267,6 +336,8 @@ bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param) // {{
       page->crop(param.page, orientation, param.orientation,
 		 param.xpos, param.ypos,
 		 !param.cropfit, param.autoRotate);
+      if (stats)
+	cropTimes[i]=statsTime()-start;
     }
     if (param.fillprint)
       param.fitplot = true;
@@ -319,6 +390,7 @@ bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param) // {{
 
   NupState nupstate(param.nup);
   NupPageEdit pgedit;
+  PageStats curstats;
   for (int iA=0;iA<numPages;iA++) {
     std::shared_ptr<PDFTOPDF_PageHandle> page;
     if (shuffle[iA] >= numOrigPages)
@@ -328,29 +400,30 @@ bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param) // {{
       page=pages[shuffle[iA]];
 
     PageRect rect;
-    rect = page->getRect();
+    if (page) {
+      rect = page->getRect();
+    } else { // not selected, only advance the nup state
+      rect.width = param.page.width;
+      rect.height = param.page.height;
+    }
     //rect.dump();
 
     bool newPage=nupstate.nextPage(rect.width,rect.height,pgedit);
     if (newPage) {
       if ((curpage)&&(param.withPage(outputpage))) {
-	curpage->rotate(param.orientation);
-	if (param.mirror)
-	  curpage->mirror();
-	// TODO? update rect? --- not needed any more
-	proc.add_page(curpage,param.reverse); // reverse -> insert at beginning
-	// Log page in /var/log/cups/page_log
-	outputno++;
-	if (param.page_logging == 1)
-	  fprintf(stderr, "PAGE: %d %d\n", outputno,
-		  param.copies_to_be_logged);
+	addOutputPage(proc,param,curpage,outputno,stats,curstats);
       }
-      curpage=proc.new_page(param.page.width,param.page.height);
+      curstats=PageStats();
       outputpage++;
+      if (param.withPage(outputpage))
+	curpage=proc.new_page(param.page.width,param.page.height);
+      else // will be dropped anyway, don't build it
+	curpage.reset();
     }
-    if (shuffle[iA]>=numOrigPages) {
+    if ((shuffle[iA]>=numOrigPages)||(!page)) {
       continue;
     }
+    const double start=(stats)?statsTime():0;
 
     if (param.border!=BorderType::NONE) {
       // TODO FIXME... border gets cutted away, if orignal page had wrong size
@@ -395,29 +468,36 @@ bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param) // {{
     }
 #endif
 
+    if (stats) {
+      curstats.placeTime+=statsTime()-start;
+      curstats.cropTime+=cropTimes[shuffle[iA]];
+      curstats.inputPages.push_back(shuffle[iA]+1);
+    }
+
     // pgedit.dump();
   }
   if ((curpage)&&(param.withPage(outputpage))) {
-    curpage->rotate(param.orientation);
-    if (param.mirror) {
-      curpage->mirror();
-    }
-    proc.add_page(curpage,param.reverse); // reverse -> insert at beginning
-    // Log page in /var/log/cups/page_log
-    outputno ++;
-    if (param.page_logging == 1)
-      fprintf(stderr, "PAGE: %d %d\n", outputno, param.copies_to_be_logged);
+    addOutputPage(proc,param,curpage,outputno,stats,curstats);
   }
 
   if ((param.evenDuplex || !param.oddPages) && (outputno & 1)) {
     // need to output empty page to not confuse duplex
-    proc.add_page(proc.new_page(param.page.width,param.page.height),param.reverse);
+    std::shared_ptr<PDFTOPDF_PageHandle> filler=proc.new_page(param.page.width,param.page.height);
+    if (stats) {
+      PageStats fillerstats;
+      filler->getStats(fillerstats);
+      fillerstats.outputPage=outputno+1;
+      stats->push_back(fillerstats);
+    }
+    proc.add_page(filler,param.reverse);
     // Log page in /var/log/cups/page_log
     if (param.page_logging == 1)
       fprintf(stderr, "PAGE: %d %d\n", outputno + 1, param.copies_to_be_logged);
   }
 
-  proc.multiply(param.numCopies,param.collate);
+  if (!param.rasterCopies) {
+    proc.multiply(param.numCopies,param.collate);
+  } // else: the document goes out once, see emitComment()
 
   return true;
 }
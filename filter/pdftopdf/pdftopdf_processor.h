@@ -4,11 +4,15 @@
 #include "pptypes.h"
 #include "nup.h"
 #include "intervalset.h"
+#include "pdftopdf_stats.h"
 #include <vector>
 #include <string>
 
 enum BookletMode { BOOKLET_OFF, BOOKLET_ON, BOOKLET_JUSTSHUFFLE };
 
+// what a page paints: nothing (or only white), only gray/black, anything
+enum PageContents { PAGE_BLANK, PAGE_MONO, PAGE_COLOR };
+
 struct ProcessingParameters {
 ProcessingParameters()
 : jobId(0),numCopies(1),
@@ -42,8 +46,13 @@ ProcessingParameters()
 
     emitJCL(true),deviceCopies(1),
     deviceCollate(false),setDuplex(false),
+    rasterCopies(false),
+
+    page_logging(-1),
+
+    compressOutput(false),stripResources(false),
 
-    page_logging(-1)
+    pageHints(false)
   {
     page.width=612.0; // letter
     page.height=792.0;
@@ -96,13 +105,23 @@ ProcessingParameters()
   int deviceCopies;
   bool deviceCollate;
   bool setDuplex;
+  bool rasterCopies; // numCopies are made by the raster filter from the rendered pages
   // unsetMirror  (always)
 
   int page_logging;
   int copies_to_be_logged;
 
+  // output size (slow links to the printer)
+  bool compressOutput; // object streams, xref stream, flate everything
+  bool stripResources; // drop resources the page content does not use
+
+  std::string statsFile; // per output page stats as JSON; empty: off
+
+  bool pageHints; // classify the output pages for the raster filter, see emitComment()
+
   // helper functions
   bool withPage(int outno) const; // 1 based
+  std::vector<bool> selectedInputPages(const std::vector<int> &shuffle,int numOrigPages) const;
   void dump() const;
 };
 
@@ -124,6 +143,8 @@ class PDFTOPDF_PageHandle {
   virtual void mirror() =0;
   virtual void rotate(Rotation rot) =0;
   virtual void add_label(const PageRect &rect, const std::string label) =0;
+  // adds to stats; must be called before the page is passed to add_page()
+  virtual void getStats(PageStats &stats) =0;
 };
 
 // TODO: ... error output?
@@ -138,7 +159,10 @@ class PDFTOPDF_Processor { // abstract interface
   // TODO? virtual bool may_modify/may_print/?
   virtual bool check_print_permissions() =0;
 
+  virtual int get_num_pages() =0;
   virtual std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> get_pages() =0; // shared_ptr because of type erasure (deleter)
+  // only pages with wanted[i] get a handle, the others stay NULL and are never touched
+  virtual std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> get_pages(const std::vector<bool> &wanted) =0;
 
   virtual std::shared_ptr<PDFTOPDF_PageHandle> new_page(float width,float height) =0;
 
@@ -148,15 +172,21 @@ class PDFTOPDF_Processor { // abstract interface
 
   virtual void multiply(int copies,bool collate) =0;
 
-  virtual void autoRotateAll(bool dst_lscape,Rotation normal_landscape) =0; // TODO elsewhere?!
+  virtual void autoRotateAll(bool dst_lscape,Rotation normal_landscape,const std::vector<bool> *wanted=NULL) =0; // TODO elsewhere?!
   virtual void addCM(const char *defaulticc,const char *outputicc) =0;
 
   virtual void setComments(const std::vector<std::string> &comments) =0;
+  // of the output pages, in output order (i.e. after add_page()/multiply())
+  virtual std::vector<PageContents> classifyPages() =0;
+  // must be called before get_pages(); compress applies to emitFile/emitFilename
+  virtual void setCompression(bool compress,bool strip_resources) =0;
 
   virtual void emitFile(FILE *dst,ArgOwnership take=WillStayAlive) =0;
   virtual void emitFilename(const char *name) =0; // NULL -> stdout
 
   virtual bool hasAcroForm() =0;
+  // in-process, from the stored appearance streams; false: form is left as is
+  virtual bool flattenFormFields() =0;
 };
 
 class PDFTOPDF_Factory {
@@ -169,6 +199,7 @@ class PDFTOPDF_Factory {
 std::vector<int> bookletShuffle(int numPages,int signature=-1);
 
 // This is all we want:
-bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param);
+// stats: one entry per output page (before multiply()) is appended, NULL: off
+bool processPDFTOPDF(PDFTOPDF_Processor &proc,ProcessingParameters &param,std::vector<PageStats> *stats=NULL);
 
 #endif
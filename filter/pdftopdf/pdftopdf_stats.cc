@@ -0,0 +1,56 @@
+#include "pdftopdf_stats.h"
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+double statsTime() // {{{
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec+ts.tv_nsec/1e9;
+}
+// }}}
+
+bool writePageStats(const char *filename,const std::vector<PageStats> &stats,double emitTime) // {{{
+{
+  // never an existing file, nor through a symlink
+  int fd=open(filename,O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW,0644);
+  FILE *f=(fd>=0)?fdopen(fd,"w"):NULL;
+  if (!f) {
+    if (fd>=0) {
+      close(fd);
+    }
+    fprintf(stderr,"ERROR: pdftopdf: Cannot write page stats to %s: %s\n",
+            filename,strerror(errno));
+    return false;
+  }
+
+  fprintf(f,"{\n  \"emit_seconds\": %.6f,\n  \"pages\": [",emitTime);
+  const int len=stats.size();
+  for (int iA=0;iA<len;iA++) {
+    const PageStats &ps=stats[iA];
+    fprintf(f,"%s\n    {\"page\": %d, \"input_pages\": [",
+            (iA)?",":"",ps.outputPage);
+    const int ilen=ps.inputPages.size();
+    for (int iB=0;iB<ilen;iB++) {
+      fprintf(f,"%s%d",(iB)?", ":"",ps.inputPages[iB]);
+    }
+    fprintf(f,"], \"content_bytes\": %ld, \"xobjects\": %d, \"fonts\": %d, \"images\": %d, "
+            "\"crop_seconds\": %.6f, \"add_subpage_seconds\": %.6f, \"finish_seconds\": %.6f}",
+            ps.contentBytes,ps.xobjects,ps.fonts,ps.images,
+            ps.cropTime,ps.placeTime,ps.finishTime);
+  }
+  fprintf(f,"%s]\n}\n",(len)?"\n  ":"");
+
+  if (fclose(f)!=0) {
+    fprintf(stderr,"ERROR: pdftopdf: Cannot write page stats to %s: %s\n",
+            filename,strerror(errno));
+    return false;
+  }
+  fprintf(stderr,"DEBUG: pdftopdf: Page stats written to %s\n",filename);
+  return true;
+}
+// }}}
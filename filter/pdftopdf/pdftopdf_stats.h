@@ -0,0 +1,34 @@
+#ifndef PDFTOPDF_STATS_H
+#define PDFTOPDF_STATS_H
+
+#include <vector>
+
+// Instrumentation (pdftopdf-stats): what went into one output page
+struct PageStats {
+  PageStats()
+    : outputPage(0),
+      contentBytes(0),xobjects(0),fonts(0),images(0),
+      cropTime(0),placeTime(0),finishTime(0)
+  {}
+
+  int outputPage; // 1 based, as in the PAGE: lines
+  std::vector<int> inputPages; // 1 based
+
+  // filled by PDFTOPDF_PageHandle::getStats()
+  long contentBytes;
+  int xobjects; // placed form xobjects
+  int fonts,images; // distinct ones, also inside the xobjects
+
+  // seconds
+  double cropTime;   // crop()/scale to fill of the input pages
+  double placeTime;  // border, label, add_subpage() (scale into the nup cell)
+  double finishTime; // rotate, mirror, add_page()
+};
+
+double statsTime(); // monotonic, seconds
+
+// filename: created, must not exist yet
+// emitTime: QPDFWriter works on the whole document, not per page
+bool writePageStats(const char *filename,const std::vector<PageStats> &stats,double emitTime);
+
+#endif
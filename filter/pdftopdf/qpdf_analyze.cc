@@ -0,0 +1,428 @@
+#include "qpdf_analyze.h"
+#include <stdio.h>
+#include <math.h>
+#include <stdexcept>
+
+namespace {
+
+// What is found out about a page (or form xobject)
+enum { MARKS=1, COLOR=2 };
+
+// Everything painted in white (on white paper) does not count as mark.
+// Chromatic means: not representable by a single (gray) ink.
+enum ColorKind { CK_GRAY, CK_SEPGRAY, CK_MONO, CK_RGB, CK_CMYK, CK_COLOR };
+
+struct ScanColor {
+  ScanColor() : kind(CK_GRAY),chromatic(false),white(false) {} // black
+  ScanColor(ColorKind kind) : kind(kind),chromatic((kind==CK_RGB)||(kind==CK_CMYK)||(kind==CK_COLOR)),white(false) {}
+
+  ColorKind kind;
+  bool chromatic,white;
+};
+
+struct ScanState {
+  ScanState() : textMode(0) {}
+
+  ScanColor fill,stroke;
+  int textMode;
+
+  int key() const {
+    return fill.kind|(fill.chromatic<<3)|(fill.white<<4)|
+      (stroke.kind<<5)|(stroke.chromatic<<8)|(stroke.white<<9)|(textMode<<10);
+  }
+};
+
+struct ScanDone {}; // marks and color found: nothing more to learn
+
+class ContentScanner : public QPDFObjectHandle::ParserCallbacks {
+ public:
+  ContentScanner(QPDFObjectHandle resources,const ScanState &gs,int depth,PageClassifier::form_memo_t &forms,int &result)
+    : resources(resources),gs(gs),depth(depth),forms(forms),result(result)
+  {}
+
+  virtual void handleObject(QPDFObjectHandle obj);
+  virtual void handleEOF() {}
+ private:
+  void paint(const ScanColor &col);
+  void paintText();
+  void setSpace(ScanColor &col);
+  void setColor(ScanColor &col,ColorKind kind);
+  void doXObject();
+  void doShading();
+  void doInlineImage();
+
+  ColorKind spaceKind(QPDFObjectHandle cs,int level=0);
+  QPDFObjectHandle resource(const char *category,QPDFObjectHandle name);
+ private:
+  QPDFObjectHandle resources;
+  ScanState gs;
+  std::vector<ScanState> stack;
+  std::vector<QPDFObjectHandle> operands;
+  int depth;
+  PageClassifier::form_memo_t &forms;
+  int &result;
+};
+
+} // namespace
+
+void ContentScanner::handleObject(QPDFObjectHandle obj) // {{{
+{
+  if (!obj.isOperator()) {
+    operands.push_back(obj);
+    return;
+  }
+  const std::string op=obj.getOperatorValue();
+
+  if ( (op=="f")||(op=="F")||(op=="f*") ) {
+    paint(gs.fill);
+  } else if ( (op=="S")||(op=="s") ) {
+    paint(gs.stroke);
+  } else if ( (op=="B")||(op=="B*")||(op=="b")||(op=="b*") ) {
+    paint(gs.fill);
+    paint(gs.stroke);
+  } else if ( (op=="Tj")||(op=="TJ")||(op=="'")||(op=="\"") ) {
+    paintText();
+  } else if (op=="Do") {
+    doXObject();
+  } else if (op=="sh") {
+    doShading();
+  } else if (op=="ID") { // the inline image's dictionary are the "operands"
+    doInlineImage();
+  } else if (op=="q") {
+    stack.push_back(gs);
+  } else if (op=="Q") {
+    if (!stack.empty()) {
+      gs=stack.back();
+      stack.pop_back();
+    }
+  } else if (op=="Tr") {
+    if ( (operands.size()==1)&&(operands[0].isInteger()) ) {
+      gs.textMode=operands[0].getIntValue()&7;
+    }
+  } else if (op=="g") {
+    setColor(gs.fill,CK_GRAY);
+  } else if (op=="G") {
+    setColor(gs.stroke,CK_GRAY);
+  } else if (op=="rg") {
+    setColor(gs.fill,CK_RGB);
+  } else if (op=="RG") {
+    setColor(gs.stroke,CK_RGB);
+  } else if (op=="k") {
+    setColor(gs.fill,CK_CMYK);
+  } else if (op=="K") {
+    setColor(gs.stroke,CK_CMYK);
+  } else if ( (op=="sc")||(op=="scn") ) {
+    setColor(gs.fill,gs.fill.kind);
+  } else if ( (op=="SC")||(op=="SCN") ) {
+    setColor(gs.stroke,gs.stroke.kind);
+  } else if (op=="cs") {
+    setSpace(gs.fill);
+  } else if (op=="CS") {
+    setSpace(gs.stroke);
+  }
+  operands.clear();
+}
+// }}}
+
+void ContentScanner::paint(const ScanColor &col) // {{{
+{
+  if (!col.white) {
+    result|=MARKS;
+  }
+  if (col.chromatic) {
+    result|=COLOR;
+  }
+  if (result==(MARKS|COLOR)) {
+    throw ScanDone();
+  }
+}
+// }}}
+
+void ContentScanner::paintText() // {{{
+{
+  switch (gs.textMode) {
+  case 0: case 4: // fill
+    paint(gs.fill);
+    break;
+  case 1: case 5: // stroke
+    paint(gs.stroke);
+    break;
+  case 2: case 6:
+    paint(gs.fill);
+    paint(gs.stroke);
+    break;
+  default: // 3: invisible, 7: clip only
+    break;
+  }
+}
+// }}}
+
+QPDFObjectHandle ContentScanner::resource(const char *category,QPDFObjectHandle name) // {{{
+{
+  if ( (resources.isDictionary())&&(name.isName()) ) {
+    QPDFObjectHandle dict=resources.getKey(category);
+    if (dict.isDictionary()) {
+      return dict.getKey(name.getName());
+    }
+  }
+  return QPDFObjectHandle::newNull();
+}
+// }}}
+
+ColorKind ContentScanner::spaceKind(QPDFObjectHandle cs,int level) // {{{
+{
+  if (level>4) {
+    return CK_COLOR;
+  }
+  if (cs.isName()) {
+    const std::string name=cs.getName();
+    if ( (name=="/DeviceGray")||(name=="/G")||(name=="/CalGray") ) {
+      return CK_GRAY;
+    } else if ( (name=="/DeviceRGB")||(name=="/RGB") ) {
+      return CK_RGB;
+    } else if ( (name=="/DeviceCMYK")||(name=="/CMYK") ) {
+      return CK_CMYK;
+    } else if (name=="/Pattern") {
+      return CK_COLOR;
+    }
+    QPDFObjectHandle named=resource("/ColorSpace",cs);
+    return (named.isNull())?CK_COLOR:spaceKind(named,level+1);
+  } else if ( (!cs.isArray())||(cs.getArrayNItems()<1) ) {
+    return CK_COLOR;
+  }
+
+  QPDFObjectHandle family=cs.getArrayItem(0);
+  if (!family.isName()) {
+    return CK_COLOR;
+  }
+  const std::string name=family.getName();
+  const int len=cs.getArrayNItems();
+  if (len==1) { // e.g. [/DeviceGray]
+    return spaceKind(family,level+1);
+  } else if (name=="/CalGray") {
+    return CK_GRAY;
+  } else if (name=="/CalRGB") {
+    return CK_RGB;
+  } else if (name=="/ICCBased") {
+    QPDFObjectHandle profile=cs.getArrayItem(1);
+    if (profile.isStream()) {
+      QPDFObjectHandle n=profile.getDict().getKey("/N");
+      if (n.isInteger()) {
+        switch (n.getIntValue()) {
+        case 1: return CK_GRAY;
+        case 3: return CK_RGB;
+        case 4: return CK_CMYK;
+        }
+      }
+    }
+  } else if ( (name=="/Indexed")||(name=="/I") ) {
+    // the components are indices, the colors need not be white or black
+    const ColorKind base=spaceKind(cs.getArrayItem(1),level+1);
+    if ( (base==CK_GRAY)||(base==CK_SEPGRAY)||(base==CK_MONO) ) {
+      return CK_MONO;
+    }
+  } else if (name=="/Separation") {
+    QPDFObjectHandle colorant=cs.getArrayItem(1);
+    if (colorant.isName()) {
+      if ( (colorant.getName()=="/Black")||(colorant.getName()=="/Gray") ) {
+        return CK_SEPGRAY;
+      } else if (colorant.getName()=="/All") { // registration marks
+        return CK_MONO;
+      }
+    }
+  }
+  return CK_COLOR; // /Lab, /DeviceN, spot colors, /Pattern, ...
+}
+// }}}
+
+void ContentScanner::setSpace(ScanColor &col) // {{{
+{
+  if (operands.size()!=1) {
+    col=ScanColor(CK_COLOR);
+    return;
+  }
+  col=ScanColor(spaceKind(operands[0]));
+  if (col.kind!=CK_COLOR) { // initial color: black
+    col.chromatic=false;
+  }
+}
+// }}}
+
+void ContentScanner::setColor(ScanColor &col,ColorKind kind) // {{{
+{
+  static const double eps=1.0/255;
+
+  std::vector<double> c;
+  const int len=operands.size();
+  for (int iA=0;iA<len;iA++) {
+    if (!operands[iA].isNumber()) { // e.g. scn with pattern name
+      col=ScanColor(CK_COLOR);
+      return;
+    }
+    c.push_back(operands[iA].getNumericValue());
+  }
+
+  col=ScanColor(kind);
+  switch (kind) {
+  case CK_GRAY:
+    col.white=(c.size()==1)&&(c[0]>=1-eps);
+    break;
+  case CK_SEPGRAY: // tint
+    col.white=(c.size()==1)&&(c[0]<=eps);
+    break;
+  case CK_RGB:
+    if (c.size()==3) {
+      col.chromatic=(fabs(c[0]-c[1])>eps)||(fabs(c[1]-c[2])>eps);
+      col.white=(c[0]>=1-eps)&&(c[1]>=1-eps)&&(c[2]>=1-eps);
+    }
+    break;
+  case CK_CMYK:
+    if (c.size()==4) {
+      col.chromatic=(fabs(c[0]-c[1])>eps)||(fabs(c[1]-c[2])>eps);
+      col.white=(c[0]<=eps)&&(c[1]<=eps)&&(c[2]<=eps)&&(c[3]<=eps);
+    }
+    break;
+  case CK_MONO:
+  case CK_COLOR:
+    break;
+  }
+}
+// }}}
+
+void ContentScanner::doXObject() // {{{
+{
+  if (operands.empty()) {
+    return;
+  }
+  QPDFObjectHandle xobj=resource("/XObject",operands.back());
+  if (!xobj.isStream()) {
+    return;
+  }
+  QPDFObjectHandle dict=xobj.getDict();
+  QPDFObjectHandle subtype=dict.getKey("/Subtype");
+  if (!subtype.isName()) {
+    return;
+  }
+
+  if (subtype.getName()=="/Image") {
+    QPDFObjectHandle mask=dict.getKey("/ImageMask");
+    if ( (mask.isBool())&&(mask.getBoolValue()) ) { // painted with the fill color
+      paint(gs.fill);
+    } else {
+      QPDFObjectHandle cs=dict.getKey("/ColorSpace");
+      paint(ScanColor((cs.isNull())?CK_COLOR:spaceKind(cs))); // no /ColorSpace: JPX
+    }
+    return;
+  } else if (subtype.getName()!="/Form") {
+    return;
+  }
+
+  if (depth>=16) { // give up
+    paint(ScanColor(CK_COLOR));
+    return;
+  }
+  const PageClassifier::form_memo_t::key_type key(xobj.getObjGen(),gs.key());
+  if (xobj.isIndirect()) {
+    PageClassifier::form_memo_t::const_iterator it=forms.find(key);
+    if (it!=forms.end()) {
+      result|=it->second;
+      if (result==(MARKS|COLOR)) {
+        throw ScanDone();
+      }
+      return;
+    }
+  }
+
+  QPDFObjectHandle formres=dict.getKey("/Resources");
+  if (!formres.isDictionary()) { // old files: inherited from the page
+    formres=resources;
+  }
+  int formresult=0;
+  ContentScanner sub(formres,gs,depth+1,forms,formresult);
+  try {
+    QPDFObjectHandle::parseContentStream(xobj,&sub);
+  } catch (ScanDone &) {
+    result|=formresult;
+    throw;
+  }
+  if (xobj.isIndirect()) {
+    forms[key]=formresult;
+  }
+  result|=formresult;
+  if (result==(MARKS|COLOR)) {
+    throw ScanDone();
+  }
+}
+// }}}
+
+void ContentScanner::doShading() // {{{
+{
+  if (operands.empty()) {
+    return;
+  }
+  QPDFObjectHandle shading=resource("/Shading",operands.back());
+  if (shading.isStream()) {
+    shading=shading.getDict();
+  }
+  if (!shading.isDictionary()) {
+    return;
+  }
+  paint(ScanColor(spaceKind(shading.getKey("/ColorSpace"))));
+}
+// }}}
+
+void ContentScanner::doInlineImage() // {{{
+{
+  QPDFObjectHandle cs=QPDFObjectHandle::newNull();
+  bool mask=false;
+  const int len=operands.size();
+  for (int iA=0;iA+1<len;iA+=2) {
+    if (!operands[iA].isName()) {
+      continue;
+    }
+    const std::string key=operands[iA].getName();
+    if ( (key=="/IM")||(key=="/ImageMask") ) {
+      mask=(operands[iA+1].isBool())&&(operands[iA+1].getBoolValue());
+    } else if ( (key=="/CS")||(key=="/ColorSpace") ) {
+      cs=operands[iA+1];
+    }
+  }
+  if (mask) {
+    paint(gs.fill);
+  } else {
+    paint(ScanColor((cs.isNull())?CK_COLOR:spaceKind(cs)));
+  }
+}
+// }}}
+
+PageContents PageClassifier::classify(QPDFObjectHandle page) // {{{
+{
+  const QPDFObjGen og=page.getObjGen();
+  std::map<QPDFObjGen,PageContents>::const_iterator it=pages.find(og);
+  if (it!=pages.end()) { // copies
+    return it->second;
+  }
+
+  int result=0;
+  ContentScanner scanner(page.getKey("/Resources"),ScanState(),0,forms,result);
+  try {
+    QPDFObjectHandle contents=page.getKey("/Contents");
+    if ( (contents.isStream())||(contents.isArray()) ) {
+      QPDFObjectHandle::parseContentStream(contents,&scanner);
+    }
+  } catch (ScanDone &) {
+  } catch (std::exception &e) {
+    fprintf(stderr,"DEBUG: pdftopdf: Cannot analyze page contents (%s), assuming color\n",e.what());
+    result=MARKS|COLOR;
+  }
+
+  PageContents ret=PAGE_COLOR;
+  if (!(result&MARKS)) {
+    ret=PAGE_BLANK;
+  } else if (!(result&COLOR)) {
+    ret=PAGE_MONO;
+  }
+  pages[og]=ret;
+  return ret;
+}
+// }}}
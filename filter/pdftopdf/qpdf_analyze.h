@@ -0,0 +1,22 @@
+#ifndef QPDF_ANALYZE_H_
+#define QPDF_ANALYZE_H_
+
+#include <qpdf/QPDFObjectHandle.hh>
+#include <map>
+#include "pdftopdf_processor.h"
+
+// Finds out what a page paints by scanning its content stream (and those
+// of the form xobjects it uses). Conservative: whatever cannot be told
+// for sure (patterns, DeviceN, RGB images, ...) counts as color.
+class PageClassifier {
+ public:
+  PageContents classify(QPDFObjectHandle page);
+
+  // form xobject results depend on the inherited colors: key includes them
+  typedef std::map<std::pair<QPDFObjGen,int>,int> form_memo_t;
+ private:
+  form_memo_t forms;
+  std::map<QPDFObjGen,PageContents> pages;
+};
+
+#endif
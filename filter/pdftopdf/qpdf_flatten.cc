@@ -0,0 +1,227 @@
+#include "qpdf_flatten.h"
+#include <qpdf/QUtil.hh>
+#include <qpdf/Constants.h>
+#include <algorithm>
+#include "qpdf_pdftopdf.h"
+
+// Only the appearance streams already stored in the file are used (as
+// a viewer shows them): text fields, check boxes, radio buttons, push
+// buttons, choice fields and signature widgets all carry one once they
+// were filled in. Fields without one would have to be rendered from
+// /V and /DA, which is left to pdftocairo / Ghostscript.
+
+// /FT, /V, ... are inheritable from the parent fields
+static QPDFObjectHandle fieldAttr(QPDFObjectHandle field,const char *key) // {{{
+{
+  for (int depth=0;(depth<32)&&(field.isDictionary());depth++) { // depth: guard against /Parent loops
+    if (field.hasKey(key)) {
+      return field.getKey(key);
+    }
+    field=field.getKey("/Parent");
+  }
+  return QPDFObjectHandle::newNull();
+}
+// }}}
+
+static bool getNumbers(QPDFObjectHandle ar,double *ret,int len) // {{{
+{
+  if ( (!ar.isArray())||(ar.getArrayNItems()!=len) ) {
+    return false;
+  }
+  for (int iA=0;iA<len;iA++) {
+    QPDFObjectHandle num=ar.getArrayItem(iA);
+    if (!num.isNumber()) {
+      return false;
+    }
+    ret[iA]=num.getNumericValue();
+  }
+  return true;
+}
+// }}}
+
+static bool isPrinted(QPDFObjectHandle annot) // {{{
+{
+  QPDFObjectHandle flags=annot.getKey("/F");
+  const int f=(flags.isInteger())?flags.getIntValue():0;
+  return (f&an_print)&&!(f&an_hidden);
+}
+// }}}
+
+static bool isWidget(QPDFObjectHandle annot) // {{{
+{
+  QPDFObjectHandle subtype=annot.getKey("/Subtype");
+  return (subtype.isName())&&(subtype.getName()=="/Widget");
+}
+// }}}
+
+// normal appearance in the annotation's current state, null: nothing to paint
+static QPDFObjectHandle normalAppearance(QPDFObjectHandle annot) // {{{
+{
+  QPDFObjectHandle ap=annot.getKey("/AP");
+  if (!ap.isDictionary()) {
+    return QPDFObjectHandle::newNull();
+  }
+  QPDFObjectHandle ret=ap.getKey("/N");
+  if (ret.isDictionary()) { // check boxes, radio buttons: one per state
+    QPDFObjectHandle as=annot.getKey("/AS");
+    if (!as.isName()) {
+      return QPDFObjectHandle::newNull();
+    }
+    ret=ret.getKey(as.getName());
+  }
+  double bbox[4];
+  if ( (!ret.isStream())||(!getNumbers(ret.getDict().getKey("/BBox"),bbox,4)) ) {
+    return QPDFObjectHandle::newNull();
+  }
+  return ret;
+}
+// }}}
+
+// a filled in field without usable normal appearance, flattenPage() would drop it
+static bool needsRendering(QPDFObjectHandle annot) // {{{
+{
+  if ( (!isWidget(annot))||(!isPrinted(annot))||(!normalAppearance(annot).isNull()) ) {
+    return false;
+  }
+  QPDFObjectHandle value=fieldAttr(annot,"/V");
+  if (value.isNull()) {
+    return false;
+  } else if (value.isString()) {
+    return !value.getStringValue().empty();
+  } else if (value.isName()) {
+    return value.getName()!="/Off";
+  }
+  return true;
+}
+// }}}
+
+// PDF 32000-1, 12.5.5: map the transformed /BBox onto /Rect
+static std::string placeAppearance(QPDFObjectHandle annot,QPDFObjectHandle ap,const std::string &xoname) // {{{
+{
+  QPDFObjectHandle dict=ap.getDict();
+  double bbox[4],rect[4],m[6]={1,0,0,1,0,0};
+  if ( (!getNumbers(dict.getKey("/BBox"),bbox,4))||
+       (!getNumbers(annot.getKey("/Rect"),rect,4)) ) {
+    return std::string();
+  }
+  getNumbers(dict.getKey("/Matrix"),m,6); // optional
+
+  double minx=0,miny=0,maxx=0,maxy=0;
+  for (int iA=0;iA<4;iA++) {
+    const double x=bbox[(iA&1)?2:0],y=bbox[(iA&2)?3:1];
+    const double tx=m[0]*x+m[2]*y+m[4],ty=m[1]*x+m[3]*y+m[5];
+    if ( (iA==0)||(tx<minx) ) minx=tx;
+    if ( (iA==0)||(tx>maxx) ) maxx=tx;
+    if ( (iA==0)||(ty<miny) ) miny=ty;
+    if ( (iA==0)||(ty>maxy) ) maxy=ty;
+  }
+  const double left=std::min(rect[0],rect[2]),bottom=std::min(rect[1],rect[3]);
+  const double width=std::max(rect[0],rect[2])-left,height=std::max(rect[1],rect[3])-bottom;
+  if ( (maxx-minx<=0)||(maxy-miny<=0)||(width<=0)||(height<=0) ) {
+    return std::string();
+  }
+
+  if (!dict.hasKey("/Subtype")) { // sloppy, but common
+    dict.replaceKey("/Subtype",QPDFObjectHandle::newName("/Form"));
+  }
+
+  Matrix mtx;
+  mtx.translate(left,bottom);
+  mtx.scale(width/(maxx-minx),height/(maxy-miny));
+  mtx.translate(-minx,-miny);
+
+  return std::string("q\n")+mtx.get_string()+" cm\n"+xoname+" Do\nQ\n";
+}
+// }}}
+
+static void flattenPage(QPDF &pdf,QPDFObjectHandle page) // {{{
+{
+  QPDFObjectHandle annots=page.getKey("/Annots");
+  if (!annots.isArray()) {
+    return;
+  }
+
+  // resources may be shared with other pages: copy before modifying
+  QPDFObjectHandle resources=page.getKey("/Resources");
+  resources=(resources.isDictionary())?resources.shallowCopy():QPDFObjectHandle::newDictionary();
+  QPDFObjectHandle xobjects=resources.getKey("/XObject");
+  xobjects=(xobjects.isDictionary())?xobjects.shallowCopy():QPDFObjectHandle::newDictionary();
+
+  std::string content;
+  std::vector<QPDFObjectHandle> keep;
+  int num=0;
+  const int len=annots.getArrayNItems();
+  for (int iA=0;iA<len;iA++) {
+    QPDFObjectHandle annot=annots.getArrayItem(iA);
+    if (!annot.isDictionary()) {
+      continue;
+    }
+    QPDFObjectHandle ap=(isPrinted(annot))?normalAppearance(annot):QPDFObjectHandle::newNull();
+    if (ap.isNull()) {
+      if (!isWidget(annot)) { // e.g. /Link
+        keep.push_back(annot);
+      }
+      continue;
+    }
+    std::string xoname;
+    do {
+      xoname="/PdfToPdfFlat"+QUtil::int_to_string(num++);
+    } while (xobjects.hasKey(xoname));
+    const std::string cmd=placeAppearance(annot,ap,xoname);
+    if (!cmd.empty()) {
+      xobjects.replaceKey(xoname,ap);
+      content.append(cmd);
+    }
+  }
+
+  if (keep.empty()) {
+    page.removeKey("/Annots");
+  } else {
+    page.replaceKey("/Annots",QPDFObjectHandle::newArray(keep));
+  }
+  if (content.empty()) {
+    return;
+  }
+
+  resources.replaceKey("/XObject",xobjects);
+  page.replaceKey("/Resources",resources);
+
+  // the page contents might leave a modified graphics state behind
+  page.addPageContents(QPDFObjectHandle::newStream(&pdf,"q\n"),true);
+  page.addPageContents(QPDFObjectHandle::newStream(&pdf,"\nQ\n"+content),false);
+}
+// }}}
+
+bool flattenFormFields(QPDF &pdf,const std::vector<QPDFObjectHandle> &pages) // {{{
+{
+  QPDFObjectHandle acroform=pdf.getRoot().getKey("/AcroForm");
+  if (acroform.isDictionary()) {
+    QPDFObjectHandle need=acroform.getKey("/NeedAppearances");
+    if ( (need.isBool())&&(need.getBoolValue()) ) { // the stored appearances may be stale
+      return false;
+    }
+  }
+
+  const int len=pages.size();
+  for (int iA=0;iA<len;iA++) {
+    QPDFObjectHandle page=pages[iA];
+    QPDFObjectHandle annots=page.getKey("/Annots");
+    if (!annots.isArray()) {
+      continue;
+    }
+    const int alen=annots.getArrayNItems();
+    for (int iB=0;iB<alen;iB++) {
+      QPDFObjectHandle annot=annots.getArrayItem(iB);
+      if ( (annot.isDictionary())&&(needsRendering(annot)) ) {
+        return false;
+      }
+    }
+  }
+
+  for (int iA=0;iA<len;iA++) {
+    flattenPage(pdf,pages[iA]);
+  }
+  pdf.getRoot().removeKey("/AcroForm");
+  return true;
+}
+// }}}
@@ -0,0 +1,13 @@
+#ifndef QPDF_FLATTEN_H_
+#define QPDF_FLATTEN_H_
+
+#include <qpdf/QPDF.hh>
+#include <vector>
+
+// Paints the normal appearance of the printable annotations into the page
+// contents and removes them together with /AcroForm.
+// Returns false (and leaves everything untouched), when some form field
+// has no usable appearance stream, i.e. it would need to be rendered.
+bool flattenFormFields(QPDF &pdf,const std::vector<QPDFObjectHandle> &pages);
+
+#endif
@@ -3,12 +3,16 @@
 #include <stdarg.h>
 #include <assert.h>
 #include <stdexcept>
+#include <set>
 #include <qpdf/QPDFWriter.hh>
 #include <qpdf/QUtil.hh>
 #include <qpdf/QPDFPageDocumentHelper.hh>
 #include <qpdf/QPDFAcroFormDocumentHelper.hh>
+#include <qpdf/QPDFPageObjectHelper.hh>
 #include "qpdf_tools.h"
 #include "qpdf_xobject.h"
+#include "qpdf_flatten.h"
+#include "qpdf_analyze.h"
 #include "qpdf_pdftopdf.h"
 
 // Use: content.append(debug_box(pe.sub,xpos,ypos));
@@ -93,6 +97,67 @@ QPDFObjectHandle QPDF_PDFTOPDF_PageHandle::get() // {{{
 }
 // }}}
 
+// counts fonts and images once, even when several subpages share them
+static void countResources(QPDFObjectHandle resources,std::set<QPDFObjGen> &seen,PageStats &stats,int depth) // {{{
+{
+  if ( (!resources.isDictionary())||(depth>8) ) {
+    return;
+  }
+  QPDFObjectHandle fonts=resources.getKey("/Font");
+  if (fonts.isDictionary()) {
+    for (const std::string &key : fonts.getKeys()) {
+      QPDFObjectHandle font=fonts.getKey(key);
+      if ( (!font.isIndirect())||(seen.insert(font.getObjGen()).second) ) {
+        stats.fonts++;
+      }
+    }
+  }
+  QPDFObjectHandle xobjs=resources.getKey("/XObject");
+  if (xobjs.isDictionary()) {
+    for (const std::string &key : xobjs.getKeys()) {
+      QPDFObjectHandle xobj=xobjs.getKey(key);
+      if ( (!xobj.isStream())||
+           ( (xobj.isIndirect())&&(!seen.insert(xobj.getObjGen()).second) ) ) {
+        continue;
+      }
+      QPDFObjectHandle subtype=xobj.getDict().getKey("/Subtype");
+      if (!subtype.isName()) {
+        continue;
+      } else if (subtype.getName()=="/Image") {
+        stats.images++;
+      } else if (subtype.getName()=="/Form") {
+        countResources(xobj.getDict().getKey("/Resources"),seen,stats,depth+1);
+      }
+    }
+  }
+}
+// }}}
+
+void QPDF_PDFTOPDF_PageHandle::getStats(PageStats &stats) // {{{
+{
+  page.assertInitialized();
+  std::set<QPDFObjGen> seen;
+  if (isExisting()) {
+    std::vector<QPDFObjectHandle> contents=page.getPageContents();
+    const int len=contents.size();
+    for (int iA=0;iA<len;iA++) {
+      QPDFObjectHandle length=contents[iA].getDict().getKey("/Length");
+      if (length.isInteger()) {
+        stats.contentBytes+=length.getIntValue();
+      }
+    }
+    countResources(page.getKey("/Resources"),seen,stats,0);
+    return;
+  }
+  stats.contentBytes+=content.size();
+  stats.xobjects+=xobjs.size();
+  for (auto it=xobjs.begin();it!=xobjs.end();++it) {
+    QPDFObjectHandle xobj=it->second;
+    countResources(xobj.getDict().getKey("/Resources"),seen,stats,0);
+  }
+}
+// }}}
+
 // TODO: we probably need a function "ungetRect()"  to transform to page/form space
 // TODO: as member
 static PageRect ungetRect(PageRect rect,const QPDF_PDFTOPDF_PageHandle &ph,Rotation rotation,QPDFObjectHandle page)
@@ -452,6 +517,14 @@ void QPDF_PDFTOPDF_PageHandle::debug(const PageRect &rect,float xpos,float ypos)
 }
 // }}}
 
+QPDF_PDFTOPDF_Processor::QPDF_PDFTOPDF_Processor() // {{{
+  : hasCM(false),
+    compress(false),
+    strip_resources(false)
+{
+}
+// }}}
+
 void QPDF_PDFTOPDF_Processor::closeFile() // {{{
 {
   pdf.reset();
@@ -567,7 +640,24 @@ bool QPDF_PDFTOPDF_Processor::check_print_permissions() // {{{
 }
 // }}}
 
+int QPDF_PDFTOPDF_Processor::get_num_pages() // {{{
+{
+  if (!pdf) {
+    error("No PDF loaded");
+    assert(0);
+    return 0;
+  }
+  return orig_pages.size();
+}
+// }}}
+
 std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> QPDF_PDFTOPDF_Processor::get_pages() // {{{
+{
+  return get_pages(std::vector<bool>(orig_pages.size(),true));
+}
+// }}}
+
+std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> QPDF_PDFTOPDF_Processor::get_pages(const std::vector<bool> &wanted) // {{{
 {
   std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> ret;
   if (!pdf) {
@@ -576,14 +666,44 @@ std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> QPDF_PDFTOPDF_Processor::get_p
     return ret;
   }
   const int len=orig_pages.size();
-  ret.reserve(len);
+  assert((int)wanted.size()==len);
+  ret.resize(len);
+  int numWanted=0;
   for (int iA=0;iA<len;iA++) {
-    ret.push_back(std::shared_ptr<PDFTOPDF_PageHandle>(new QPDF_PDFTOPDF_PageHandle(orig_pages[iA],iA+1)));
+    if (wanted[iA]) {
+      if (strip_resources) {
+        // the page's /Resources become those of its XObject (makeXObject);
+        // shared resource dicts are copied by qpdf before being pruned
+        QPDFPageObjectHelper(orig_pages[iA]).removeUnreferencedResources();
+      }
+      ret[iA]=std::shared_ptr<PDFTOPDF_PageHandle>(new QPDF_PDFTOPDF_PageHandle(orig_pages[iA],iA+1));
+      numWanted++;
+    }
+  }
+  if (numWanted<len) {
+    fprintf(stderr,"DEBUG: pdftopdf: Using %d of %d input pages\n",numWanted,len);
+    dropPageReferences();
   }
   return ret;
 }
 // }}}
 
+// The original pages are only unlinked from the page tree (see start()),
+// anything else still pointing at them would make QPDFWriter emit the
+// unselected pages (and everything they use) anyway.
+void QPDF_PDFTOPDF_Processor::dropPageReferences() // {{{
+{
+  QPDFObjectHandle root=pdf->getRoot();
+  root.removeKey("/Dests");
+  root.removeKey("/StructTreeRoot");
+  root.removeKey("/AcroForm"); // fields point to their pages via /P; forms are flattened by now
+  QPDFObjectHandle names=root.getKey("/Names");
+  if (names.isDictionary()) {
+    names.removeKey("/Dests");
+  }
+}
+// }}}
+
 std::shared_ptr<PDFTOPDF_PageHandle> QPDF_PDFTOPDF_Processor::new_page(float width,float height) // {{{
 {
   if (!pdf) {
@@ -640,12 +760,15 @@ void QPDF_PDFTOPDF_Processor::multiply(int copies,bool collate) // {{{
 // }}}
 
 // TODO? elsewhere?
-void QPDF_PDFTOPDF_Processor::autoRotateAll(bool dst_lscape,Rotation normal_landscape) // {{{
+void QPDF_PDFTOPDF_Processor::autoRotateAll(bool dst_lscape,Rotation normal_landscape,const std::vector<bool> *wanted) // {{{
 {
   assert(pdf);
 
   const int len=orig_pages.size();
   for (int iA=0;iA<len;iA++) {
+    if ((wanted)&&(!(*wanted)[iA])) {
+      continue;
+    }
     QPDFObjectHandle page=orig_pages[iA];
 
     Rotation src_rot=getRotate(page);
@@ -700,6 +823,51 @@ void QPDF_PDFTOPDF_Processor::setComments(const std::vector<std::string> &commen
 }
 // }}}
 
+std::vector<PageContents> QPDF_PDFTOPDF_Processor::classifyPages() // {{{
+{
+  std::vector<PageContents> ret;
+  if (!pdf) {
+    error("No PDF loaded");
+    return ret;
+  }
+  PageClassifier classifier;
+  const std::vector<QPDFObjectHandle> &pages=pdf->getAllPages();
+  const int len=pages.size();
+  ret.reserve(len);
+  for (int iA=0;iA<len;iA++) {
+    ret.push_back(classifier.classify(pages[iA]));
+  }
+  return ret;
+}
+// }}}
+
+void QPDF_PDFTOPDF_Processor::setCompression(bool compress,bool strip_resources) // {{{
+{
+  this->compress=compress;
+  this->strip_resources=strip_resources;
+}
+// }}}
+
+void QPDF_PDFTOPDF_Processor::setupWriter(QPDFWriter &out) // {{{
+{
+  if (compress) {
+    // object and xref streams need PDF 1.5
+    out.setMinimumPDFVersion("1.5");
+    out.setObjectStreamMode(qpdf_o_generate);
+    // decode LZW, ASCII*, RunLength, ... and store everything flate compressed
+    out.setStreamDataMode(qpdf_s_compress);
+  } else if (hasCM) {
+    out.setMinimumPDFVersion("1.4");
+  } else {
+    out.setMinimumPDFVersion("1.2");
+  }
+  if (!extraheader.empty()) {
+    out.setExtraHeaderText(extraheader);
+  }
+  out.setPreserveEncryption(false);
+}
+// }}}
+
 void QPDF_PDFTOPDF_Processor::emitFile(FILE *f,ArgOwnership take) // {{{
 {
   if (!pdf) {
@@ -717,15 +885,7 @@ void QPDF_PDFTOPDF_Processor::emitFile(FILE *f,ArgOwnership take) // {{{
     error("emitFile with MustDuplicate is not supported");
     return;
   }
-  if (hasCM) {
-    out.setMinimumPDFVersion("1.4");
-  } else {
-    out.setMinimumPDFVersion("1.2");
-  }
-  if (!extraheader.empty()) {
-    out.setExtraHeaderText(extraheader);
-  }
-  out.setPreserveEncryption(false);
+  setupWriter(out);
   out.write();
 }
 // }}}
@@ -737,15 +897,7 @@ void QPDF_PDFTOPDF_Processor::emitFilename(const char *name) // {{{
   }
   // special case: name==NULL -> stdout
   QPDFWriter out(*pdf,name);
-  if (hasCM) {
-    out.setMinimumPDFVersion("1.4");
-  } else {
-    out.setMinimumPDFVersion("1.2");
-  }
-  if (!extraheader.empty()) {
-    out.setExtraHeaderText(extraheader);
-  }
-  out.setPreserveEncryption(false);
+  setupWriter(out);
   std::vector<QPDFObjectHandle> pages=pdf->getAllPages();
   int len=pages.size();
   if (len)
@@ -770,3 +922,13 @@ bool QPDF_PDFTOPDF_Processor::hasAcroForm() // {{{
   return true;
 }
 // }}}
+
+bool QPDF_PDFTOPDF_Processor::flattenFormFields() // {{{
+{
+  if (!pdf) {
+    error("No PDF loaded");
+    return false;
+  }
+  return ::flattenFormFields(*pdf,orig_pages);
+}
+// }}}
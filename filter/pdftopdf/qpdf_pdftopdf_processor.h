@@ -4,6 +4,8 @@
 #include "pdftopdf_processor.h"
 #include <qpdf/QPDF.hh>
 
+class QPDFWriter;
+
 class QPDF_PDFTOPDF_PageHandle : public PDFTOPDF_PageHandle {
  public:
   virtual PageRect getRect() const;
@@ -14,6 +16,7 @@ class QPDF_PDFTOPDF_PageHandle : public PDFTOPDF_PageHandle {
   virtual void add_label(const PageRect &rect, const std::string label);
   virtual Rotation crop(const PageRect &cropRect,Rotation orientation,Rotation param_orientation,Position xpos,Position ypos,bool scale,bool autorotate);
   virtual bool is_landscape(Rotation orientation);
+  virtual void getStats(PageStats &stats);
   void debug(const PageRect &rect,float xpos,float ypos);
  private:
   bool isExisting() const;
@@ -35,6 +38,8 @@ class QPDF_PDFTOPDF_PageHandle : public PDFTOPDF_PageHandle {
 
 class QPDF_PDFTOPDF_Processor : public PDFTOPDF_Processor {
  public:
+  QPDF_PDFTOPDF_Processor();
+
   virtual bool loadFile(FILE *f,ArgOwnership take=WillStayAlive,int flatten_forms=1);
   virtual bool loadFilename(const char *name,int flatten_forms=1);
 
@@ -43,32 +48,41 @@ class QPDF_PDFTOPDF_Processor : public PDFTOPDF_Processor {
 
   // virtual bool setProcess(const ProcessingParameters &param) =0;
 
+  virtual int get_num_pages();
   virtual std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> get_pages();
+  virtual std::vector<std::shared_ptr<PDFTOPDF_PageHandle>> get_pages(const std::vector<bool> &wanted);
   virtual std::shared_ptr<PDFTOPDF_PageHandle> new_page(float width,float height);
 
   virtual void add_page(std::shared_ptr<PDFTOPDF_PageHandle> page,bool front);
 
   virtual void multiply(int copies,bool collate);
 
-  virtual void autoRotateAll(bool dst_lscape,Rotation normal_landscape);
+  virtual void autoRotateAll(bool dst_lscape,Rotation normal_landscape,const std::vector<bool> *wanted=NULL);
   virtual void addCM(const char *defaulticc,const char *outputicc);
 
   virtual void setComments(const std::vector<std::string> &comments);
+  virtual std::vector<PageContents> classifyPages();
+  virtual void setCompression(bool compress,bool strip_resources);
 
   virtual void emitFile(FILE *dst,ArgOwnership take=WillStayAlive);
   virtual void emitFilename(const char *name);
 
   virtual bool hasAcroForm();
+  virtual bool flattenFormFields();
  private:
   void closeFile();
   void error(const char *fmt,...);
   void start(int flatten_forms);
+  void dropPageReferences();
+  void setupWriter(QPDFWriter &out);
  private:
   std::unique_ptr<QPDF> pdf;
   std::vector<QPDFObjectHandle> orig_pages;
 
   bool hasCM;
   std::string extraheader;
+
+  bool compress,strip_resources;
 };
 
 #endif
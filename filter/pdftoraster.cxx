@@ -47,8 +47,12 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <cupsfilters/image.h>
 #include <cupsfilters/raster.h>
 #include <cupsfilters/colormanager.h>
+#include <string.h>
 #include <strings.h>
+#include <ctype.h>
 #include <math.h>
+#include <string>
+#include <algorithm>
 #include <poppler/cpp/poppler-document.h>
 #include <poppler/cpp/poppler-page.h>
 #include <poppler/cpp/poppler-global.h>
@@ -90,6 +94,12 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #endif
 
 #define MAX_CHECK_COMMENT_LINES	20
+
+/* page_renderer::set_image_format() */
+#if defined(POPPLER_VERSION_MAJOR) && defined(POPPLER_VERSION_MINOR) && \
+    (POPPLER_VERSION_MAJOR > 0 || POPPLER_VERSION_MINOR >= 65)
+#define HAVE_POPPLER_GRAY_RENDERING
+#endif
 #define MAX_BYTES_PER_PIXEL 32
 
 namespace {
@@ -107,6 +117,12 @@ namespace {
   int pwgraster = 0;
   int deviceCopies = 1;
   bool deviceCollate = false;
+  /* software copies made from the rendered pages (see pdftopdf) */
+  int rasterCopies = 1;
+  bool rasterCollate = false;
+  cups_raster_copies_t *copiesGen = NULL;
+  /* per page 'B'lank, 'M'onochrome, 'C'olor, found by pdftopdf */
+  std::string pageHints;
   cups_page_header2_t header;
   ppd_file_t *ppd = 0;
   char pageSizeRequested[64];
@@ -500,10 +516,55 @@ static void parsePDFTOPDFComment(FILE *fp)
       } else {
 	deviceCollate = false;
       }
+    } else if (strncmp(buf,"%%PDFTOPDFRasterCopies",22) == 0) {
+      char *p;
+
+      p = strchr(buf+22,':');
+      rasterCopies = p ? atoi(p+1) : 1;
+      if (rasterCopies < 1) rasterCopies = 1;
+    } else if (strncmp(buf,"%%PDFTOPDFRasterCollate",23) == 0) {
+      char *p;
+
+      p = strchr(buf+23,':');
+      if (p == NULL) continue;
+      p++;
+      while (*p == ' ' || *p == '\t') p++;
+      rasterCollate = (strncasecmp(p,"true",4) == 0);
+    } else if (strncmp(buf,"%%PDFTOPDFPageHints",19) == 0) {
+      /* letters, runs of equal ones as letter+count: "M12BC3" */
+      char *p;
+
+      p = strchr(buf+19,':');
+      if (p == NULL) continue;
+      pageHints.clear();
+      for (p++;*p;) {
+	if (*p == 'B' || *p == 'M' || *p == 'C') {
+	  char letter = *p++;
+	  int count = 1;
+	  if (isdigit(*p)) count = strtol(p,&p,10);
+	  if (count < 1 || count > 1000000) {
+	    pageHints.clear();
+	    break;
+	  }
+	  pageHints.append(count,letter);
+	} else if (isspace(*p)) {
+	  p++;
+	} else { /* unknown, better render everything */
+	  pageHints.clear();
+	  break;
+	}
+      }
     }
   }
 }
 
+static char pageHint(int pageNo)
+{
+  if (pageNo >= 1 && pageNo <= (int)pageHints.size())
+    return pageHints[pageNo-1];
+  return 'C';
+}
+
 static unsigned char *reverseLine(unsigned char *src, unsigned char *dst,
      unsigned int row, unsigned int plane, unsigned int pixels,
      unsigned int size)
@@ -1551,6 +1612,60 @@ static unsigned char *removeAlpha(unsigned char *src, unsigned char *dst, unsign
   return temp;
 }
 
+/*
+ * Render the page into width x height 8-bit gray (gray = true) or RGB
+ * pixels. Pages pdftopdf found to be blank are not rendered at all,
+ * monochrome ones are rendered in gray only.
+ */
+static unsigned char *renderPage(poppler::page_renderer &pr,
+  poppler::page *page, unsigned int width, unsigned int height,
+  char hint, bool gray)
+{
+  unsigned int size = width * height * (gray ? 1 : 3);
+  unsigned char *data = (unsigned char *)malloc(size);
+  unsigned char *rowbuf = NULL;
+
+  memset(data, 0xff, size); /* white */
+  if (hint == 'B')
+    return data;
+
+  poppler::image im;
+  bool gray8 = false;
+#ifdef HAVE_POPPLER_GRAY_RENDERING
+  if (hint == 'M') {
+    pr.set_image_format(poppler::image::format_gray8);
+    im = pr.render_page(page,header.HWResolution[0],header.HWResolution[1],bitmapoffset[0],bitmapoffset[1],width,height);
+    pr.set_image_format(poppler::image::format_argb32);
+    gray8 = (im.format() == poppler::image::format_gray8);
+  } else
+#endif
+    im = pr.render_page(page,header.HWResolution[0],header.HWResolution[1],bitmapoffset[0],bitmapoffset[1],width,height);
+
+  const unsigned char *src = (const unsigned char *)im.const_data();
+  unsigned int w = ((unsigned int)im.width() < width) ? im.width() : width;
+  unsigned int h = ((unsigned int)im.height() < height) ? im.height() : height;
+  if (src == NULL)
+    return data;
+  if (gray && !gray8)
+    rowbuf = (unsigned char *)malloc(3 * w);
+
+  for (unsigned int y = 0; y < h; y ++, src += im.bytes_per_row()) {
+    if (gray8) {
+      if (gray)
+	memcpy(data + y * width, src, w);
+      else
+	for (unsigned int x = 0; x < w; x ++)
+	  memset(data + 3 * (y * width + x), src[x], 3);
+    } else if (gray) {
+      removeAlpha((unsigned char *)src, rowbuf, w, 1);
+      cupsImageRGBToWhite(rowbuf, data + y * width, w);
+    } else
+      removeAlpha((unsigned char *)src, data + 3 * y * width, w, 1);
+  }
+  free(rowbuf);
+  return data;
+}
+
 static void writePageImage(cups_raster_t *raster, poppler::document *doc,
   int pageNo)
 {
@@ -1564,32 +1679,23 @@ static void writePageImage(cups_raster_t *raster, poppler::document *doc,
   pr.set_render_hint(poppler::page_renderer::antialiasing, true);
   pr.set_render_hint(poppler::page_renderer::text_antialiasing, true);
 
-  unsigned char *colordata,*newdata,*graydata,*onebitdata;
-  unsigned int pixel_count;
-  poppler::image im;
+  unsigned char *colordata,*graydata,*onebitdata;
+  char hint = pageHint(pageNo);
   //render the page according to the colourspace and generate the requried data
   switch (header.cupsColorSpace) {
    case CUPS_CSPACE_W://gray
    case CUPS_CSPACE_K://black
    case CUPS_CSPACE_SW://sgray
     if(header.cupsBitsPerColor==1){ //special case for 1-bit colorspaces
-      im = pr.render_page(current_page,header.HWResolution[0],header.HWResolution[1],bitmapoffset[0],bitmapoffset[1],bytesPerLine*8,header.cupsHeight);
-    newdata = (unsigned char *)malloc(sizeof(char)*3*im.width()*im.height());
-    newdata = removeAlpha((unsigned char *)im.const_data(),newdata,im.width(),im.height());
-    graydata=(unsigned char *)malloc(sizeof(char)*im.width()*im.height());
-    cupsImageRGBToWhite(newdata,graydata,im.width()*im.height());
-    onebitdata=(unsigned char *)malloc(sizeof(char)*bytesPerLine*im.height());
-    onebitpixel(graydata,onebitdata,im.width(),im.height());
+    graydata=renderPage(pr,current_page,bytesPerLine*8,header.cupsHeight,hint,true);
+    onebitdata=(unsigned char *)malloc(sizeof(char)*bytesPerLine*header.cupsHeight);
+    onebitpixel(graydata,onebitdata,bytesPerLine*8,header.cupsHeight);
+    free(graydata);
     colordata=onebitdata;
     rowsize=bytesPerLine;
     }
     else{
-      im = pr.render_page(current_page,header.HWResolution[0],header.HWResolution[1],bitmapoffset[0],bitmapoffset[1],header.cupsWidth,header.cupsHeight);
-      newdata = (unsigned char *)malloc(sizeof(char)*3*im.width()*im.height());
-      newdata = removeAlpha((unsigned char *)im.const_data(),newdata,im.width(),im.height());
-      pixel_count=im.width()*im.height();
-      graydata=(unsigned char *)malloc(sizeof(char)*im.width()*im.height());
-      cupsImageRGBToWhite(newdata,graydata,pixel_count);
+      graydata=renderPage(pr,current_page,header.cupsWidth,header.cupsHeight,hint,true);
       colordata=graydata;
       rowsize=header.cupsWidth;
     }
@@ -1602,12 +1708,8 @@ static void writePageImage(cups_raster_t *raster, poppler::document *doc,
    case CUPS_CSPACE_CMY:
    case CUPS_CSPACE_RGBW:
    default:
-   im = pr.render_page(current_page,header.HWResolution[0],header.HWResolution[1],bitmapoffset[0],bitmapoffset[1],header.cupsWidth,header.cupsHeight);
-   newdata = (unsigned char *)malloc(sizeof(char)*3*im.width()*im.height());
-   newdata = removeAlpha((unsigned char *)im.const_data(),newdata,im.width(),im.height());
-   pixel_count=im.width()*im.height();
+   colordata=renderPage(pr,current_page,header.cupsWidth,header.cupsHeight,hint,false);
    rowsize=header.cupsWidth*3;
-   colordata=newdata;
      break;
   }
 
@@ -1626,7 +1728,7 @@ static void writePageImage(cups_raster_t *raster, poppler::document *doc,
         for (unsigned int band = 0;band < nbands;band++) {
           dp = convertLine(bp,lineBuf,h - 1,plane+band,header.cupsWidth,
                  bytesPerLine);
-          cupsRasterWritePixels(raster,dp,bytesPerLine);
+          cupsRasterCopiesWritePixels(copiesGen,raster,dp,bytesPerLine);
         }
         bp -= rowsize;
       }
@@ -1639,7 +1741,7 @@ static void writePageImage(cups_raster_t *raster, poppler::document *doc,
         for (unsigned int band = 0;band < nbands;band++) {
           dp = convertLine(bp,lineBuf,h,plane+band,header.cupsWidth,
                  bytesPerLine);
-          cupsRasterWritePixels(raster,dp,bytesPerLine);
+          cupsRasterCopiesWritePixels(copiesGen,raster,dp,bytesPerLine);
         }
         bp += rowsize;
       }
@@ -1877,7 +1979,7 @@ static void outPage(poppler::document *doc, int pageNo,
   if (header.cupsColorOrder == CUPS_ORDER_BANDED) {
     header.cupsBytesPerLine *= header.cupsNumColors;
   }
-  if (!cupsRasterWriteHeader2(raster,&header)) {
+  if (!cupsRasterCopiesWriteHeader(copiesGen,raster,&header)) {
       fprintf(stderr, "ERROR: Can't write page %d header\n",pageNo );
       exit(1);
   }
@@ -1986,6 +2088,7 @@ int main(int argc, char *argv[]) {
     char name[BUFSIZ];
     char buf[BUFSIZ];
     int n;
+    FILE *fp;
 
     fd = cupsTempFd(name,sizeof(name));
     if (fd < 0) {
@@ -2001,7 +2104,12 @@ int main(int argc, char *argv[]) {
 	exit(1);
       }
     }
-    close(fd);
+    /* pdftopdf's comments are needed here as well */
+    if (lseek(fd,0,SEEK_SET) == 0 && (fp = fdopen(fd,"rb")) != NULL) {
+      parsePDFTOPDFComment(fp);
+      fclose(fp);
+    } else
+      close(fd);
     doc=poppler::document::load_from_file(name,"","");
     /* remove name */
     unlink(name);
@@ -2021,6 +2129,17 @@ int main(int argc, char *argv[]) {
   if(doc != NULL)
     npages = doc->pages();
 
+  if (!pageHints.empty()) {
+    if ((int)pageHints.size() != npages) {
+      fprintf(stderr, "DEBUG: Page hints are for %d pages, not %d, ignoring them\n",
+	      (int)pageHints.size(), npages);
+      pageHints.clear();
+    } else
+      fprintf(stderr, "DEBUG: Page hints: %d blank pages not rendered, %d monochrome pages rendered in gray\n",
+	      (int)std::count(pageHints.begin(), pageHints.end(), 'B'),
+	      (int)std::count(pageHints.begin(), pageHints.end(), 'M'));
+  }
+
   /* fix NumCopies, Collate ccording to PDFTOPDFComments */
   header.NumCopies = deviceCopies;
   header.Collate = deviceCollate ? CUPS_TRUE : CUPS_FALSE;
@@ -2119,9 +2238,19 @@ int main(int argc, char *argv[]) {
   }
   selectConvertFunc(raster);
   if(doc != NULL){
+    if (rasterCopies > 1) {
+      fprintf(stderr, "DEBUG: Generating %d %scollated copies from the rendered pages\n",
+	      rasterCopies, rasterCollate ? "" : "un");
+      copiesGen = cupsRasterCopiesNew(rasterCopies, rasterCollate);
+    }
     for (i = 1;i <= npages;i++) {
       outPage(doc,i,raster);
     }
+    if (cupsRasterCopiesFinish(copiesGen, raster) < 0) {
+      fprintf(stderr, "ERROR: Can't write copies\n");
+      exitCode = 1;
+    }
+    cupsRasterCopiesDelete(copiesGen);
   } else
     fprintf(stderr, "DEBUG: Input is empty, outputting empty file.\n");
 
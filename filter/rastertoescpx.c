@@ -16,6 +16,9 @@
  *   EndPage()         - Finish a page of graphics.
  *   Shutdown()        - Shutdown a printer.
  *   CancelJob()       - Cancel the current job...
+ *   AddBand()         - Add a band of data to the used heap.
+ *   NextBand()        - Remove the first band to print from the used heap.
+ *   BandBefore()      - Check whether a band prints before another one.
  *   CompressData()    - Compress a line of graphics.
  *   OutputBand()      - Output a band of graphics.
  *   ProcessLine()     - Read graphics from the page stream and output
@@ -40,10 +43,10 @@
 
 typedef struct cups_weave_str
 {
-  struct cups_weave_str	*prev,			/* Previous band */
-			*next;			/* Next band */
+  struct cups_weave_str	*next;			/* Next available band */
   int			x, y,			/* Column/Line on the page */
 			plane,			/* Color plane */
+			seq,			/* Order of adding to used heap */
 			dirty,			/* Is this buffer dirty? */
 			row,			/* Row in the buffer */
 			count;			/* Max rows this pass */
@@ -64,9 +67,11 @@ unsigned char	*PixelBuffer,		/* Pixel buffer */
 		*CompBuffer;		/* Compression buffer */
 short		*InputBuffer;		/* Color separation buffer */
 cups_weave_t	*DotAvailList,		/* Available buffers */
-		*DotUsedList,		/* Used buffers */
+		**DotUsedHeap,		/* Used buffers, first to print on top */
 		*DotBands[128][7];	/* Buffers in use */
-int		DotBufferSize,		/* Size of dot buffers */
+int		DotUsedCount,		/* Number of used buffers */
+		DotUsedSeq,		/* Number of buffers ever used */
+		DotBufferSize,		/* Size of dot buffers */
 		DotRowMax,		/* Maximum row number in buffer */
 		DotColStep,		/* Step for each output column */
 		DotRowStep,		/* Step for each output line */
@@ -80,7 +85,7 @@ int		PrinterPlanes,		/* # of color planes */
 		PrinterTop,		/* Top of page */
 		PrinterLength;		/* Length of page */
 cups_lut_t	*DitherLuts[7];		/* Lookup tables for dithering */
-cups_dither_t	*DitherStates[7];	/* Dither state tables */
+cups_dither_multi_t *DitherState;	/* Dither state table */
 int		OutputFeed;		/* Number of lines to skip */
 int		Canceled;		/* Is the job canceled? */
 
@@ -95,6 +100,8 @@ void	EndPage(ppd_file_t *, cups_page_header2_t *);
 void	Shutdown(ppd_file_t *);
 
 void	AddBand(cups_weave_t *band);
+cups_weave_t *NextBand(void);
+int	BandBefore(const cups_weave_t *a, const cups_weave_t *b);
 void	CancelJob(int sig);
 void	CompressData(ppd_file_t *, const unsigned char *, const int,
 	             int, int, const int, const int, const int,
@@ -335,12 +342,23 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
   }
 
   for (plane = 0; plane < PrinterPlanes; plane ++)
-  {
-    DitherStates[plane] = cupsDitherNew(header->cupsWidth);
-
     if (!DitherLuts[plane])
       DitherLuts[plane] = cupsLutNew(2, default_lut);
-  }
+
+ /*
+  * Dither all planes of a line in one pass, using ordered dithering
+  * if the PPD asks for it (typically for draft modes)...
+  */
+
+  if ((attr = cupsFindAttr(ppd, "cupsDitherMode", colormodel,
+                           header->MediaType, resolution, spec,
+			   sizeof(spec))) != NULL &&
+      !strcmp(attr->value, "Ordered"))
+    DitherState = cupsDitherMultiNew(header->cupsWidth, PrinterPlanes,
+                                     CUPS_DITHER_ORDERED);
+  else
+    DitherState = cupsDitherMultiNew(header->cupsWidth, PrinterPlanes,
+                                     CUPS_DITHER_DIFFUSE);
 
   if (DitherLuts[0][4095].pixel > 1)
     BitPlanes = 2;
@@ -844,7 +862,9 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
   fprintf(stderr, "DEBUG: DotRowCount = %d\n", DotRowCount);
 
   DotAvailList  = NULL;
-  DotUsedList   = NULL;
+  DotUsedHeap   = NULL;
+  DotUsedCount  = 0;
+  DotUsedSeq    = 0;
   DotBuffers[0] = NULL;
 
   fprintf(stderr, "DEBUG: model_number = %x\n", ppd->model_number);
@@ -911,7 +931,9 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
       band->buffer = calloc(DotRowCount, DotBufferSize);
     }
 
-    if (!DotAvailList)
+    DotUsedHeap = (cups_weave_t **)calloc(bands, sizeof(cups_weave_t *));
+
+    if (!DotAvailList || !DotUsedHeap)
     {
       fputs("ERROR: Unable to allocate band list\n", stderr);
       exit(1);
@@ -1068,7 +1090,7 @@ EndPage(ppd_file_t         *ppd,	/* I - PPD file */
   if (DotRowMax > 1)
   {
    /*
-    * Move the remaining bands to the used or avail lists...
+    * Move the remaining bands to the used heap or avail list...
     */
 
     subrows = DotRowStep * DotColStep;
@@ -1079,7 +1101,7 @@ EndPage(ppd_file_t         *ppd,	/* I - PPD file */
         if (DotBands[subrow][plane]->dirty)
 	{
 	 /*
-	  * Insert into the used list...
+	  * Insert into the used heap...
 	  */
 
           DotBands[subrow][plane]->count = DotBands[subrow][plane]->row;
@@ -1105,26 +1127,26 @@ EndPage(ppd_file_t         *ppd,	/* I - PPD file */
 
     fputs("DEBUG: Pointer list at end of page...\n", stderr);
 
-    for (band = DotUsedList; band != NULL; band = band->next)
-      fprintf(stderr, "DEBUG: %p (used)\n", (void*)band);
+    for (i = 0; i < DotUsedCount; i ++)
+      fprintf(stderr, "DEBUG: %p (used)\n", (void*)DotUsedHeap[i]);
     for (band = DotAvailList; band != NULL; band = band->next)
       fprintf(stderr, "DEBUG: %p (avail)\n", (void*)band);
 
     fputs("DEBUG: ----END----\n", stderr);
 
-    for (band = DotUsedList; band != NULL; band = next)
+    while ((band = NextBand()) != NULL)
     {
-      next = band->next;
-
       OutputBand(ppd, header, band);
 
-      fprintf(stderr, "DEBUG: freeing used band %p, prev = %p, next = %p\n",
-              (void*)band, (void*)band->prev, (void*)band->next);
+      fprintf(stderr, "DEBUG: freeing used band %p\n", (void*)band);
 
       free(band->buffer);
       free(band);
     }
 
+    free(DotUsedHeap);
+    DotUsedHeap = NULL;
+
    /*
     * Free memory for the available bands, if any...
     */
@@ -1133,8 +1155,8 @@ EndPage(ppd_file_t         *ppd,	/* I - PPD file */
     {
       next = band->next;
 
-      fprintf(stderr, "DEBUG: freeing avail band %p, prev = %p,  next = %p\n",
-              (void*)band, (void*)band->prev, (void*)band->next);
+      fprintf(stderr, "DEBUG: freeing avail band %p, next = %p\n",
+              (void*)band, (void*)band->next);
 
       free(band->buffer);
       free(band);
@@ -1156,11 +1178,10 @@ EndPage(ppd_file_t         *ppd,	/* I - PPD file */
   * Free memory for the page...
   */
 
+  cupsDitherMultiDelete(DitherState);
+
   for (i = 0; i < PrinterPlanes; i ++)
-  {
-    cupsDitherDelete(DitherStates[i]);
     cupsLutDelete(DitherLuts[i]);
-  }
 
   free(OutputBuffers[0]);
 
@@ -1215,63 +1236,100 @@ Shutdown(ppd_file_t *ppd)		/* I - PPD file */
 
 
 /*
- * 'AddBand()' - Add a band of data to the used list.
+ * 'AddBand()' - Add a band of data to the used heap.
+ *
+ * The heap is ordered by position on the page (y, x, plane), and bands at
+ * the same position in the order they were added...
  */
 
 void
 AddBand(cups_weave_t *band)			/* I - Band to add */
 {
-  cups_weave_t	*current,			/* Current band */
-		*prev;				/* Previous band */
+  int	child,					/* Slot of band */
+	parent;					/* Slot of parent band */
 
 
   if (band->count < 1)
     return;
 
-  for (current = DotUsedList, prev = NULL;
-       current != NULL;
-       prev = current, current = current->next)
-    if (band->y < current->y ||
-        (band->y == current->y && band->x < current->x) ||
-	(band->y == current->y && band->x == current->x &&
-	 band->plane < current->plane))
-      break;
+  band->seq = DotUsedSeq ++;
+
+ /*
+  * Move the band up from the bottom until its parent prints first...
+  */
 
-  if (current != NULL)
+  for (child = DotUsedCount ++; child > 0; child = parent)
   {
-   /*
-    * Insert the band...
-    */
+    parent = (child - 1) / 2;
 
-    band->next    = current;
-    band->prev    = prev;
-    current->prev = band;
+    if (!BandBefore(band, DotUsedHeap[parent]))
+      break;
 
-    if (prev != NULL)
-      prev->next = band;
-    else
-      DotUsedList = band;
+    DotUsedHeap[child] = DotUsedHeap[parent];
   }
-  else if (prev != NULL)
-  {
-   /*
-    * Append the band to the end...
-    */
 
-    band->prev = prev;
-    prev->next = band;
-    band->next = NULL;
-  }
-  else
+  DotUsedHeap[child] = band;
+}
+
+
+/*
+ * 'NextBand()' - Remove the first band to print from the used heap.
+ */
+
+cups_weave_t *				/* O - Band or NULL if none */
+NextBand(void)
+{
+  cups_weave_t	*first,				/* First band */
+		*last;				/* Band to move down */
+  int		parent,				/* Slot to fill */
+		child;				/* First child of slot */
+
+
+  if (DotUsedCount == 0)
+    return (NULL);
+
+  first = DotUsedHeap[0];
+  last  = DotUsedHeap[-- DotUsedCount];
+
+ /*
+  * Move the last band down from the top until both children print
+  * after it...
+  */
+
+  for (parent = 0; (child = 2 * parent + 1) < DotUsedCount; parent = child)
   {
-   /*
-    * First band in list...
-    */
+    if (child + 1 < DotUsedCount &&
+        BandBefore(DotUsedHeap[child + 1], DotUsedHeap[child]))
+      child ++;
+
+    if (!BandBefore(DotUsedHeap[child], last))
+      break;
 
-    DotUsedList = band;
-    band->prev  = NULL;
-    band->next  = NULL;
+    DotUsedHeap[parent] = DotUsedHeap[child];
   }
+
+  DotUsedHeap[parent] = last;
+
+  return (first);
+}
+
+
+/*
+ * 'BandBefore()' - Check whether a band prints before another one.
+ */
+
+int					/* O - 1 if a prints first, 0 otherwise */
+BandBefore(const cups_weave_t *a,	/* I - First band */
+           const cups_weave_t *b)	/* I - Second band */
+{
+  if (a->y != b->y)
+    return (a->y < b->y);
+  else if (a->x != b->x)
+    return (a->x < b->x);
+  else if (a->plane != b->plane)
+    return (a->plane < b->plane);
+  else
+    return (a->seq < b->seq);
 }
 
 
@@ -1564,7 +1622,8 @@ ProcessLine(ppd_file_t         *ppd,	/* I - PPD file */
 		pass,			/* Pass number */
 		xstep,			/* X step value */
 		ystep;			/* Y step value */
-  cups_weave_t	*band;			/* Current band */
+  cups_weave_t	*band,			/* Current band */
+		*next;			/* Band to continue with */
 
 
  /*
@@ -1619,11 +1678,10 @@ ProcessLine(ppd_file_t         *ppd,	/* I - PPD file */
   * Dither the pixels...
   */
 
+  cupsDitherMultiLine(DitherState, DitherLuts, InputBuffer, OutputBuffers);
+
   for (plane = 0; plane < PrinterPlanes; plane ++)
   {
-    cupsDitherLine(DitherStates[plane], DitherLuts[plane], InputBuffer + plane,
-                   PrinterPlanes, OutputBuffers[plane]);
-
     if (DotRowMax == 1)
     {
      /*
@@ -1683,37 +1741,34 @@ ProcessLine(ppd_file_t         *ppd,	/* I - PPD file */
 	  if (band->dirty)
 	  {
 	   /*
-	    * Dirty band needs to be added to the used list...
+	    * Dirty band needs to be added to the used heap...
 	    */
 
 	    AddBand(band);
 
            /*
-	    * Then find a new band...
+	    * Then find a new band, printing the first used one if none is
+	    * available...
 	    */
 
 	    if (DotAvailList == NULL)
 	    {
-	      OutputBand(ppd, header, DotUsedList);
-
-	      DotBands[subrow][plane] = DotUsedList;
-	      DotUsedList->x          = band->x;
-	      DotUsedList->y          = band->y + band->count * DotRowStep;
-	      DotUsedList->plane      = band->plane;
-	      DotUsedList->row        = 0;
-	      DotUsedList->count      = DotRowCount;
-	      DotUsedList             = DotUsedList->next;
+	      next = NextBand();
+
+	      OutputBand(ppd, header, next);
 	    }
 	    else
 	    {
-	      DotBands[subrow][plane] = DotAvailList;
-	      DotAvailList->x         = band->x;
-	      DotAvailList->y         = band->y + band->count * DotRowStep;
-	      DotAvailList->plane     = band->plane;
-	      DotAvailList->row       = 0;
-	      DotAvailList->count     = DotRowCount;
-	      DotAvailList            = DotAvailList->next;
+	      next         = DotAvailList;
+	      DotAvailList = DotAvailList->next;
 	    }
+
+	    DotBands[subrow][plane] = next;
+	    next->x                 = band->x;
+	    next->y                 = band->y + band->count * DotRowStep;
+	    next->plane             = band->plane;
+	    next->row               = 0;
+	    next->count             = DotRowCount;
 	  }
 	  else
 	  {
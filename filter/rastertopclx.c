@@ -19,6 +19,13 @@
  *   CompressData() - Compress a line of graphics.
  *   OutputLine()   - Output the specified number of lines of graphics.
  *   ReadLine()     - Read graphics from the page stream.
+ *   SeparateLine() - Do the color separation of a line.
+ *   StartPipe()    - Start threads separating and dithering lines.
+ *   WritePipeLine() - Output the oldest line of the pipeline.
+ *   PipeLine()     - Read a line into the pipeline, output an old one.
+ *   FinishPipe()   - Output the remaining lines and stop the threads.
+ *   DitherThread() - Dither the separated lines in order.
+ *   SeparateThread() - Separate the lines read.
  *   main()         - Main entry and processing of driver.
  */
 
@@ -26,10 +33,15 @@
  * Include necessary headers...
  */
 
+#include <config.h>
 #include <cupsfilters/colormanager.h>
 #include <cupsfilters/driver.h>
 #include "pcl-common.h"
+#include "pcl-compress.h"
 #include <signal.h>
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif /* HAVE_PTHREAD_H */
 
 
 /*
@@ -45,6 +57,54 @@ typedef enum
 } pcl_output_t;
 
 
+#ifdef HAVE_PTHREAD_H
+/*
+ * Line pipeline: the main thread reads and outputs lines, other threads
+ * separate them (in any order) and dither them (in order, as the dither
+ * state carries over from line to line)...
+ */
+
+#  define PIPE_LINES	32		/* Lines in flight */
+#  define PIPE_THREADS	4		/* Maximum separation threads */
+
+typedef enum
+{
+  LINE_FREE,				/* Slot is unused */
+  LINE_BLANK,				/* Blank line, nothing to do */
+  LINE_READ,				/* Read, to be separated */
+  LINE_SEPARATING,			/* Being separated */
+  LINE_SEPARATED,			/* Separated, to be dithered */
+  LINE_DITHERED				/* Ready for output */
+} pcl_line_state_t;
+
+typedef struct pcl_line_s		/**** Line in the pipeline ****/
+{
+  pcl_line_state_t state;		/* State of line */
+  unsigned char	*pixels,		/* Raster data */
+		*cmyk,			/* RGB separation */
+		*output;		/* Dithered planes */
+  short		*input;			/* Separated planes */
+} pcl_line_t;
+
+typedef struct pcl_pipe_s		/**** Line pipeline ****/
+{
+  pthread_mutex_t mutex;		/* Lock for all of the below */
+  pthread_cond_t cond;			/* Signals state changes */
+  cups_page_header2_t *header;		/* Page header */
+  pcl_line_t	lines[PIPE_LINES];	/* Line slots */
+  int		num_read,		/* Lines read */
+		num_dithered,		/* Lines dithered (or blank) */
+		num_written,		/* Lines output */
+		done,			/* No more lines to read? */
+		stop,			/* Stop threads now? */
+		num_threads;		/* Number of separation threads */
+  pthread_t	ditherer,		/* Dithering thread */
+		separators[PIPE_THREADS];/* Separation threads */
+  unsigned char	*saved_output;		/* Page's own OutputBuffers[0] */
+} pcl_pipe_t;
+#endif /* HAVE_PTHREAD_H */
+
+
 /*
  * Globals...
  */
@@ -56,13 +116,16 @@ unsigned char	*PixelBuffer,		/* Pixel buffer */
 		*OutputBuffers[6],	/* Output buffers */
 		*DotBuffers[6],		/* Bit buffers */
 		*CompBuffer,		/* Compression buffer */
+		*DeltaBuffer,		/* Mode 3 candidate buffer */
 		*SeedBuffer,		/* Mode 3 seed buffers */
 		BlankValue;		/* The blank value */
 short		*InputBuffer;		/* Color separation buffer */
 cups_lut_t	*DitherLuts[6];		/* Lookup tables for dithering */
-cups_dither_t	*DitherStates[6];	/* Dither state tables */
+cups_dither_multi_t *DitherState;	/* Dither state table */
 int		PrinterPlanes,		/* Number of color planes */
 		SeedInvalid,		/* Contents of seed buffer invalid? */
+		AdaptiveCompression,	/* Pick mode 0/2/3 per line? */
+		CompressMode,		/* Current compression mode */
 		DotBits[6],		/* Number of bits per color */
 		DotBufferSizes[6],	/* Size of one row of color dots */
 		DotBufferSize,		/* Size of complete line */
@@ -98,6 +161,16 @@ void	CompressData(unsigned char *line, int length, int plane, int pend,
 	             int type);
 void	OutputLine(ppd_file_t *ppd, cups_page_header2_t *header);
 int	ReadLine(cups_raster_t *ras, cups_page_header2_t *header);
+void	SeparateLine(cups_page_header2_t *header, unsigned char *pixels,
+		     unsigned char *cmyk, short *input);
+#ifdef HAVE_PTHREAD_H
+pcl_pipe_t *StartPipe(cups_page_header2_t *header);
+void	WritePipeLine(pcl_pipe_t *pipe, ppd_file_t *ppd);
+void	PipeLine(pcl_pipe_t *pipe, cups_raster_t *ras, ppd_file_t *ppd);
+void	FinishPipe(pcl_pipe_t *pipe, ppd_file_t *ppd);
+void	*DitherThread(void *data);
+void	*SeparateThread(void *data);
+#endif /* HAVE_PTHREAD_H */
 
 
 /*
@@ -285,7 +358,7 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
     DotBufferSize = header->cupsBytesPerLine;
 
     memset(DitherLuts, 0, sizeof(DitherLuts));
-    memset(DitherStates, 0, sizeof(DitherStates));
+    DitherState = NULL;
   }
   else if (header->cupsColorSpace == CUPS_CSPACE_RGB &&
            (!ppd || (ppd->model_number & PCL_RASTER_RGB24)))
@@ -302,7 +375,7 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
       BlankValue = 0xff;
 
     memset(DitherLuts, 0, sizeof(DitherLuts));
-    memset(DitherStates, 0, sizeof(DitherStates));
+    DitherState = NULL;
   }
   else if ((header->cupsColorSpace == CUPS_CSPACE_K ||
             header->cupsColorSpace == CUPS_CSPACE_W) &&
@@ -321,7 +394,7 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
       BlankValue = 0xff;
 
     memset(DitherLuts, 0, sizeof(DitherLuts));
-    memset(DitherStates, 0, sizeof(DitherStates));
+    DitherState = NULL;
   }
   else
   {
@@ -438,11 +511,24 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
       else
 	DotBits[plane] = 1;
 
-      DitherStates[plane] = cupsDitherNew(header->cupsWidth);
-
       if (!DitherLuts[plane])
 	DitherLuts[plane] = cupsLutNew(2, default_lut);
     }
+
+   /*
+    * Dither all planes of a line in one pass, using ordered dithering
+    * if the PPD asks for it (typically for draft modes)...
+    */
+
+    if (ppd && (attr = cupsFindAttr(ppd, "cupsDitherMode", colormodel,
+                                    header->MediaType, resolution, spec,
+				    sizeof(spec))) != NULL &&
+        !strcmp(attr->value, "Ordered"))
+      DitherState = cupsDitherMultiNew(header->cupsWidth, PrinterPlanes,
+                                       CUPS_DITHER_ORDERED);
+    else
+      DitherState = cupsDitherMultiNew(header->cupsWidth, PrinterPlanes,
+                                       CUPS_DITHER_DIFFUSE);
   }
 
   fprintf(stderr, "DEBUG: PrinterPlanes = %d\n", PrinterPlanes);
@@ -787,6 +873,25 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
   if (header->cupsCompression && header->cupsCompression != 10)
     printf("\033*b%dM", header->cupsCompression);
 
+  CompressMode = header->cupsCompression;
+
+ /*
+  * Printers doing mode 2 or 3 also take mode 0 and 2, so each line can
+  * be sent in whichever is smallest, unless the PPD says otherwise...
+  */
+
+  if (ppd && (attr = ppdFindAttr(ppd, "cupsPCLAdaptiveCompression",
+                                 NULL)) != NULL &&
+      attr->value && (!strcasecmp(attr->value, "false") ||
+                      !strcasecmp(attr->value, "off") ||
+                      !strcasecmp(attr->value, "no")))
+    AdaptiveCompression = 0;
+  else
+    AdaptiveCompression = header->cupsCompression == 2 ||
+                          header->cupsCompression == 3;
+
+  fprintf(stderr, "DEBUG: AdaptiveCompression = %d\n", AdaptiveCompression);
+
   OutputFeed = 0;
 
  /*
@@ -818,8 +923,13 @@ StartPage(ppd_file_t         *ppd,	/* I - PPD file */
   }
 
   if (header->cupsCompression)
+  {
     CompBuffer = malloc(DotBufferSize * 4);
 
+    if (AdaptiveCompression)
+      DeltaBuffer = malloc(DotBufferSize * 4);
+  }
+
   if (header->cupsCompression >= 3)
     SeedBuffer = malloc(DotBufferSize);
 
@@ -869,11 +979,10 @@ EndPage(ppd_file_t         *ppd,	/* I - PPD file */
 
   if (OutputMode == OUTPUT_DITHERED)
   {
+    cupsDitherMultiDelete(DitherState);
+
     for (plane = 0; plane < PrinterPlanes; plane ++)
-    {
-      cupsDitherDelete(DitherStates[plane]);
       cupsLutDelete(DitherLuts[plane]);
-    }
 
     free(DotBuffers[0]);
     free(InputBuffer);
@@ -889,8 +998,13 @@ EndPage(ppd_file_t         *ppd,	/* I - PPD file */
   }
 
   if (header->cupsCompression)
+  {
     free(CompBuffer);
 
+    if (AdaptiveCompression)
+      free(DeltaBuffer);
+  }
+
   if (header->cupsCompression >= 3)
     free(SeedBuffer);
 }
@@ -979,6 +1093,39 @@ CompressData(unsigned char *line,	/* I - Data to compress */
   int		r, g, b;		/* RGB deltas for mode 10 compression */
 
 
+  if (AdaptiveCompression && (type == 2 || type == 3))
+  {
+   /*
+    * Send the line in the smallest of modes 0, 2 and 3; the printer
+    * updates the seed with every line, whatever its mode...
+    */
+
+    unsigned char	*buffers[2];	/* Candidate buffers */
+    const unsigned char	*data;		/* Data to send */
+    int			mode;		/* Mode to send in */
+
+
+    buffers[0] = CompBuffer;
+    buffers[1] = DeltaBuffer;
+    seed       = (type == 3) ? SeedBuffer + plane * length : NULL;
+
+    mode = pcl_compress_best(line, SeedInvalid ? NULL : seed, length, type,
+                             CompressMode, buffers, &data, &count);
+
+    if (mode != CompressMode)
+    {
+      printf("\033*b%dM", mode);
+      CompressMode = mode;
+    }
+
+    if (seed)
+      memcpy(seed, line, length);
+
+    printf("\033*b%d%c", count, pend);
+    cupsWritePrintData(data, count);
+    return;
+  }
+
   switch (type)
   {
     default :
@@ -1024,68 +1171,8 @@ CompressData(unsigned char *line,	/* I - Data to compress */
         * Do TIFF pack-bits encoding...
         */
 
-	line_ptr = line;
-	line_end = line + length;
-	comp_ptr = CompBuffer;
-
-	while (line_ptr < line_end)
-	{
-	  if ((line_ptr + 1) >= line_end)
-	  {
-	   /*
-	    * Single byte on the end...
-	    */
-
-	    *comp_ptr++ = 0x00;
-	    *comp_ptr++ = *line_ptr++;
-	  }
-	  else if (line_ptr[0] == line_ptr[1])
-	  {
-	   /*
-	    * Repeated sequence...
-	    */
-
-	    line_ptr ++;
-	    count = 2;
-
-	    while (line_ptr < (line_end - 1) &&
-        	   line_ptr[0] == line_ptr[1] &&
-        	   count < 127)
-	    {
-              line_ptr ++;
-              count ++;
-	    }
-
-	    *comp_ptr++ = 257 - count;
-	    *comp_ptr++ = *line_ptr++;
-	  }
-	  else
-	  {
-	   /*
-	    * Non-repeated sequence...
-	    */
-
-	    start    = line_ptr;
-	    line_ptr ++;
-	    count    = 1;
-
-	    while (line_ptr < (line_end - 1) &&
-        	   line_ptr[0] != line_ptr[1] &&
-        	   count < 127)
-	    {
-              line_ptr ++;
-              count ++;
-	    }
-
-	    *comp_ptr++ = count - 1;
-
-	    memcpy(comp_ptr, start, count);
-	    comp_ptr += count;
-	  }
-	}
-
         line_ptr = CompBuffer;
-        line_end = comp_ptr;
+        line_end = CompBuffer + pcl_compress_packbits(line, length, CompBuffer);
 	break;
 
     case 3 :
@@ -1093,106 +1180,13 @@ CompressData(unsigned char *line,	/* I - Data to compress */
 	* Do delta-row compression...
 	*/
 
-	line_ptr = line;
-	line_end = line + length;
-
-	comp_ptr = CompBuffer;
 	seed     = SeedBuffer + plane * length;
-
-	while (line_ptr < line_end)
-        {
-         /*
-          * Find the next non-matching sequence...
-          */
-
-          start = line_ptr;
-
-	  if (SeedInvalid)
-	  {
-	   /*
-	    * The seed buffer is invalid, so do the next 8 bytes, max...
-	    */
-
-	    offset = 0;
-
-	    if ((count = line_end - line_ptr) > 8)
-	      count = 8;
-
-	    line_ptr += count;
-	  }
-	  else
-	  {
-	   /*
-	    * The seed buffer is valid, so compare against it...
-	    */
-
-            while (*line_ptr == *seed &&
-                   line_ptr < line_end)
-            {
-              line_ptr ++;
-              seed ++;
-            }
-
-            if (line_ptr == line_end)
-              break;
-
-            offset = line_ptr - start;
-
-           /*
-            * Find up to 8 non-matching bytes...
-            */
-
-            start = line_ptr;
-            count = 0;
-            while (*line_ptr != *seed &&
-                   line_ptr < line_end &&
-                   count < 8)
-            {
-              line_ptr ++;
-              seed ++;
-              count ++;
-            }
-	  }
-
-         /*
-          * Place mode 3 compression data in the buffer; see HP manuals
-          * for details...
-          */
-
-          if (offset >= 31)
-          {
-           /*
-            * Output multi-byte offset...
-            */
-
-            *comp_ptr++ = ((count - 1) << 5) | 31;
-
-            offset -= 31;
-            while (offset >= 255)
-            {
-              *comp_ptr++ = 255;
-              offset    -= 255;
-            }
-
-            *comp_ptr++ = offset;
-          }
-          else
-          {
-           /*
-            * Output single-byte offset...
-            */
-
-            *comp_ptr++ = ((count - 1) << 5) | offset;
-          }
-
-          memcpy(comp_ptr, start, count);
-          comp_ptr += count;
-        }
-
 	line_ptr = CompBuffer;
-	line_end = comp_ptr;
+	line_end = CompBuffer + pcl_compress_delta(line,
+	                                           SeedInvalid ? NULL : seed,
+						   length, CompBuffer);
 
-        memcpy(SeedBuffer + plane * length, line, length);
+        memcpy(seed, line, length);
 	break;
 
     case 10 :
@@ -1700,10 +1694,6 @@ int					/* O - Number of lines (0 if blank) */
 ReadLine(cups_raster_t      *ras,	/* I - Raster stream */
          cups_page_header2_t *header)	/* I - Page header */
 {
-  int	plane,				/* Current color plane */
-	width;				/* Width of line */
-
-
  /*
   * Read raster data...
   */
@@ -1728,6 +1718,35 @@ ReadLine(cups_raster_t      *ras,	/* I - Raster stream */
   * Perform the color separation...
   */
 
+  SeparateLine(header, PixelBuffer, CMYKBuffer, InputBuffer);
+
+ /*
+  * Dither the pixels...
+  */
+
+  cupsDitherMultiLine(DitherState, DitherLuts, InputBuffer, OutputBuffers);
+
+ /*
+  * Return 1 to indicate that we have non-blank output...
+  */
+
+  return (1);
+}
+
+
+/*
+ * 'SeparateLine()' - Do the color separation of a line.
+ */
+
+void
+SeparateLine(cups_page_header2_t *header,/* I - Page header */
+             unsigned char       *pixels,/* I - Raster data */
+	     unsigned char       *cmyk,	/* I - Buffer for RGB separation */
+	     short               *input)/* O - Separated data */
+{
+  int	width;				/* Width of line */
+
+
   width = header->cupsWidth;
 
   switch (header->cupsColorSpace)
@@ -1735,57 +1754,382 @@ ReadLine(cups_raster_t      *ras,	/* I - Raster stream */
     case CUPS_CSPACE_W :
         if (RGB)
 	{
-	  cupsRGBDoGray(RGB, PixelBuffer, CMYKBuffer, width);
+	  cupsRGBDoGray(RGB, pixels, cmyk, width);
 
 	  if (RGB->num_channels == 1)
-	    cupsCMYKDoBlack(CMYK, CMYKBuffer, InputBuffer, width);
+	    cupsCMYKDoBlack(CMYK, cmyk, input, width);
 	  else
-	    cupsCMYKDoCMYK(CMYK, CMYKBuffer, InputBuffer, width);
+	    cupsCMYKDoCMYK(CMYK, cmyk, input, width);
 	}
 	else
-          cupsCMYKDoGray(CMYK, PixelBuffer, InputBuffer, width);
+          cupsCMYKDoGray(CMYK, pixels, input, width);
 	break;
 
     case CUPS_CSPACE_K :
-        cupsCMYKDoBlack(CMYK, PixelBuffer, InputBuffer, width);
+        cupsCMYKDoBlack(CMYK, pixels, input, width);
 	break;
 
     default :
     case CUPS_CSPACE_RGB :
         if (RGB)
 	{
-	  cupsRGBDoRGB(RGB, PixelBuffer, CMYKBuffer, width);
+	  cupsRGBDoRGB(RGB, pixels, cmyk, width);
 
 	  if (RGB->num_channels == 1)
-	    cupsCMYKDoBlack(CMYK, CMYKBuffer, InputBuffer, width);
+	    cupsCMYKDoBlack(CMYK, cmyk, input, width);
 	  else
-	    cupsCMYKDoCMYK(CMYK, CMYKBuffer, InputBuffer, width);
+	    cupsCMYKDoCMYK(CMYK, cmyk, input, width);
 	}
 	else
-          cupsCMYKDoRGB(CMYK, PixelBuffer, InputBuffer, width);
+          cupsCMYKDoRGB(CMYK, pixels, input, width);
 	break;
 
     case CUPS_CSPACE_CMYK :
-        cupsCMYKDoCMYK(CMYK, PixelBuffer, InputBuffer, width);
+        cupsCMYKDoCMYK(CMYK, pixels, input, width);
 	break;
   }
 
+}
+
+
+#ifdef HAVE_PTHREAD_H
+/*
+ * 'StartPipe()' - Start threads separating and dithering lines.
+ */
+
+pcl_pipe_t *				/* O - Pipeline or NULL for none */
+StartPipe(cups_page_header2_t *header)	/* I - Page header */
+{
+  pcl_pipe_t	*pipe;			/* Pipeline */
+  pcl_line_t	*line;			/* Current line */
+  int		i,			/* Looping var */
+		num_threads;		/* Number of separation threads */
+  long		num_cpus;		/* Number of processors */
+
+
+ /*
+  * One thread dithers and the main thread outputs, the rest separate...
+  */
+
+  if ((num_cpus = sysconf(_SC_NPROCESSORS_ONLN)) < 2)
+    return (NULL);
+
+  if ((num_threads = num_cpus - 2) < 1)
+    num_threads = 1;
+  else if (num_threads > PIPE_THREADS)
+    num_threads = PIPE_THREADS;
+
+  if ((pipe = calloc(1, sizeof(pcl_pipe_t))) == NULL)
+    return (NULL);
+
+  pipe->header = header;
+
+  for (i = 0, line = pipe->lines; i < PIPE_LINES; i ++, line ++)
+  {
+    line->pixels = malloc(header->cupsBytesPerLine);
+    line->input  = malloc(header->cupsWidth * PrinterPlanes * sizeof(short));
+    line->output = malloc(header->cupsWidth * PrinterPlanes);
+    if (RGB)
+      line->cmyk = malloc(header->cupsWidth * PrinterPlanes);
+
+    if (!line->pixels || !line->input || !line->output || (RGB && !line->cmyk))
+      break;
+  }
+
+  pthread_mutex_init(&pipe->mutex, NULL);
+  pthread_cond_init(&pipe->cond, NULL);
+
+  if (i == PIPE_LINES &&
+      !pthread_create(&pipe->ditherer, NULL, DitherThread, pipe))
+  {
+    while (pipe->num_threads < num_threads &&
+           !pthread_create(pipe->separators + pipe->num_threads, NULL,
+	                   SeparateThread, pipe))
+      pipe->num_threads ++;
+
+    if (pipe->num_threads > 0)
+    {
+      fprintf(stderr, "DEBUG: Separating with %d threads.\n",
+              pipe->num_threads);
+
+      pipe->saved_output = OutputBuffers[0];
+
+      return (pipe);
+    }
+
+    pthread_mutex_lock(&pipe->mutex);
+    pipe->stop = 1;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->mutex);
+
+    pthread_join(pipe->ditherer, NULL);
+  }
+
  /*
-  * Dither the pixels...
+  * Unable to start, process lines without threads...
   */
 
-  for (plane = 0; plane < PrinterPlanes; plane ++)
-    cupsDitherLine(DitherStates[plane], DitherLuts[plane], InputBuffer + plane,
-                   PrinterPlanes, OutputBuffers[plane]);
+  fputs("DEBUG: Unable to start separation threads.\n", stderr);
+
+  pthread_cond_destroy(&pipe->cond);
+  pthread_mutex_destroy(&pipe->mutex);
+
+  for (i = 0, line = pipe->lines; i < PIPE_LINES; i ++, line ++)
+  {
+    free(line->pixels);
+    free(line->input);
+    free(line->output);
+    free(line->cmyk);
+  }
+
+  free(pipe);
+
+  return (NULL);
+}
+
+
+/*
+ * 'WritePipeLine()' - Output the oldest line of the pipeline.
+ */
+
+void
+WritePipeLine(pcl_pipe_t *pipe,		/* I - Pipeline */
+              ppd_file_t *ppd)		/* I - PPD file */
+{
+  pcl_line_t	*line;			/* Line to output */
+  int		plane;			/* Current plane */
+
+
+  line = pipe->lines + pipe->num_written % PIPE_LINES;
+
+  pthread_mutex_lock(&pipe->mutex);
+  while (pipe->num_dithered <= pipe->num_written)
+    pthread_cond_wait(&pipe->cond, &pipe->mutex);
+  pthread_mutex_unlock(&pipe->mutex);
+
+  if (line->state == LINE_BLANK)
+    OutputFeed ++;
+  else
+  {
+    for (plane = 0; plane < PrinterPlanes; plane ++)
+      OutputBuffers[plane] = line->output + plane * pipe->header->cupsWidth;
+
+    OutputLine(ppd, pipe->header);
+  }
+
+  pthread_mutex_lock(&pipe->mutex);
+  line->state = LINE_FREE;
+  pipe->num_written ++;
+  pthread_mutex_unlock(&pipe->mutex);
+}
+
+
+/*
+ * 'PipeLine()' - Read a line into the pipeline, output an old one.
+ */
+
+void
+PipeLine(pcl_pipe_t    *pipe,		/* I - Pipeline */
+         cups_raster_t *ras,		/* I - Raster stream */
+	 ppd_file_t    *ppd)		/* I - PPD file */
+{
+  pcl_line_t		*line;		/* Line to read */
+  cups_page_header2_t	*header = pipe->header;
+					/* Page header */
+  int			blank;		/* Is the line blank? */
+
 
  /*
-  * Return 1 to indicate that we have non-blank output...
+  * Make room...
   */
 
-  return (1);
+  if (pipe->num_read - pipe->num_written >= PIPE_LINES)
+    WritePipeLine(pipe, ppd);
+
+ /*
+  * Read raster data; only this thread uses free lines...
+  */
+
+  line = pipe->lines + pipe->num_read % PIPE_LINES;
+
+  cupsRasterReadPixels(ras, line->pixels, header->cupsBytesPerLine);
+
+  blank = cupsCheckValue(line->pixels, header->cupsBytesPerLine, BlankValue);
+
+  pthread_mutex_lock(&pipe->mutex);
+  line->state = blank ? LINE_BLANK : LINE_READ;
+  pipe->num_read ++;
+  pthread_cond_broadcast(&pipe->cond);
+  pthread_mutex_unlock(&pipe->mutex);
 }
 
 
+/*
+ * 'FinishPipe()' - Output the remaining lines and stop the threads.
+ */
+
+void
+FinishPipe(pcl_pipe_t *pipe,		/* I - Pipeline */
+           ppd_file_t *ppd)		/* I - PPD file */
+{
+  pcl_line_t	*line;			/* Current line */
+  int		i;			/* Looping var */
+
+
+  pthread_mutex_lock(&pipe->mutex);
+  pipe->done = 1;
+  pthread_cond_broadcast(&pipe->cond);
+  pthread_mutex_unlock(&pipe->mutex);
+
+  while (!Canceled && pipe->num_written < pipe->num_read)
+    WritePipeLine(pipe, ppd);
+
+  pthread_mutex_lock(&pipe->mutex);
+  pipe->stop = 1;
+  pthread_cond_broadcast(&pipe->cond);
+  pthread_mutex_unlock(&pipe->mutex);
+
+  pthread_join(pipe->ditherer, NULL);
+  for (i = 0; i < pipe->num_threads; i ++)
+    pthread_join(pipe->separators[i], NULL);
+
+  pthread_cond_destroy(&pipe->cond);
+  pthread_mutex_destroy(&pipe->mutex);
+
+ /*
+  * Give the page its own buffers back...
+  */
+
+  for (i = 0; i < PrinterPlanes; i ++)
+    OutputBuffers[i] = pipe->saved_output + i * pipe->header->cupsWidth;
+
+  for (i = 0, line = pipe->lines; i < PIPE_LINES; i ++, line ++)
+  {
+    free(line->pixels);
+    free(line->input);
+    free(line->output);
+    free(line->cmyk);
+  }
+
+  free(pipe);
+}
+
+
+/*
+ * 'DitherThread()' - Dither the separated lines in order.
+ */
+
+void *					/* O - Thread exit status */
+DitherThread(void *data)		/* I - Pipeline */
+{
+  pcl_pipe_t	*pipe = (pcl_pipe_t *)data;
+					/* Pipeline */
+  pcl_line_t	*line;			/* Current line */
+  unsigned char	*outputs[6];		/* Dithered planes */
+  int		plane;			/* Current plane */
+
+
+  pthread_mutex_lock(&pipe->mutex);
+
+  for (;;)
+  {
+    if (pipe->stop ||
+        (pipe->done && pipe->num_dithered == pipe->num_read))
+      break;
+
+    line = pipe->lines + pipe->num_dithered % PIPE_LINES;
+
+    if (pipe->num_dithered == pipe->num_read ||
+        (line->state != LINE_BLANK && line->state != LINE_SEPARATED))
+    {
+      pthread_cond_wait(&pipe->cond, &pipe->mutex);
+      continue;
+    }
+
+   /*
+    * Blank lines leave the dither state alone, like without threads...
+    */
+
+    if (line->state == LINE_SEPARATED)
+    {
+      pthread_mutex_unlock(&pipe->mutex);
+
+      for (plane = 0; plane < PrinterPlanes; plane ++)
+        outputs[plane] = line->output + plane * pipe->header->cupsWidth;
+
+      cupsDitherMultiLine(DitherState, DitherLuts, line->input, outputs);
+
+      pthread_mutex_lock(&pipe->mutex);
+      line->state = LINE_DITHERED;
+    }
+
+    pipe->num_dithered ++;
+    pthread_cond_broadcast(&pipe->cond);
+  }
+
+  pthread_mutex_unlock(&pipe->mutex);
+
+  return (NULL);
+}
+
+
+/*
+ * 'SeparateThread()' - Separate the lines read.
+ */
+
+void *					/* O - Thread exit status */
+SeparateThread(void *data)		/* I - Pipeline */
+{
+  pcl_pipe_t	*pipe = (pcl_pipe_t *)data;
+					/* Pipeline */
+  pcl_line_t	*line;			/* Current line */
+  int		i;			/* Looping var */
+
+
+  pthread_mutex_lock(&pipe->mutex);
+
+  for (;;)
+  {
+    if (pipe->stop)
+      break;
+
+   /*
+    * Take the oldest line not separated yet...
+    */
+
+    for (i = pipe->num_dithered, line = NULL; i < pipe->num_read; i ++)
+      if (pipe->lines[i % PIPE_LINES].state == LINE_READ)
+      {
+        line = pipe->lines + i % PIPE_LINES;
+	break;
+      }
+
+    if (!line)
+    {
+      if (pipe->done)
+        break;
+
+      pthread_cond_wait(&pipe->cond, &pipe->mutex);
+      continue;
+    }
+
+    line->state = LINE_SEPARATING;
+    pthread_mutex_unlock(&pipe->mutex);
+
+    SeparateLine(pipe->header, line->pixels, line->cmyk, line->input);
+
+    pthread_mutex_lock(&pipe->mutex);
+    line->state = LINE_SEPARATED;
+    pthread_cond_broadcast(&pipe->cond);
+  }
+
+  pthread_mutex_unlock(&pipe->mutex);
+
+  return (NULL);
+}
+#endif /* HAVE_PTHREAD_H */
+
+
 /*
  * 'main()' - Main entry and processing of driver.
  */
@@ -1803,6 +2147,9 @@ main(int  argc,				/* I - Number of command-line arguments */
   int			job_id;		/* Job ID */
   int			num_options;	/* Number of options */
   cups_option_t		*options;	/* Options */
+#ifdef HAVE_PTHREAD_H
+  pcl_pipe_t		*pipe;		/* Line pipeline */
+#endif /* HAVE_PTHREAD_H */
 #if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
   struct sigaction action;		/* Actions for POSIX signals */
 #endif /* HAVE_SIGACTION && !HAVE_SIGSET */
@@ -1914,6 +2261,10 @@ main(int  argc,				/* I - Number of command-line arguments */
     StartPage(ppd, &header, atoi(argv[1]), argv[2], argv[3],
               num_options, options);
 
+#ifdef HAVE_PTHREAD_H
+    pipe = OutputMode == OUTPUT_DITHERED ? StartPipe(&header) : NULL;
+#endif /* HAVE_PTHREAD_H */
+
     for (y = 0; y < (int)header.cupsHeight; y ++)
     {
      /*
@@ -1935,12 +2286,25 @@ main(int  argc,				/* I - Number of command-line arguments */
       * Read and write a line of graphics or whitespace...
       */
 
+#ifdef HAVE_PTHREAD_H
+      if (pipe)
+      {
+        PipeLine(pipe, ras, ppd);
+	continue;
+      }
+#endif /* HAVE_PTHREAD_H */
+
       if (ReadLine(ras, &header))
         OutputLine(ppd, &header);
       else
         OutputFeed ++;
     }
 
+#ifdef HAVE_PTHREAD_H
+    if (pipe)
+      FinishPipe(pipe, ppd);
+#endif /* HAVE_PTHREAD_H */
+
    /*
     * Eject the page...
     */
@@ -0,0 +1,355 @@
+/*
+ *   PCL raster compression test and benchmark for CUPS.
+ *
+ *   This file is licensed as noted in "COPYING"
+ *   which should have been included with this file.
+ *
+ * Contents:
+ *
+ *   main()        - Compress generated pages, check and time the results.
+ *   decode_line() - Decode a line like the printer does.
+ *   make_page()   - Generate a page of raster data.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "pcl-compress.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/*
+ * Page size: 8.5x11" bitmap at 600dpi...
+ */
+
+#define BYTES	638
+#define LINES	6600
+
+
+/*
+ * Local functions...
+ */
+
+static int	decode_line(int mode, const unsigned char *data, int datalen,
+		            unsigned char *seed, int length);
+static void	make_page(unsigned char *page, int type);
+
+
+/*
+ * 'main()' - Compress generated pages, check and time the results.
+ */
+
+int					/* O - Exit status */
+main(int  argc,				/* I - Number of command-line arguments */
+     char *argv[])			/* I - Command-line arguments */
+{
+  static const char * const types[] =	/* Page contents */
+  {
+    "blank",
+    "text",
+    "halftone",
+    "noise"
+  };
+  static const char * const methods[] =	/* Ways to compress */
+  {
+    "mode 2",
+    "mode 3",
+    "adaptive"
+  };
+  unsigned char	*page,			/* Page data */
+		*seed,			/* Seed line */
+		*buffers[2];		/* Compression buffers */
+  const unsigned char *data;		/* Compressed line */
+  int		type,			/* Page contents */
+		method,			/* Way to compress */
+		y,			/* Current line */
+		mode,			/* Mode of current line */
+		cur_mode,		/* Mode of the printer */
+		datalen,		/* Length of compressed line */
+		rounds,			/* Number of times to compress */
+		round,			/* Current round */
+		errors = 0;		/* Number of errors */
+  long		bytes;			/* Output bytes per page */
+  char		cmd[32];		/* Raster command */
+  struct timespec start, end;		/* Timing */
+  double	secs;			/* Seconds to compress all rounds */
+
+
+  rounds = argc > 1 ? atoi(argv[1]) : 1;
+  if (rounds < 1)
+    rounds = 1;
+
+  page       = malloc(BYTES * LINES);
+  seed       = malloc(BYTES);
+  buffers[0] = malloc(2 * BYTES + 16);
+  buffers[1] = malloc(2 * BYTES + 16);
+
+  if (!page || !seed || !buffers[0] || !buffers[1])
+  {
+    puts("Unable to allocate memory");
+    return (1);
+  }
+
+  for (type = 0; type < (int)(sizeof(types) / sizeof(types[0])); type ++)
+  {
+    make_page(page, type);
+
+    for (method = 0; method < (int)(sizeof(methods) / sizeof(methods[0]));
+         method ++)
+    {
+     /*
+      * Time the compression...
+      */
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+
+      for (round = 0; round < rounds; round ++)
+      {
+        memset(seed, 0, BYTES);
+	cur_mode = method == 0 ? 2 : 3;
+
+	for (y = 0; y < LINES; y ++)
+	{
+	  const unsigned char *line = page + y * BYTES;
+
+	  if (method == 0)
+	    pcl_compress_packbits(line, BYTES, buffers[0]);
+	  else if (method == 1)
+	    pcl_compress_delta(line, y ? seed : NULL, BYTES, buffers[1]);
+	  else
+	    cur_mode = pcl_compress_best(line, y ? seed : NULL, BYTES, 3,
+	                                 cur_mode, buffers, &data, &datalen);
+
+	  if (method)
+	    memcpy(seed, line, BYTES);
+	}
+      }
+
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+     /*
+      * Count the output bytes and decode them again...
+      */
+
+      memset(seed, 0, BYTES);
+      cur_mode = method == 0 ? 2 : 3;
+      bytes    = 5;			/* Initial "\033*b#M" */
+
+      for (y = 0; y < LINES; y ++)
+      {
+	const unsigned char *line = page + y * BYTES;
+
+	if (method == 0)
+	{
+	  mode    = 2;
+	  data    = buffers[0];
+	  datalen = pcl_compress_packbits(line, BYTES, buffers[0]);
+	}
+	else if (method == 1)
+	{
+	  mode    = 3;
+	  data    = buffers[1];
+	  datalen = pcl_compress_delta(line, y ? seed : NULL, BYTES,
+	                               buffers[1]);
+	}
+	else
+	  mode = pcl_compress_best(line, y ? seed : NULL, BYTES, 3, cur_mode,
+	                           buffers, &data, &datalen);
+
+        if (mode != cur_mode)
+	{
+	  bytes    += PCL_MODE_SWITCH_SIZE;
+	  cur_mode = mode;
+	}
+
+	bytes += snprintf(cmd, sizeof(cmd), "\033*b%dW", datalen) + datalen;
+
+	if (decode_line(mode, data, datalen, seed, BYTES) ||
+	    memcmp(seed, line, BYTES))
+	{
+	  printf("%s page, %s: line %d does not decode\n", types[type],
+	         methods[method], y);
+	  errors ++;
+	  break;
+	}
+      }
+
+      printf("%-8s page, %-8s: %8.1f MB/s, %8ld bytes/page\n", types[type],
+             methods[method],
+	     secs > 0.0 ? (double)BYTES * LINES * rounds / secs / 1e6 : 0.0,
+	     bytes);
+    }
+  }
+
+  free(page);
+  free(seed);
+  free(buffers[0]);
+  free(buffers[1]);
+
+  return (errors ? 1 : 0);
+}
+
+
+/*
+ * 'decode_line()' - Decode a line like the printer does.
+ *
+ * The seed holds the previous line and receives the decoded one...
+ */
+
+static int				/* O - 0 on success */
+decode_line(int                 mode,	/* I - Compression mode */
+            const unsigned char *data,	/* I - Compressed data */
+	    int                 datalen,/* I - Length of data */
+	    unsigned char       *seed,	/* IO - Seed line */
+	    int                 length)	/* I - Length of line */
+{
+  const unsigned char	*end = data + datalen;
+					/* End of data */
+  int			pos = 0,	/* Position in line */
+			count,		/* Count of bytes */
+			offset;		/* Offset of bytes */
+
+
+  switch (mode)
+  {
+    case 0 :
+        if (datalen > length)
+	  return (-1);
+
+        memcpy(seed, data, datalen);
+	memset(seed + datalen, 0, length - datalen);
+        break;
+
+    case 2 :
+        while (data < end)
+	{
+	  count = *data++;
+
+	  if (count < 128)
+	  {
+	    count ++;
+	    if (data + count > end || pos + count > length)
+	      return (-1);
+
+	    memcpy(seed + pos, data, count);
+	    data += count;
+	  }
+	  else if (count > 128)
+	  {
+	    count = 257 - count;
+	    if (data >= end || pos + count > length)
+	      return (-1);
+
+	    memset(seed + pos, *data++, count);
+	  }
+	  else
+	    continue;
+
+	  pos += count;
+	}
+
+	memset(seed + pos, 0, length - pos);
+        break;
+
+    case 3 :
+        while (data < end)
+	{
+	  count  = (*data >> 5) + 1;
+	  offset = *data++ & 31;
+
+	  if (offset == 31)
+	  {
+	    do
+	    {
+	      if (data >= end)
+	        return (-1);
+
+	      offset += *data;
+	    }
+	    while (*data++ == 255);
+	  }
+
+	  pos += offset;
+	  if (data + count > end || pos + count > length)
+	    return (-1);
+
+	  memcpy(seed + pos, data, count);
+	  data += count;
+	  pos  += count;
+	}
+        break;
+
+    default :
+        return (-1);
+  }
+
+  return (0);
+}
+
+
+/*
+ * 'make_page()' - Generate a page of raster data.
+ */
+
+static void
+make_page(unsigned char *page,		/* O - Page data */
+          int           type)		/* I - Page contents */
+{
+  int		x, y;			/* Looping vars */
+  unsigned	state = 1;		/* Random state */
+
+
+  memset(page, 0, BYTES * LINES);
+
+  switch (type)
+  {
+    case 1 :				/* Text: lines of "glyphs" */
+        for (y = 300; y < LINES - 300; y ++)
+	{
+	  if ((y % 100) >= 60)
+	    continue;			/* Line spacing */
+
+	  for (x = 40; x < BYTES - 40; x ++)
+	  {
+	    state = state * 1103515245 + 12345;
+
+	    if ((x % 6) < 5 && (state >> 28) < 6)
+	      page[y * BYTES + x] = (state >> 16) & 0xff;
+	  }
+
+	  if ((y % 100) & 1)		/* Vertical strokes repeat */
+	    memcpy(page + y * BYTES, page + (y - 1) * BYTES, BYTES);
+	}
+        break;
+
+    case 2 :				/* Halftone: gradient with 4x4 dots */
+        for (y = 0; y < LINES; y ++)
+	  for (x = 0; x < BYTES; x ++)
+	  {
+	    static const unsigned char patterns[4][4] =
+	    {
+	      { 0x00, 0x00, 0x00, 0x00 },
+	      { 0x88, 0x00, 0x22, 0x00 },
+	      { 0xaa, 0x55, 0xaa, 0x55 },
+	      { 0xee, 0xff, 0xbb, 0xff }
+	    };
+
+	    page[y * BYTES + x] = patterns[x * 4 / BYTES][y & 3];
+	  }
+        break;
+
+    case 3 :				/* Noise: error diffused photo */
+        for (y = 0; y < LINES; y ++)
+	  for (x = 0; x < BYTES; x ++)
+	  {
+	    state = state * 1103515245 + 12345;
+	    page[y * BYTES + x] = (state >> 16) & 0xff;
+	  }
+        break;
+  }
+}
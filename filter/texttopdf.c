@@ -29,6 +29,7 @@
 #include "fontembed/embed.h"
 #include <assert.h>
 #include "fontembed/sfnt.h"
+#include "fontcache.h"
 #include <fontconfig/fontconfig.h>
 
 /*
@@ -54,6 +55,8 @@ EMB_PARAMS *font_load(const char *font, int fontwidth)
   if ( (font[0]=='/')||(font[0]=='.') ) {
     candidates = NULL;
     fontname=(FcChar8 *)strdup(font);
+  } else if ((fontname=(FcChar8 *)fontcache_lookup(font,fontwidth)) != NULL) {
+    // resolved by an earlier job
   } else {
     FcInit ();
     pattern = FcNameParse ((const FcChar8 *)font);
@@ -86,6 +89,9 @@ EMB_PARAMS *font_load(const char *font, int fontwidth)
       }
       FcFontSetDestroy (candidates);
     }
+    if (fontname) {
+      fontcache_store(font,fontwidth,(const char *)fontname);
+    }
   }
 
   if (!fontname) {
@@ -816,6 +822,8 @@ WriteProlog(const char *title,		/* I - Title of job */
   }
   // }}}
 
+  fontcache_flush();
+
   if (NumFonts==0) {
     fprintf(stderr, "ERROR: No usable font available\n");
     exit(1);
@@ -351,6 +351,14 @@ void otf_close(OTF_FILE *otf) // {{{
     free(otf->cmap);
     free(otf->name);
     free(otf->hmtx);
+    free(otf->widths);
+    if (otf->unipages) {
+      int iA;
+      for (iA=0;iA<256;iA++) {
+        free(otf->unipages[iA]);
+      }
+      free(otf->unipages);
+    }
     free(otf->glyphOffsets);
     fclose(otf->f);
     free(otf->tables);
@@ -562,6 +570,18 @@ int otf_load_more(OTF_FILE *otf) // {{{  - 0 on success   => hhea,hmtx,name,[gly
   otf->hmtx=hmtx;
   // }}}
 
+  // {{{ decode widths
+  if (otf->numberOfHMetrics>0) {
+    otf->widths=malloc(otf->numGlyphs*sizeof(unsigned short));
+    if (otf->widths) { // otherwise: get_width_fast uses >hmtx directly
+      for (iA=0;iA<otf->numGlyphs;iA++) {
+        const int pos=(iA<otf->numberOfHMetrics)?iA:otf->numberOfHMetrics-1;
+        otf->widths[iA]=get_USHORT(hmtx+pos*4);
+      }
+    }
+  }
+  // }}}
+
   // {{{ read name table
   char *name=otf_get_table(otf,OTF_TAG('n','a','m','e'),&len);
   if ( (!name)||
@@ -593,6 +613,63 @@ int otf_load_more(OTF_FILE *otf) // {{{  - 0 on success   => hhea,hmtx,name,[gly
 }
 // }}}
 
+// decode the whole (3,1) format 4 map into a two-level table;
+// segments with glyphIdArray references outside of the cmap table are left out
+static void otf_build_unipages(OTF_FILE *otf,int cmap_len) // {{{
+{
+  assert(otf->unimap);
+  const char *cmap_end=otf->cmap+cmap_len;
+  const unsigned short segCountX2=get_USHORT(otf->unimap+6);
+  const char *endCodes=otf->unimap+14;
+  const char *startCodes=endCodes+2+segCountX2;
+  const char *rangeOffsets=startCodes+2*segCountX2;
+  if (rangeOffsets+segCountX2>cmap_end) {
+    return;
+  }
+
+  otf->unipages=calloc(256,sizeof(unsigned short *));
+  if (!otf->unipages) {
+    return; // will use the cmap directly
+  }
+  int iA,next=0; // endCode[] is sorted; don't decode overlaps twice
+  for (iA=0;iA<segCountX2;iA+=2) {
+    const int endCode=get_USHORT(endCodes+iA);
+    int code=get_USHORT(startCodes+iA);
+    const unsigned short rangeOffset=get_USHORT(rangeOffsets+iA);
+    if ( (rangeOffset)&&
+         (rangeOffsets+iA+rangeOffset+2*(endCode-code)+2>cmap_end) ) {
+      continue;
+    }
+    if (code<next) {
+      code=next;
+    }
+    for (;code<=endCode;code++) {
+      const unsigned short gid=otf_unimap_lookup(otf,code);
+      if (!gid) {
+        continue;
+      }
+      unsigned short **page=otf->unipages+(code>>8);
+      if (!*page) {
+        *page=calloc(256,sizeof(unsigned short));
+        if (!*page) {
+          fprintf(stderr,"Bad alloc: %s\n", strerror(errno));
+          for (iA=0;iA<256;iA++) {
+            free(otf->unipages[iA]);
+          }
+          free(otf->unipages);
+          otf->unipages=NULL;
+          return;
+        }
+      }
+      (*page)[code&0xff]=gid;
+    }
+    if (endCode+1>next) {
+      next=endCode+1;
+    }
+  }
+}
+// }}}
+
 int otf_load_cmap(OTF_FILE *otf) // {{{  - 0 on success
 {
   int iA;
@@ -633,6 +710,10 @@ int otf_load_cmap(OTF_FILE *otf) // {{{  - 0 on success
   }
   otf->cmap=cmap;
 
+  if (otf->unimap) {
+    otf_build_unipages(otf,len);
+  }
+
   return 0;
 }
 // }}}
@@ -753,6 +834,17 @@ unsigned short otf_from_unicode(OTF_FILE *otf,int unicode) // {{{ 0 = missing
     return 0;
   }
 
+  if (otf->unipages) {
+    const unsigned short *page=otf->unipages[unicode>>8];
+    return (page)?page[unicode&0xff]:0;
+  }
+  return otf_unimap_lookup(otf,unicode);
+}
+// }}}
+
+unsigned short otf_unimap_lookup(OTF_FILE *otf,int unicode) // {{{ 0 = missing
+{
+  assert(otf->unimap);
 #if 0
   // linear search is cache friendly and should be quite fast
 #else
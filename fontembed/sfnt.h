@@ -33,6 +33,10 @@ typedef struct {
   char *gly;
   OTF_DIRENT *glyfTable;
 
+  // decoded from >unimap and >hmtx, for fast per-character lookup
+  unsigned short **unipages; // [256] pages of [256] gids, NULL: no glyphs in page
+  unsigned short *widths;    // [numGlyphs]
+
 } OTF_FILE;
 #define OTF_F_FMT_CFF      0x10000
 #define OTF_F_DO_CHECKSUM  0x40000
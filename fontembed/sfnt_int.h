@@ -61,7 +61,9 @@ static inline unsigned int otf_checksum(const char *buf, unsigned int len) // {{
 // }}}
 static inline int get_width_fast(OTF_FILE *otf,int gid) // {{{
 {
-  if (gid>=otf->numberOfHMetrics) {
+  if (otf->widths) {
+    return otf->widths[gid];
+  } else if (gid>=otf->numberOfHMetrics) {
     return get_USHORT(otf->hmtx+(otf->numberOfHMetrics-1)*4);
   } else {
     return get_USHORT(otf->hmtx+gid*4);
@@ -74,6 +76,9 @@ int otf_load_more(OTF_FILE *otf); //  - 0 on success
 
 int otf_find_table(OTF_FILE *otf,unsigned int tag); // - table_index  or -1 on error
 
+// lookup in the raw cmap, without >unipages; >cmap must be loaded
+unsigned short otf_unimap_lookup(OTF_FILE *otf,int unicode); // 0 = missing
+
 int otf_action_copy(void *param,int csum,OUTPUT_FN output,void *context);
 int otf_action_replace(void *param,int csum,OUTPUT_FN output,void *context);
 
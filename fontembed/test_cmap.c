@@ -0,0 +1,173 @@
+#include "sfnt.h"
+#include "sfnt_int.h"
+#include "config.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Checks the decoded unicode->gid and width tables against the raw font
+// tables. Given a text file (UTF-8), also measures lookups per second
+// for its characters, with and without the decoded tables.
+
+static double now(void) // {{{
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+// }}}
+
+static int check_tables(OTF_FILE *otf) // {{{ - number of mismatches
+{
+  int iA,ret=0;
+
+  if (!otf->unipages) {
+    printf("NOTE: no decoded cmap\n");
+  } else {
+    for (iA=0;iA<65536;iA++) {
+      const unsigned short page_gid=(otf->unipages[iA>>8])?otf->unipages[iA>>8][iA&0xff]:0;
+      if (page_gid!=otf_unimap_lookup(otf,iA)) {
+        printf("U+%04X: %d, cmap says %d\n",iA,page_gid,otf_unimap_lookup(otf,iA));
+        ret++;
+      }
+    }
+  }
+
+  if (!otf->widths) {
+    printf("NOTE: no decoded widths\n");
+  } else {
+    for (iA=0;iA<otf->numGlyphs;iA++) {
+      const int pos=(iA<otf->numberOfHMetrics)?iA:otf->numberOfHMetrics-1;
+      if (otf->widths[iA]!=get_USHORT(otf->hmtx+pos*4)) {
+        printf("gid %d: width %d, hmtx says %d\n",iA,otf->widths[iA],get_USHORT(otf->hmtx+pos*4));
+        ret++;
+      }
+    }
+  }
+  return ret;
+}
+// }}}
+
+// BMP only, as texttopdf
+static int *read_utf8(const char *fn,int *ret_len) // {{{
+{
+  FILE *f=fopen(fn,"rb");
+  if (!f) {
+    return NULL;
+  }
+  int len=0,alloc=4096;
+  int *ret=malloc(alloc*sizeof(int));
+  int ch,code=0,more=0;
+  while ( (ret)&&((ch=getc(f))!=EOF) ) {
+    if ( (ch&0xc0)==0x80 ) {
+      if (!more) {
+        continue;
+      }
+      code=(code<<6)|(ch&0x3f);
+      if (--more) {
+        continue;
+      }
+    } else if (ch<0x80) {
+      code=ch;
+    } else if ( (ch&0xe0)==0xc0 ) {
+      code=ch&0x1f;
+      more=1;
+      continue;
+    } else if ( (ch&0xf0)==0xe0 ) {
+      code=ch&0x0f;
+      more=2;
+      continue;
+    } else {
+      more=0;
+      continue;
+    }
+    if (code>0xffff) {
+      continue;
+    }
+    if (len>=alloc) {
+      alloc*=2;
+      int *tmp=realloc(ret,alloc*sizeof(int));
+      if (!tmp) {
+        free(ret);
+        ret=NULL;
+        break;
+      }
+      ret=tmp;
+    }
+    ret[len++]=code;
+  }
+  fclose(f);
+  *ret_len=len;
+  return ret;
+}
+// }}}
+
+static double bench(OTF_FILE *otf,const int *text,int len,int rounds,int *found) // {{{ - lookups/s
+{
+  int iA,iB;
+  long sum=0;
+  *found=0;
+  const double start=now();
+  for (iB=0;iB<rounds;iB++) {
+    for (iA=0;iA<len;iA++) {
+      const unsigned short gid=otf_from_unicode(otf,text[iA]);
+      if (gid) {
+        sum+=get_width_fast(otf,gid);
+        (*found)++;
+      }
+    }
+  }
+  const double secs=now()-start;
+  if (sum==-1) { // keep the loop
+    printf("\n");
+  }
+  return (secs>0)?(double)len*rounds/secs:0;
+}
+// }}}
+
+int main(int argc,char **argv)
+{
+  const char *fn=TESTFONT;
+  if (argc>=2) {
+    fn=argv[1];
+  }
+  OTF_FILE *otf=otf_load(fn);
+  if (!otf) {
+    printf("Font %s was not loaded, exiting.\n", fn);
+    return 1;
+  }
+  otf_from_unicode(otf,' '); // load cmap
+  otf_get_width(otf,0); // load hmtx
+
+  const int bad=check_tables(otf);
+  printf("%d mismatches\n",bad);
+
+  if (argc>=3) {
+    int len=0;
+    int *text=read_utf8(argv[2],&len);
+    if ( (!text)||(!len) ) {
+      printf("Could not read %s\n",argv[2]);
+      otf_close(otf);
+      return 1;
+    }
+    const int rounds=(argc>=4)?atoi(argv[3]):10;
+    int found;
+    const double fast=bench(otf,text,len,rounds,&found);
+    printf("decoded tables: %.0f lookups/s (%d chars, %d found)\n",fast,len,found/rounds);
+
+    unsigned short **unipages=otf->unipages;
+    unsigned short *widths=otf->widths;
+    otf->unipages=NULL;
+    otf->widths=NULL;
+    const double slow=bench(otf,text,len,rounds,&found);
+    otf->unipages=unipages;
+    otf->widths=widths;
+    printf("raw tables:     %.0f lookups/s (%.1fx)\n",slow,(slow>0)?fast/slow:0);
+    free(text);
+  }
+
+  otf_close(otf);
+
+  return (bad)?1:0;
+}
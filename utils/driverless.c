@@ -31,11 +31,20 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <sys/time.h>
 #include <cups/cups.h>
 #include <cups/ppd.h>
 #include <cups/raster.h>
 #include <cupsfilters/ipp.h>
 #include <cupsfilters/ppdgenerator.h>
+#ifdef HAVE_AVAHI
+#include <avahi-client/client.h>
+#include <avahi-client/lookup.h>
+
+#include <avahi-common/simple-watch.h>
+#include <avahi-common/malloc.h>
+#include <avahi-common/error.h>
+#endif /* HAVE_AVAHI */
 
 #define MAX_OUTPUT_LEN 8192
 
@@ -360,6 +369,334 @@ listPrintersInArray(int reg_type_no, int mode, int isFax,
   return;
 }
 
+/*
+ * Service discovery
+ *
+ * The printers are discovered either in-process via Avahi or by running
+ * CUPS' ippfind utility. Both result in lines of the same tab-separated
+ * format (the format which we make ippfind output), without the leading
+ * scheme, which are collected in one array for IPP and one for IPPS and
+ * then turned into the output lines by listPrintersInArray().
+ *
+ * For testing without real printers the environment variable
+ * DRIVERLESS_SERVICES can point to a file which replaces the DNS-SD
+ * browsing, with one service per line, tab-separated:
+ *
+ *   scheme name domain hostname port local key=value key=value ...
+ *
+ * "scheme" is "ipp" or "ipps", "local" is 1 if the service is on the
+ * local machine, 0 otherwise, and the key=value pairs are the TXT record.
+ * These services are filtered and formatted exactly as the ones found
+ * via Avahi.
+ */
+
+static int
+service_txt_has_pdl(int num_txt, cups_option_t *txt, const char *format)
+{
+  const char	*pdl = cupsGetOption("pdl", num_txt, txt),
+		*ptr;
+  size_t	len = strlen(format);
+
+  /* Same as ippfind's "--txt-pdl": format is one of the comma-separated
+     MIME types in the "pdl" TXT record entry */
+  for (ptr = pdl; ptr && *ptr; ptr = strchr(ptr, ',')) {
+    if (*ptr == ',')
+      ptr ++;
+    if (!strncasecmp(ptr, format, len) && (ptr[len] == ',' || !ptr[len]))
+      return (1);
+  }
+  return (0);
+}
+
+static void
+add_service(cups_array_t  *service_uri_list_ipp,
+					/* I - Array for IPP services */
+	    cups_array_t  *service_uri_list_ipps,
+					/* I - Array for IPPS services */
+	    int           mode,		/* I - Output mode */
+	    int           isFax,	/* I - Only fax services? */
+	    const char    *scheme,	/* I - "ipp" or "ipps" */
+	    const char    *name,	/* I - DNS-SD service name */
+	    const char    *domain,	/* I - DNS-SD domain */
+	    const char    *hostname,	/* I - Host name of the service */
+	    int           port,		/* I - Port of the service */
+	    int           is_local,	/* I - Service on local machine? */
+	    int           num_txt,	/* I - Number of TXT record entries */
+	    cups_option_t *txt)		/* I - TXT record entries */
+{
+  char		line[MAX_OUTPUT_LEN];	/* Entry as ippfind would output it */
+  const char	*val;
+  cups_array_t	*list;
+
+#define TXT(key) ((val = cupsGetOption(key, num_txt, txt)) != NULL ? val : "")
+
+  /* Same criteria as the ippfind expression in list_printers() */
+  if (cupsGetOption("printer-type", num_txt, txt))
+    return;
+  if (isFax && !cupsGetOption("rfo", num_txt, txt))
+    return;
+  if (!service_txt_has_pdl(num_txt, txt, "image/pwg-raster") &&
+#ifdef QPDF_HAVE_PCLM
+      !service_txt_has_pdl(num_txt, txt, "application/PCLm") &&
+#endif
+#ifdef CUPS_RASTER_HAVE_APPLERASTER
+      !service_txt_has_pdl(num_txt, txt, "image/urf") &&
+#endif
+      !service_txt_has_pdl(num_txt, txt, "application/pdf"))
+    return;
+
+  if (mode < 0)
+    snprintf(line, sizeof(line), "%s\t%s\t%d\t%s", hostname,
+	     isFax ? TXT("rfo") : TXT("rp"), port, is_local ? "L" : "");
+  else if (mode > 0) {
+    snprintf(line, sizeof(line), "%s\t%s\t", name, domain);
+    snprintf(line + strlen(line), sizeof(line) - strlen(line),
+	     "%s\t", TXT("usb_MFG"));
+    snprintf(line + strlen(line), sizeof(line) - strlen(line),
+	     "%s\t", TXT("usb_MDL"));
+    snprintf(line + strlen(line), sizeof(line) - strlen(line),
+	     "%s\t", TXT("product"));
+    snprintf(line + strlen(line), sizeof(line) - strlen(line),
+	     "%s\t", TXT("ty"));
+    snprintf(line + strlen(line), sizeof(line) - strlen(line),
+	     "%s\t", TXT("pdl"));
+    snprintf(line + strlen(line), sizeof(line) - strlen(line),
+	     "%s\t", TXT("UUID"));
+    snprintf(line + strlen(line), sizeof(line) - strlen(line),
+	     "%s\t", TXT("rfo"));
+  } else
+    snprintf(line, sizeof(line), "%s\t%s\t", name, domain);
+
+#undef TXT
+
+  list = strcasecmp(scheme, "ipps") ? service_uri_list_ipp :
+    service_uri_list_ipps;
+  if (!cupsArrayFind(list, line))
+    cupsArrayAdd(list, strdup(line));
+}
+
+static int
+read_services_file(const char   *filename,
+					/* I - Service list file */
+		   cups_array_t *service_uri_list_ipp,
+					/* I - Array for IPP services */
+		   cups_array_t *service_uri_list_ipps,
+					/* I - Array for IPPS services */
+		   int          mode,	/* I - Output mode */
+		   int          reg_type_no,
+					/* I - 0: IPP, 1: both, 2: IPPS */
+		   int          isFax)	/* I - Only fax services? */
+{
+  cups_file_t	*fp;
+  char		line[MAX_OUTPUT_LEN],
+		*fields[6],
+		*ptr;
+  int		i,
+		num_txt;
+  cups_option_t	*txt;
+
+  if ((fp = cupsFileOpen(filename, "r")) == NULL) {
+    fprintf(stderr, "ERROR: Unable to open service list %s: %s\n",
+	    filename, strerror(errno));
+    return (1);
+  }
+
+  while (cupsFileGets(fp, line, sizeof(line))) {
+    if (line[0] == '#' || !line[0])
+      continue;
+    for (i = 0, ptr = line; i < 6 && ptr; i ++) {
+      fields[i] = ptr;
+      if ((ptr = strchr(ptr, '\t')) != NULL)
+	*ptr++ = '\0';
+    }
+    if (i < 6)
+      continue;
+    if (!strcasecmp(fields[0], "ipps") ? reg_type_no < 1 : reg_type_no > 1)
+      continue;
+    num_txt = 0;
+    txt = NULL;
+    while (ptr) {
+      char *key = ptr, *val;
+      if ((ptr = strchr(ptr, '\t')) != NULL)
+	*ptr++ = '\0';
+      if ((val = strchr(key, '=')) != NULL)
+	*val++ = '\0';
+      num_txt = cupsAddOption(key, val ? val : "", num_txt, &txt);
+    }
+    add_service(service_uri_list_ipp, service_uri_list_ipps, mode, isFax,
+		fields[0], fields[1], fields[2], fields[3], atoi(fields[4]),
+		atoi(fields[5]), num_txt, txt);
+    cupsFreeOptions(num_txt, txt);
+  }
+
+  cupsFileClose(fp);
+  return (0);
+}
+
+#ifdef HAVE_AVAHI
+typedef struct avahi_browse_s {
+  AvahiSimplePoll *poll;
+  AvahiClient	*client;
+  int		browsers,		/* Browsers not yet "all for now" */
+		resolvers;		/* Resolvers not yet finished */
+  cups_array_t	*services,		/* Services already being resolved */
+		*service_uri_list_ipp,
+		*service_uri_list_ipps;
+  int		mode,
+		isFax;
+} avahi_browse_t;
+
+static void
+resolve_callback(AvahiServiceResolver *r,
+		 AvahiIfIndex interface,
+		 AvahiProtocol protocol,
+		 AvahiResolverEvent event,
+		 const char *name,
+		 const char *type,
+		 const char *domain,
+		 const char *host_name,
+		 const AvahiAddress *address,
+		 uint16_t port,
+		 AvahiStringList *txt,
+		 AvahiLookupResultFlags flags,
+		 void *userdata)
+{
+  avahi_browse_t  *data = (avahi_browse_t *)userdata;
+  AvahiStringList *entry;
+  char		  *key, *value;
+  int		  num_txt = 0;
+  cups_option_t	  *txt_options = NULL;
+
+  if (event == AVAHI_RESOLVER_FOUND) {
+    for (entry = txt; entry; entry = avahi_string_list_get_next(entry)) {
+      if (avahi_string_list_get_pair(entry, &key, &value, NULL))
+	continue;
+      num_txt = cupsAddOption(key, value ? value : "", num_txt, &txt_options);
+      avahi_free(key);
+      avahi_free(value);
+    }
+    add_service(data->service_uri_list_ipp, data->service_uri_list_ipps,
+		data->mode, data->isFax,
+		strncasecmp(type, "_ipps.", 6) ? "ipp" : "ipps",
+		name, domain, host_name, port,
+		(flags & AVAHI_LOOKUP_RESULT_LOCAL) ? 1 : 0,
+		num_txt, txt_options);
+    cupsFreeOptions(num_txt, txt_options);
+  } else if (debug)
+    fprintf(stderr, "DEBUG: Failed to resolve service \"%s\" (%s): %s\n",
+	    name, type,
+	    avahi_strerror(avahi_client_errno(data->client)));
+
+  avahi_service_resolver_free(r);
+  data->resolvers --;
+}
+
+static void
+browse_callback(AvahiServiceBrowser *b,
+		AvahiIfIndex interface,
+		AvahiProtocol protocol,
+		AvahiBrowserEvent event,
+		const char *name,
+		const char *type,
+		const char *domain,
+		AvahiLookupResultFlags flags,
+		void *userdata)
+{
+  avahi_browse_t *data = (avahi_browse_t *)userdata;
+  char		 service[1024];
+
+  switch (event) {
+  case AVAHI_BROWSER_NEW:
+    /* Resolve each service only once, not once per interface and
+       protocol; all resolvers run at the same time */
+    snprintf(service, sizeof(service), "%s.%s.%s", name, type, domain);
+    if (cupsArrayFind(data->services, service))
+      break;
+    cupsArrayAdd(data->services, strdup(service));
+    if (avahi_service_resolver_new(data->client, interface, protocol,
+				   name, type, domain, AVAHI_PROTO_UNSPEC, 0,
+				   resolve_callback, data))
+      data->resolvers ++;
+    else if (debug)
+      fprintf(stderr, "DEBUG: Failed to resolve service \"%s\" (%s): %s\n",
+	      name, type,
+	      avahi_strerror(avahi_client_errno(data->client)));
+    break;
+
+  case AVAHI_BROWSER_ALL_FOR_NOW:
+  case AVAHI_BROWSER_FAILURE:
+    data->browsers --;
+    break;
+
+  default:
+    break;
+  }
+}
+
+static int				/* O - 0 on success, -1 if Avahi is
+					       not available */
+browse_services_avahi(cups_array_t *service_uri_list_ipp,
+					/* I - Array for IPP services */
+		      cups_array_t *service_uri_list_ipps,
+					/* I - Array for IPPS services */
+		      int          mode,/* I - Output mode */
+		      int          reg_type_no,
+					/* I - 0: IPP, 1: both, 2: IPPS */
+		      int          isFax)
+					/* I - Only fax services? */
+{
+  avahi_browse_t data;
+  int		 error;
+  time_t	 end;
+
+  memset(&data, 0, sizeof(data));
+  data.service_uri_list_ipp = service_uri_list_ipp;
+  data.service_uri_list_ipps = service_uri_list_ipps;
+  data.mode = mode;
+  data.isFax = isFax;
+
+  if ((data.poll = avahi_simple_poll_new()) == NULL)
+    return (-1);
+  if ((data.client = avahi_client_new(avahi_simple_poll_get(data.poll), 0,
+				      NULL, NULL, &error)) == NULL) {
+    if (debug)
+      fprintf(stderr, "DEBUG: Unable to connect to Avahi: %s\n",
+	      avahi_strerror(error));
+    avahi_simple_poll_free(data.poll);
+    return (-1);
+  }
+  data.services =
+    cupsArrayNew3((cups_array_func_t)compare_service_uri, NULL, NULL, 0, NULL,
+		  (cups_afree_func_t)free);
+
+  if (reg_type_no >= 1 &&
+      avahi_service_browser_new(data.client, AVAHI_IF_UNSPEC,
+				AVAHI_PROTO_UNSPEC, "_ipps._tcp", NULL, 0,
+				browse_callback, &data))
+    data.browsers ++;
+  if (reg_type_no <= 1 &&
+      avahi_service_browser_new(data.client, AVAHI_IF_UNSPEC,
+				AVAHI_PROTO_UNSPEC, "_ipp._tcp", NULL, 0,
+				browse_callback, &data))
+    data.browsers ++;
+
+  /* Run until the browsers have reported all cached services and all
+     the resolvers have finished, with a safety timeout */
+  end = time(NULL) + 10;
+  while (!job_canceled && (data.browsers > 0 || data.resolvers > 0) &&
+	 time(NULL) < end)
+    if (avahi_simple_poll_iterate(data.poll, 100) < 0)
+      break;
+
+  /* Freeing the client also frees all its browsers and resolvers */
+  avahi_client_free(data.client);
+  avahi_simple_poll_free(data.poll);
+  cupsArrayDelete(data.services);
+
+  return (0);
+}
+#endif /* HAVE_AVAHI */
+
 int
 list_printers (int mode, int reg_type_no, int isFax)
 {
@@ -379,6 +716,7 @@ list_printers (int mode, int reg_type_no, int isFax)
   char		*ptr,
 		buffer[MAX_OUTPUT_LEN],	/* Copy buffer */
 		*ippfind_output;
+  const char	*services_file;		/* Service list replacing DNS-SD */
 
   service_uri_list_ipps =
     cupsArrayNew3((cups_array_func_t)compare_service_uri, NULL, NULL, 0, NULL,
@@ -387,6 +725,33 @@ list_printers (int mode, int reg_type_no, int isFax)
     cupsArrayNew3((cups_array_func_t)compare_service_uri, NULL, NULL, 0, NULL,
 		  (cups_afree_func_t)free);
 
+ /*
+  * Services from a file instead of DNS-SD (for testing)?
+  */
+
+  if ((services_file = getenv("DRIVERLESS_SERVICES")) != NULL &&
+      services_file[0]) {
+    if ((exit_status = read_services_file(services_file, service_uri_list_ipp,
+					  service_uri_list_ipps, mode,
+					  reg_type_no, isFax)) != 0)
+      goto error;
+    goto output;
+  }
+
+#ifdef HAVE_AVAHI
+ /*
+  * Browse and resolve the services in-process, all resolvers running
+  * concurrently, so that we do not need to wait for ippfind, which
+  * resolves one service after the other...
+  */
+
+  if (browse_services_avahi(service_uri_list_ipp, service_uri_list_ipps,
+			    mode, reg_type_no, isFax) == 0)
+    goto output;
+  if (debug)
+    fprintf(stderr, "DEBUG: Avahi not available, falling back to ippfind\n");
+#endif /* HAVE_AVAHI */
+
  /*
   * Use CUPS' ippfind utility to discover all printers designed for
   * driverless use (IPP Everywhere or Apple Raster), and only IPP
@@ -541,21 +906,6 @@ list_printers (int mode, int reg_type_no, int isFax)
     goto error;
   }
 
-  for (int j = 0; j < cupsArrayCount(service_uri_list_ipp); j ++)
-  {
-    if (cupsArrayFind(service_uri_list_ipps,
-		      (char*)cupsArrayIndex(service_uri_list_ipp, j))
-	== NULL)
-      listPrintersInArray(0, mode, isFax,
-			  (char *)cupsArrayIndex(service_uri_list_ipp, j));
-  }
-
-  for (int j = 0; j < cupsArrayCount(service_uri_list_ipps); j++)
-  {
-     listPrintersInArray(2, mode, isFax,
-			 (char *)cupsArrayIndex(service_uri_list_ipps, j));
-  }
-
  /*
   * Wait for the child process to exit...
   */
@@ -590,6 +940,22 @@ list_printers (int mode, int reg_type_no, int isFax)
     fprintf(stderr, "DEBUG: ippfind (PID %d) exited with no errors.\n",
 	    ippfind_pid);
 
+ output:
+  for (int j = 0; j < cupsArrayCount(service_uri_list_ipp); j ++)
+  {
+    if (cupsArrayFind(service_uri_list_ipps,
+		      (char*)cupsArrayIndex(service_uri_list_ipp, j))
+	== NULL)
+      listPrintersInArray(0, mode, isFax,
+			  (char *)cupsArrayIndex(service_uri_list_ipp, j));
+  }
+
+  for (int j = 0; j < cupsArrayCount(service_uri_list_ipps); j++)
+  {
+     listPrintersInArray(2, mode, isFax,
+			 (char *)cupsArrayIndex(service_uri_list_ipps, j));
+  }
+
  /*
   * Exit...
   */
@@ -678,14 +1044,179 @@ generate_ppd (const char *uri, int isFax)
   return 1;
 }
 
+/*
+ * 'generate_ppds()' - Generate the PPD files for many printers, running
+ *                     several generate_ppd() in parallel, each in its own
+ *                     child process.
+ */
+
+int
+generate_ppds (const char *dir,		/* I - Directory for the PPD files */
+	       int        num_uris,	/* I - Number of printer URIs */
+	       char       *uris[],	/* I - Printer URIs */
+	       int        isFax,	/* I - Fax PPDs? */
+	       int        jobs)		/* I - Number of PPDs to generate at
+					       the same time */
+{
+  int		i,
+		next,			/* Next printer to start */
+		done,			/* Number of finished printers */
+		running = 0,		/* Number of running children */
+		fd,
+		num,			/* Number for non-unique names */
+		failed = 0,		/* Number of failed printers */
+		wait_status;		/* Status from child */
+  pid_t		pid,
+		*pids;			/* Child for each printer */
+  char		**filenames,		/* PPD file for each printer */
+		*name,
+		*ptr;
+  struct timeval *start,		/* Start time for each printer */
+		end;
+  double	secs;
+
+  if (num_uris < 1)
+    return (0);
+  if (jobs < 1)
+    jobs = 1;
+
+  if (mkdir(dir, 0755) && errno != EEXIST) {
+    fprintf(stderr, "ERROR: Unable to create directory %s: %s\n", dir,
+	    strerror(errno));
+    return (1);
+  }
+
+  pids = calloc(num_uris, sizeof(pid_t));
+  filenames = calloc(num_uris, sizeof(char *));
+  start = calloc(num_uris, sizeof(struct timeval));
+  if (!pids || !filenames || !start) {
+    fprintf(stderr, "ERROR: Unable to allocate memory\n");
+    free(pids);
+    free(filenames);
+    free(start);
+    return (1);
+  }
+
+  /* PPD file name is the URI scheme and the rest of the URI with all
+     special characters replaced, prefixed by "fax-" for fax PPDs. Names
+     are made unique before any child is started, so that no two children
+     write the same file */
+  for (next = 0; next < num_uris; next ++) {
+    for (i = 0; i < next && strcmp(uris[i], uris[next]); i ++);
+    if (i < next) {
+      fprintf(stderr, "WARNING: %s given more than once, skipped\n",
+	      uris[next]);
+      continue;
+    }
+    filenames[next] = malloc(strlen(dir) + strlen(uris[next]) + 32);
+    sprintf(filenames[next], "%s/%s", dir,
+	    (!strncasecmp(uris[next], "driverless-fax:", 15) ||
+	     (isFax && strncasecmp(uris[next], "driverless:", 11))) ?
+	    "fax-" : "");
+    ptr = filenames[next] + strlen(filenames[next]);
+    if ((name = strstr(uris[next], "://")) != NULL) {
+      /* Keep the scheme, so that ipp:// and ipps:// differ */
+      for (i = 0; name - i > uris[next] && *(name - i - 1) != ':'; i ++);
+      sprintf(ptr, "%.*s_%s", i, name - i, name + 3);
+    } else
+      strcpy(ptr, uris[next]);
+    for (; *ptr; ptr ++)
+      if (!isalnum(*ptr & 255) && *ptr != '-' && *ptr != '.')
+	*ptr = '_';
+    strcpy(ptr, ".ppd");
+    for (num = 2, i = 0; i < next; i ++)
+      if (filenames[i] && !strcmp(filenames[i], filenames[next])) {
+	/* Different URIs mapped to the same name, number them */
+	sprintf(ptr, "-%d.ppd", num ++);
+	i = -1;
+      }
+  }
+
+  for (next = 0, done = 0; done < num_uris; ) {
+    /* Start children until we have the requested number running */
+    for (; next < num_uris && running < jobs; next ++) {
+      if (!filenames[next]) {
+	/* Duplicate URI */
+	done ++;
+	continue;
+      }
+
+      gettimeofday(&start[next], NULL);
+      if ((pid = fork()) == 0) {
+	/* Child: Write the PPD into the file instead of stdout */
+	if ((fd = open(filenames[next], O_WRONLY | O_CREAT | O_TRUNC,
+		       0644)) < 0) {
+	  fprintf(stderr, "ERROR: Unable to create %s: %s\n",
+		  filenames[next], strerror(errno));
+	  exit(1);
+	}
+	dup2(fd, 1);
+	close(fd);
+	i = generate_ppd(uris[next], isFax);
+	fflush(stdout);
+	exit(i);
+      } else if (pid < 0) {
+	fprintf(stderr, "ERROR: Unable to fork: %s\n", strerror(errno));
+	failed ++;
+	done ++;
+      } else {
+	pids[next] = pid;
+	running ++;
+	if (debug)
+	  fprintf(stderr, "DEBUG: Generating PPD for %s (PID %d)\n",
+		  uris[next], (int)pid);
+      }
+    }
+
+    if (running == 0)
+      continue;
+
+    /* Wait for a child to finish */
+    while ((pid = wait(&wait_status)) < 0 && errno == EINTR);
+    if (pid < 0)
+      break;
+    gettimeofday(&end, NULL);
+    for (i = 0; i < num_uris && pids[i] != pid; i ++);
+    if (i >= num_uris)
+      continue;
+    running --;
+    done ++;
+    pids[i] = 0;
+    secs = (end.tv_sec - start[i].tv_sec) +
+      (end.tv_usec - start[i].tv_usec) / 1000000.0;
+    if (WIFEXITED(wait_status) && WEXITSTATUS(wait_status) == 0)
+      fprintf(stderr, "INFO: %s: PPD %s generated in %.3f sec\n", uris[i],
+	      filenames[i], secs);
+    else {
+      fprintf(stderr, "ERROR: %s: PPD generation failed after %.3f sec\n",
+	      uris[i], secs);
+      unlink(filenames[i]);
+      failed ++;
+    }
+  }
+
+  for (i = 0; i < num_uris; i ++)
+    free(filenames[i]);
+  free(filenames);
+  free(pids);
+  free(start);
+
+  if (failed)
+    fprintf(stderr, "ERROR: %d of %d PPD files could not be generated\n",
+	    failed, num_uris);
+  return (failed ? 1 : 0);
+}
+
 int
 main(int argc, char*argv[]) {
   int i,
       reg_type_no = 1, /* reg_type 0 for only IPP
                                    1 for both IPPS/IPP
                                    2 for only IPPS        Default is 1*/
-      isFax = 0;       /* if driverless-fax is called  0 - not called
+      isFax = 0,       /* if driverless-fax is called  0 - not called
 			                               1 - called */
+      jobs = 8;        /* Number of PPDs generated in parallel in
+			  "batch" mode */
   char *val;
 #if defined(HAVE_SIGACTION) && !defined(HAVE_SIGSET)
   struct sigaction action;		/* Actions for POSIX signals */
@@ -771,6 +1302,26 @@ main(int argc, char*argv[]) {
 		  "supplied.\n\n");
 	  goto help;
 	}
+      } else if (!strcasecmp(argv[i], "-j") ||
+		 !strcasecmp(argv[i], "--jobs")) {
+	/* Number of PPD files to generate in parallel in "batch" mode */
+	i ++;
+	if (i >= argc || (jobs = atoi(argv[i])) < 1) {
+	  fprintf(stderr,
+		  "Reading command line option \"%s\", no valid number of "
+		  "jobs supplied.\n\n", argv[i - 1]);
+	  goto help;
+	}
+      } else if (!strcasecmp(argv[i], "batch")) {
+	/* Generate the PPD files for many printers in parallel */
+	if (i + 2 >= argc) {
+	  fprintf(stderr,
+		  "Reading command line option \"batch\", no directory "
+		  "and printer or driver URIs supplied.\n\n");
+	  goto help;
+	}
+	exit(generate_ppds(argv[i + 1], argc - i - 2, argv + i + 2, isFax,
+			   jobs));
       } else if (!strcasecmp(argv[i], "--version") ||
 		 !strcasecmp(argv[i], "--help") ||
 		 !strcasecmp(argv[i], "-h")) {
@@ -829,6 +1380,15 @@ main(int argc, char*argv[]) {
 	  "  <printer URI>           Generate the PPD file for the IPP/IPPS "
 	                            "printer URI\n"
 	  "                          <printer URI>.\n"
+	  "  -j <n>\n"
+	  "  --jobs <n>              Generate up to <n> PPD files at the "
+	                            "same time in\n"
+	  "                          \"batch\" mode (default: 8).\n"
+	  "  batch <directory> <URI> ...\n"
+	  "                          Generate the PPD files for all the given "
+	                            "printer or\n"
+	  "                          driver URIs in parallel and save them "
+	                            "in <directory>.\n"
 	  "\n"
 	  "When called without options, the IPP/IPPS printer URIs of all "
 	  "available\n"
@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# Test the printer listings of driverless, with the printers read from
+# a DRIVERLESS_SERVICES file instead of being discovered via DNS-SD.
+#
+
+DRIVERLESS=${DRIVERLESS:-./driverless}
+TMP=${TMPDIR:-/tmp}/test_driverless.$$
+status=0
+
+trap 'rm -rf "$TMP"' 0
+mkdir "$TMP" || exit 1
+
+# scheme name domain hostname port local key=value ...
+#  - Foo has IPP and IPPS, so only IPPS is listed
+#  - Bar has IPP only and can fax
+#  - Queue is a remote CUPS queue, PS is not a driverless printer, both
+#    must not be listed
+printf '%s\t' ipp Foo local foo.local 631 0 'ty=Acme Foo' \
+    'pdl=application/pdf,image/pwg-raster' usb_MFG=Acme usb_MDL=Foo \
+    UUID=1111 rp=ipp/print > "$TMP/services"
+printf '\n' >> "$TMP/services"
+printf '%s\t' ipps Foo local foo.local 631 0 'ty=Acme Foo' \
+    'pdl=application/pdf,image/pwg-raster' usb_MFG=Acme usb_MDL=Foo \
+    UUID=1111 rp=ipp/print >> "$TMP/services"
+printf '\n' >> "$TMP/services"
+printf '%s\t' ipp Bar local bar.local 8631 0 'ty=Acme Bar' \
+    pdl=image/pwg-raster usb_MFG=Acme usb_MDL=Bar UUID=2222 rp=ipp/print \
+    rfo=ipp/faxout >> "$TMP/services"
+printf '\n' >> "$TMP/services"
+printf '%s\t' ipp Queue local queue.local 631 1 printer-type=0x1 \
+    pdl=application/pdf rp=printers/queue >> "$TMP/services"
+printf '\n' >> "$TMP/services"
+printf '%s\t' ipp PS local ps.local 631 0 pdl=application/postscript \
+    rp=ipp/print >> "$TMP/services"
+printf '\n' >> "$TMP/services"
+
+DRIVERLESS_SERVICES="$TMP/services"
+export DRIVERLESS_SERVICES
+unset SOFTWARE
+
+# check NAME ARGUMENTS... - compare the output with the lines on stdin
+check()
+{
+    name=$1
+    shift
+    cat > "$TMP/expected"
+    printf '%s: ' "$name"
+    if ! "$DRIVERLESS" "$@" > "$TMP/output"; then
+	echo "FAIL (exit status)"
+	status=1
+    elif ! sed -e 's/cups-filters [^"]*"/cups-filters VERSION"/' \
+	     "$TMP/output" | diff "$TMP/expected" -; then
+	echo "FAIL (output differs)"
+	status=1
+    else
+	echo "PASS"
+    fi
+}
+
+check "URIs" <<EOF
+ipp://Bar._ipp._tcp.local/
+ipps://Foo._ipps._tcp.local/
+EOF
+
+check "IPP URIs" _ipp._tcp <<EOF
+ipp://Bar._ipp._tcp.local/
+ipp://Foo._ipp._tcp.local/
+EOF
+
+check "standard URIs" --std-ipp-uris <<EOF
+ipp://bar.local:8631/ipp/print
+ipps://foo.local:631/ipp/print
+EOF
+
+check "list" list <<EOF
+"driverless:ipp://Bar._ipp._tcp.local/" en "Acme" "Acme Bar, driverless, cups-filters VERSION" "MFG:Acme;MDL:Bar;CMD:PWGRaster,PWG;"
+"driverless-fax:ipp://Bar._ipp._tcp.local/" en "Acme" "Acme Bar, Fax, driverless, cups-filters VERSION" "MFG:Acme;MDL:Bar;CMD:PWGRaster,PWG;"
+"driverless:ipps://Foo._ipps._tcp.local/" en "Acme" "Acme Foo, driverless, cups-filters VERSION" "MFG:Acme;MDL:Foo;CMD:PDF,PWGRaster,PWG;"
+EOF
+
+exit $status